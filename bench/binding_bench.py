@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Compare db_sync's pure-Python load/score with the libretention binding."""
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+import types
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT)
+
+# db_sync only needs psycopg to talk to Postgres; the loaders benchmarked
+# here do not, so a stub keeps the benchmark runnable without it.
+if "psycopg" not in sys.modules:
+    try:
+        import psycopg  # noqa: F401
+    except ImportError:
+        stub = types.ModuleType("psycopg")
+        stub.Connection = object
+        stub.Cursor = object
+        sys.modules["psycopg"] = stub
+
+import db_sync  # noqa: E402
+import retention_engine  # noqa: E402
+
+
+def python_ingest(path):
+    scholars, _ = db_sync.load_csv(path)
+    return len(scholars)
+
+
+def engine_ingest(path):
+    with retention_engine.Engine() as engine:
+        engine.load_csv(path)
+        engine.score()
+        engine.columns()
+        return len(engine)
+
+
+def engine_copy(path):
+    with retention_engine.Engine() as engine:
+        engine.load_csv(path)
+        engine.score()
+        return len(engine.export_csv())
+
+
+def time_runs(fn, path, runs):
+    samples = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        fn(path)
+        samples.append((time.perf_counter() - start) * 1000.0)
+    return statistics.median(samples)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--rows", type=int, default=200000)
+    parser.add_argument("--runs", type=int, default=3)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, "roster.csv")
+        subprocess.run(
+            [sys.executable, os.path.join(ROOT, "bench", "gen_data.py"), str(args.rows), "--output", path],
+            check=True,
+        )
+        python_ms = time_runs(python_ingest, path, args.runs)
+        print(f"{'path':<22} {'median ms':>10} {'speedup':>8}")
+        print(f"{'python dataclasses':<22} {python_ms:>10.1f} {1.0:>7.1f}x")
+        for label, fn in (("engine columns", engine_ingest), ("engine copy buffer", engine_copy)):
+            ms = time_runs(fn, path, args.runs)
+            print(f"{label:<22} {ms:>10.1f} {python_ms / ms:>7.1f}x")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Local stand-in for the CRM bulk API, for testing -sink.
+
+Accepts POSTed JSON arrays of queue records over keep-alive HTTP/1.1 and
+counts them, de-duplicating retried batches by their Idempotency-Key. It can
+fail a share of requests (503 or 429 with Retry-After) and answer slowly, to
+exercise retries and backpressure. Prints a summary on Ctrl-C or SIGTERM.
+"""
+import argparse
+import json
+import random
+import signal
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Optional, TextIO
+
+
+class Tally:
+    def __init__(self, out: Optional[TextIO]) -> None:
+        self.lock = threading.Lock()
+        self.out = out
+        self.requests = 0
+        self.failures = 0
+        self.duplicates = 0
+        self.records = 0
+        self.ops = {}
+        self.keys = set()
+        self.in_flight = 0
+        self.max_in_flight = 0
+
+    def summary(self) -> str:
+        ops = ", ".join(f"{op} {count}" for op, count in sorted(self.ops.items()))
+        return (f"{self.requests} requests, {self.failures} failed on purpose, {self.duplicates} duplicate batches, "
+                f"{self.records} records ({ops}), at most {self.max_in_flight} in flight")
+
+
+def make_handler(tally: Tally, args: argparse.Namespace, rng: random.Random):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, format: str, *values) -> None:  # noqa: A002 - matches the base signature
+            if args.verbose:
+                super().log_message(format, *values)
+
+        def reply(self, status: int, body: bytes, headers: Optional[dict] = None) -> None:
+            self.send_response(status)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            for name, value in (headers or {}).items():
+                self.send_header(name, value)
+            self.end_headers()
+            self.wfile.write(body)
+
+        def do_POST(self) -> None:  # noqa: N802 - http.server naming
+            body = self.rfile.read(int(self.headers.get("Content-Length", "0")))
+            with tally.lock:
+                tally.requests += 1
+                tally.in_flight += 1
+                tally.max_in_flight = max(tally.max_in_flight, tally.in_flight)
+                fail = rng.random() < args.fail_rate
+                if fail:
+                    tally.failures += 1
+            try:
+                if args.delay_ms > 0:
+                    time.sleep(args.delay_ms / 1000.0)
+                if fail:
+                    if rng.random() < 0.5:
+                        self.reply(429, b'{"error": "slow down"}', {"Retry-After": "0"})
+                    else:
+                        self.reply(503, b'{"error": "unavailable"}')
+                    return
+                try:
+                    records = json.loads(body)
+                except ValueError:
+                    self.reply(400, b'{"error": "invalid JSON"}')
+                    return
+                key = self.headers.get("Idempotency-Key")
+                with tally.lock:
+                    if key and key in tally.keys:
+                        tally.duplicates += 1
+                    else:
+                        if key:
+                            tally.keys.add(key)
+                        tally.records += len(records)
+                        for record in records:
+                            op = record.get("op", "?")
+                            tally.ops[op] = tally.ops.get(op, 0) + 1
+                            if tally.out:
+                                tally.out.write(json.dumps(record) + "\n")
+                self.reply(200, json.dumps({"accepted": len(records)}).encode())
+            finally:
+                with tally.lock:
+                    tally.in_flight -= 1
+
+    return Handler
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Run a local CRM bulk API stub for -sink")
+    parser.add_argument("--port", type=int, default=8089, help="Port on 127.0.0.1 (default: 8089)")
+    parser.add_argument("--fail-rate", type=float, default=0.0, help="Share of requests answered 429/503 (default: 0)")
+    parser.add_argument("--delay-ms", type=int, default=0, help="Delay before each answer (default: 0)")
+    parser.add_argument("--output", help="Append accepted records as JSON lines to this file")
+    parser.add_argument("--seed", type=int, default=2026, help="Random seed (default: 2026)")
+    parser.add_argument("--verbose", action="store_true", help="Log every request")
+    return parser.parse_args()
+
+
+def stop(signum: int, frame) -> None:
+    raise KeyboardInterrupt
+
+
+def main() -> None:
+    args = parse_args()
+    signal.signal(signal.SIGINT, stop)
+    signal.signal(signal.SIGTERM, stop)
+    out = open(args.output, "a", encoding="utf-8") if args.output else None
+    tally = Tally(out)
+    server = ThreadingHTTPServer(("127.0.0.1", args.port), make_handler(tally, args, random.Random(args.seed)))
+    server.daemon_threads = True
+    print(f"CRM stub listening on http://127.0.0.1:{args.port}/", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.server_close()
+        if out:
+            out.close()
+        print(tally.summary(), flush=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Differential check: optimized fast paths must match the -reference paths byte for byte.
+
+It also replays one change file through -changes and through the live index (-follow -) on the
+same roster, NaN risks included, and expects the same exported rows.
+"""
+import argparse
+import csv
+import os
+import random
+import subprocess
+import sys
+import tempfile
+from typing import List, Optional, Tuple
+
+CASES = {
+    "default": [],
+    "drivers": ["-drivers", "-limit", "50"],
+    "json-full": ["-json-full", "-drivers"],
+    "min-risk": ["-min-risk", "55", "-high-threshold", "70", "-medium-threshold", "45"],
+    "cohort": ["-cohort", "Fall-2024", "-json"],
+}
+OUTPUTS = ["stdout", "export.csv", "summary.csv", "actions.csv"]
+
+
+def run(binary: str, data: str, args: List[str], outdir: str, reference: bool) -> None:
+    os.makedirs(outdir, exist_ok=True)
+    cmd = [
+        binary,
+        data,
+        "-export",
+        os.path.join(outdir, "export.csv"),
+        "-summary",
+        os.path.join(outdir, "summary.csv"),
+        "-actions",
+        os.path.join(outdir, "actions.csv"),
+    ] + args
+    if reference:
+        cmd.append("-reference")
+    with open(os.path.join(outdir, "stdout"), "wb") as handle:
+        subprocess.run(cmd, check=True, stdout=handle)
+
+
+def write_changes(data: str, path: str, seed: int) -> None:
+    """Deletes, updates and inserts, some of which score NaN."""
+    rng = random.Random(seed)
+    with open(data, newline="") as handle:
+        reader = csv.reader(handle)
+        header = next(reader)
+        rows = [row for row in reader if len(row) == len(header)]
+    picked = rng.sample(rows, min(len(rows), 600))
+    with open(path, "w", newline="") as handle:
+        writer = csv.writer(handle)
+        writer.writerow(["op"] + header)
+        for i, row in enumerate(picked):
+            if i % 3 == 0:
+                writer.writerow(["delete", row[0]] + [""] * (len(header) - 1))
+                continue
+            row = list(row)
+            row[3] = "nan" if i % 3 == 1 else str(rng.randint(0, 90))
+            writer.writerow(["upsert"] + row)
+        for i in range(50):
+            writer.writerow(["upsert", f"NEW-{i}", f"New {i}", "Fall-2024", "nan" if i % 2 else "12", "80", "70",
+                             "3.0", "5", "80", "0"])
+
+
+def check_follow(binary: str, data: str, tmp: str, seed: int) -> int:
+    changes = os.path.join(tmp, "changes.csv")
+    write_changes(data, changes, seed)
+    batch = os.path.join(tmp, "follow", "batch.csv")
+    live = os.path.join(tmp, "follow", "live.csv")
+    os.makedirs(os.path.dirname(batch), exist_ok=True)
+    subprocess.run([binary, data, "-changes", changes, "-export", batch], check=True,
+                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    with open(changes, "rb") as stdin:
+        subprocess.run([binary, data, "-follow", "-", "-export", live], check=True, stdin=stdin,
+                       stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, timeout=600)
+    # NaN risks have no defined place in the batch sort, so compare rows, not order.
+    with open(batch, "rb") as handle:
+        want = sorted(handle.read().splitlines())
+    with open(live, "rb") as handle:
+        got = sorted(handle.read().splitlines())
+    if want == got:
+        print("follow: identical")
+        return 0
+    print(f"follow: {len(set(want) ^ set(got))} export row(s) differ between -changes and -follow")
+    return 1
+
+
+def first_divergence(expected: str, actual: str) -> Optional[Tuple[int, int, bytes, bytes]]:
+    with open(expected, "rb") as handle:
+        want = handle.read()
+    with open(actual, "rb") as handle:
+        got = handle.read()
+    if want == got:
+        return None
+    offset = next((i for i, (a, b) in enumerate(zip(want, got)) if a != b), min(len(want), len(got)))
+    line = want.count(b"\n", 0, offset) + 1
+    start = want.rfind(b"\n", 0, offset) + 1
+    want_line = want[start:].split(b"\n", 1)[0]
+    got_line = got[start:].split(b"\n", 1)[0]
+    return line, offset - start + 1, want_line, got_line
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Compare optimized and reference Retention Watch output")
+    parser.add_argument("--binary", default="./retention-watch", help="CLI binary to check")
+    parser.add_argument("--rows", type=int, default=500000, help="Generated roster size")
+    parser.add_argument("--seed", type=int, default=2026, help="Generator seed")
+    parser.add_argument("--edge-rate", type=float, default=0.02, help="Fraction of edge-case rows")
+    return parser.parse_args()
+
+
+def main() -> None:
+    args = parse_args()
+    here = os.path.dirname(os.path.abspath(__file__))
+    failures = 0
+    with tempfile.TemporaryDirectory(prefix="retention-diff-") as tmp:
+        data = os.path.join(tmp, "roster.csv")
+        subprocess.run(
+            [sys.executable, os.path.join(here, "gen_data.py"), str(args.rows), "--seed", str(args.seed),
+             "--edge-rate", str(args.edge_rate), "--output", data],
+            check=True,
+        )
+        for case, case_args in CASES.items():
+            ref_dir = os.path.join(tmp, case, "reference")
+            opt_dir = os.path.join(tmp, case, "optimized")
+            run(args.binary, data, case_args, ref_dir, True)
+            run(args.binary, data, case_args, opt_dir, False)
+            case_failures = 0
+            for name in OUTPUTS:
+                diverged = first_divergence(os.path.join(ref_dir, name), os.path.join(opt_dir, name))
+                if diverged is None:
+                    continue
+                case_failures += 1
+                line, column, want, got = diverged
+                print(f"{case}: {name} diverges at line {line}, column {column}")
+                print(f"  reference: {want[:200].decode(errors='replace')}")
+                print(f"  optimized: {got[:200].decode(errors='replace')}")
+            if not case_failures:
+                print(f"{case}: identical")
+            failures += case_failures
+        failures += check_follow(args.binary, data, tmp, args.seed)
+    if failures:
+        print(f"\n{failures} output(s) diverged from the reference path.")
+        sys.exit(1)
+    print(f"\nAll outputs match the reference path ({args.rows} rows, seed {args.seed}).")
+
+
+if __name__ == "__main__":
+    main()
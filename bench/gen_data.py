@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Generate synthetic Retention Watch roster CSVs for benchmarking."""
+import argparse
+import random
+import sys
+from typing import TextIO
+
+HEADER = (
+    "scholar_id,name,cohort,days_inactive,attendance_rate,engagement_score,"
+    "gpa,last_contact_days,survey_score,open_flags"
+)
+COHORTS = [
+    "Spring-2024",
+    "Fall-2024",
+    "Spring-2025",
+    "Summer-2025",
+    "Fall-2025",
+    "Winter-2025",
+    "Spring-2026",
+    "Fall-2026",
+]
+FIRST_NAMES = ["Marina", "Jordan", "Evelyn", "DeShawn", "Priya", "Sofia", "Imani", "Rowan", "Leila", "Jonas"]
+LAST_NAMES = ["Lopez", "Patel", "Cho", "Reed", "Shah", "Rivera", "Brooks", "Li", "Mendez", "Park"]
+# Values that stress formatting and ordering: printf rounding ties, binary
+# near-ties (2.675), negative zero, blanks, huge magnitudes and NaN.
+EDGE_VALUES = ["12.25", "0.05", "0.15", "2.675", "1.005", "-0.04", "-0", "", "99.95", "1e7", "123456789.125", "nan"]
+
+
+def edge_row(rng: random.Random, i: int) -> str:
+    fields = [rng.choice(EDGE_VALUES) for _ in range(6)]
+    name = "Long " * rng.choice([1, 40]) + str(i)
+    flags = rng.choice(["", "0", "3", "-1"])
+    return f"GS-{i:07d},{name.strip()},{rng.choice(COHORTS)},{','.join(fields)},{flags}\n"
+
+
+def write_rows(out: TextIO, rows: int, seed: int, edge_rate: float = 0.0) -> None:
+    rng = random.Random(seed)
+    out.write(HEADER + "\n")
+    for i in range(rows):
+        if edge_rate > 0.0 and rng.random() < edge_rate:
+            out.write(edge_row(rng, i))
+            continue
+        name = f"{rng.choice(FIRST_NAMES)} {rng.choice(LAST_NAMES)}"
+        out.write(
+            f"GS-{i:07d},{name},{rng.choice(COHORTS)},"
+            f"{rng.randint(0, 60)},{rng.randint(40, 100)},{rng.randint(30, 100)},"
+            f"{rng.uniform(1.5, 4.0):.2f},{rng.randint(0, 45)},{rng.randint(30, 100)},"
+            f"{rng.choice([0, 0, 0, 1, 2])}\n"
+        )
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Generate a synthetic roster CSV")
+    parser.add_argument("rows", type=int, help="Number of scholar rows")
+    parser.add_argument("--seed", type=int, default=2026, help="Random seed (default: 2026)")
+    parser.add_argument("--output", default="-", help="Output path (default: stdout)")
+    parser.add_argument(
+        "--edge-rate",
+        type=float,
+        default=0.0,
+        help="Fraction of rows drawn from formatting/ordering edge cases (default: 0)",
+    )
+    return parser.parse_args()
+
+
+def main() -> None:
+    args = parse_args()
+    if args.output == "-":
+        write_rows(sys.stdout, args.rows, args.seed, args.edge_rate)
+        return
+    with open(args.output, "w", encoding="utf-8") as handle:
+        write_rows(handle, args.rows, args.seed, args.edge_rate)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Compare Retention Watch stage timings against a committed baseline."""
+import argparse
+import json
+import math
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+from typing import Dict, List
+
+CASES = {
+    "default": [],
+    "drivers-export": ["-drivers", "-export", "{tmp}/export.csv"],
+    "json-full": ["-json-full", "-drivers"],
+    "summaries": ["-summary", "{tmp}/summary.csv", "-actions", "{tmp}/actions.csv", "-min-risk", "60"],
+}
+
+
+def run_stages(binary: str, data: str, args: List[str], tmp: str) -> Dict[str, Dict[str, float]]:
+    timings = os.path.join(tmp, "timings.json")
+    cmd = [binary, data, "-timings", timings] + [arg.format(tmp=tmp) for arg in args]
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    with open(timings, encoding="utf-8") as handle:
+        return json.load(handle)["stages"]
+
+
+def run_case(binary: str, data: str, args: List[str], tmp: str) -> Dict[str, float]:
+    stages = run_stages(binary, data, args, tmp)
+    return {name: stage["wall_ms"] for name, stage in stages.items()}
+
+
+def check_allocations(binary: str, data: str, rows: int, tmp: str) -> bool:
+    """The steady-state parse/score loop must not allocate per row.
+
+    Roster strings live in a geometrically growing arena and cohorts in a
+    dictionary, so only O(log n) growth events are allowed while parsing and
+    none at all while scoring.
+    """
+    stages = run_stages(binary, data, ["-alloc-stats"], tmp)
+    parse_allocs = stages["parse"]["allocs"]
+    score_allocs = stages["score"]["allocs"]
+    budget = 4 * math.ceil(math.log2(max(rows, 2))) + 16
+    ok = score_allocs == 0 and parse_allocs <= budget
+    status = "ok" if ok else "FAILED"
+    print(f"allocations: parse {parse_allocs} (budget {budget}), score {score_allocs} (budget 0) ... {status}")
+    return ok
+
+
+def measure(binary: str, data: str, runs: int, tmp: str) -> Dict[str, Dict[str, float]]:
+    results: Dict[str, Dict[str, float]] = {}
+    for case, args in CASES.items():
+        samples = [run_case(binary, data, args, tmp) for _ in range(runs)]
+        medians = {stage: round(statistics.median(s[stage] for s in samples), 3) for stage in samples[0]}
+        medians["total"] = round(statistics.median(sum(s.values()) for s in samples), 3)
+        results[case] = medians
+    return results
+
+
+def compare(baseline: Dict[str, Dict[str, float]], current: Dict[str, Dict[str, float]],
+            tolerance: float, floor_ms: float) -> int:
+    regressions = 0
+    print(f"{'case':<16} {'stage':<10} {'baseline ms':>12} {'current ms':>12} {'change':>9}")
+    for case, stages in current.items():
+        for stage, value in stages.items():
+            base = baseline.get(case, {}).get(stage)
+            if base is None:
+                print(f"{case:<16} {stage:<10} {'-':>12} {value:>12.3f} {'new':>9}")
+                continue
+            change = (value - base) / base if base > 0 else 0.0
+            regressed = value - base > floor_ms and change > tolerance
+            marker = "  REGRESSED" if regressed else ""
+            print(f"{case:<16} {stage:<10} {base:>12.3f} {value:>12.3f} {change:>+8.1%}{marker}")
+            regressions += 1 if regressed else 0
+    return regressions
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Retention Watch performance regression gate")
+    parser.add_argument("--binary", default="./retention-watch", help="CLI binary to benchmark")
+    parser.add_argument("--baseline", default="bench/baseline.json", help="Baseline JSON path")
+    parser.add_argument("--rows", type=int, default=200000, help="Generated roster size")
+    parser.add_argument("--runs", type=int, default=5, help="Runs per case (median is compared)")
+    parser.add_argument("--tolerance", type=float, default=0.20, help="Allowed slowdown per stage (0.20 = 20%%)")
+    parser.add_argument("--floor-ms", type=float, default=5.0, help="Ignore regressions smaller than this many ms")
+    parser.add_argument("--update", action="store_true", help="Write the measured medians as the new baseline")
+    return parser.parse_args()
+
+
+def main() -> None:
+    args = parse_args()
+    here = os.path.dirname(os.path.abspath(__file__))
+    with tempfile.TemporaryDirectory(prefix="retention-perf-") as tmp:
+        data = os.path.join(tmp, "roster.csv")
+        subprocess.run([sys.executable, os.path.join(here, "gen_data.py"), str(args.rows), "--output", data], check=True)
+        current = measure(args.binary, data, args.runs, tmp)
+        allocations_ok = args.update or check_allocations(args.binary, data, args.rows, tmp)
+
+    if args.update:
+        with open(args.baseline, "w", encoding="utf-8") as handle:
+            json.dump({"rows": args.rows, "runs": args.runs, "cases": current}, handle, indent=2, sort_keys=True)
+            handle.write("\n")
+        print(f"Baseline written to {args.baseline}.")
+        return
+
+    with open(args.baseline, encoding="utf-8") as handle:
+        baseline = json.load(handle)
+    if baseline.get("rows") != args.rows:
+        print(f"Baseline was recorded with {baseline.get('rows')} rows; measuring {args.rows}.", file=sys.stderr)
+
+    regressions = compare(baseline["cases"], current, args.tolerance, args.floor_ms)
+    if not allocations_ok:
+        print("\nThe parse/score loop allocated per row.")
+        sys.exit(1)
+    if regressions:
+        print(f"\n{regressions} stage(s) regressed beyond {args.tolerance:.0%}.")
+        sys.exit(1)
+    print(f"\nNo stage regressed beyond {args.tolerance:.0%}.")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""Compare a plain build against the PGO+LTO build on the synthetic workload."""
+import argparse
+import os
+import statistics
+import subprocess
+import time
+from typing import List
+
+WORKLOADS = {
+    "default": [],
+    "drivers-export": ["-drivers", "-export", "{tmp}/export.csv"],
+    "json-full": ["-json-full"],
+    "drivers-json-full-export": ["-drivers", "-json-full", "-export", "{tmp}/export.csv"],
+}
+
+
+def time_run(binary: str, data: str, args: List[str], tmp: str) -> float:
+    cmd = [binary, data] + [arg.format(tmp=tmp) for arg in args]
+    start = time.perf_counter()
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    return (time.perf_counter() - start) * 1000.0
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Report PGO+LTO speedup")
+    parser.add_argument("--baseline", required=True, help="Plain -O2 binary")
+    parser.add_argument("--optimized", required=True, help="PGO+LTO binary")
+    parser.add_argument("--data", required=True, help="Roster CSV to run against")
+    parser.add_argument("--runs", type=int, default=5, help="Runs per workload (median is reported)")
+    parser.add_argument("--tmp", required=True, help="Scratch directory for export files")
+    return parser.parse_args()
+
+
+def main() -> None:
+    args = parse_args()
+    os.makedirs(args.tmp, exist_ok=True)
+    print(f"{'workload':<26} {'-O2 ms':>10} {'PGO+LTO ms':>12} {'speedup':>9}")
+    base_total = 0.0
+    opt_total = 0.0
+    for name, workload in WORKLOADS.items():
+        base_samples = []
+        opt_samples = []
+        for _ in range(args.runs):
+            # Interleave the binaries so machine noise hits both equally.
+            base_samples.append(time_run(args.baseline, args.data, workload, args.tmp))
+            opt_samples.append(time_run(args.optimized, args.data, workload, args.tmp))
+        base = statistics.median(base_samples)
+        opt = statistics.median(opt_samples)
+        base_total += base
+        opt_total += opt
+        print(f"{name:<26} {base:>10.1f} {opt:>12.1f} {base / opt:>8.2f}x")
+    print(f"{'all workloads':<26} {base_total:>10.1f} {opt_total:>12.1f} {base_total / opt_total:>8.2f}x")
+
+
+if __name__ == "__main__":
+    main()
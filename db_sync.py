@@ -8,6 +8,8 @@ from typing import List, Tuple, Optional
 
 import psycopg
 
+import retention_engine
+
 SCHEMA = "retention_watch"
 REQUIRED_FIELDS = [
     "scholar_id",
@@ -201,6 +203,87 @@ def init_db(conn: psycopg.Connection) -> None:
     conn.commit()
 
 
+def insert_run(
+    cur: psycopg.Cursor,
+    source_label: str,
+    total: int,
+    avg_risk: float,
+    high: int,
+    medium: int,
+    low: int,
+    skipped: int,
+    notes: Optional[str],
+) -> int:
+    cur.execute(
+        f"""
+        INSERT INTO {SCHEMA}.runs
+            (source_file, total, average_risk, high, medium, low, skipped, notes)
+        VALUES (%s, %s, %s, %s, %s, %s, %s, %s)
+        RETURNING run_id
+        """,
+        (source_label, total, round(avg_risk, 1), high, medium, low, skipped, notes),
+    )
+    return cur.fetchone()[0]
+
+
+def ingest_csv_engine(conn: psycopg.Connection, path: str, source_label: str, notes: Optional[str]) -> int:
+    """Scores with libretention and COPYs the C-rendered export into Postgres,
+    so no Python object is built per scholar."""
+    with retention_engine.Engine() as engine:
+        engine.load_csv(path)
+        if len(engine) == 0:
+            raise RuntimeError("No records loaded from CSV")
+        engine.score()
+        totals = engine.totals()
+        export = engine.export_csv()
+
+    with conn.cursor() as cur:
+        run_id = insert_run(
+            cur,
+            source_label,
+            totals["loaded"],
+            totals["avg_risk"],
+            totals["high"],
+            totals["medium"],
+            totals["low"],
+            totals["skipped"],
+            notes,
+        )
+        cur.execute(
+            f"""
+            CREATE TEMP TABLE snapshot_stage
+                (LIKE {SCHEMA}.scholar_snapshots INCLUDING DEFAULTS) ON COMMIT DROP
+            """
+        )
+        cur.execute("ALTER TABLE snapshot_stage ALTER COLUMN run_id DROP NOT NULL")
+        with cur.copy(
+            """
+            COPY snapshot_stage
+                (scholar_id, name, cohort, risk_score, tier, action_hint, days_inactive,
+                 attendance_rate, engagement_score, gpa, last_contact_days, survey_score,
+                 open_flags)
+            FROM STDIN (FORMAT csv, HEADER true)
+            """
+        ) as copy:
+            copy.write(export)
+        cur.execute(
+            f"""
+            INSERT INTO {SCHEMA}.scholar_snapshots
+                (run_id, scholar_id, name, cohort, days_inactive, attendance_rate,
+                 engagement_score, gpa, last_contact_days, survey_score, open_flags,
+                 risk_score, tier, action_hint)
+            SELECT %s, scholar_id, name, cohort, days_inactive, attendance_rate,
+                   engagement_score, gpa, last_contact_days, survey_score, open_flags,
+                   risk_score, tier, action_hint
+            FROM snapshot_stage
+            """,
+            (run_id,),
+        )
+
+    conn.commit()
+    return run_id
+
+
 def ingest_csv(conn: psycopg.Connection, path: str, source_label: str, notes: Optional[str]) -> int:
     scholars, skipped = load_csv(path)
     if not scholars:
@@ -213,16 +296,7 @@ def ingest_csv(conn: psycopg.Connection, path: str, source_label: str, notes: Op
     low = sum(1 for s in scholars if s.tier == "low")
 
     with conn.cursor() as cur:
-        cur.execute(
-            f"""
-            INSERT INTO {SCHEMA}.runs
-                (source_file, total, average_risk, high, medium, low, skipped, notes)
-            VALUES (%s, %s, %s, %s, %s, %s, %s, %s)
-            RETURNING run_id
-            """,
-            (source_label, total, round(avg_risk, 1), high, medium, low, skipped, notes),
-        )
-        run_id = cur.fetchone()[0]
+        run_id = insert_run(cur, source_label, total, avg_risk, high, medium, low, skipped, notes)
 
         rows = [
             (
@@ -273,6 +347,12 @@ def parse_args() -> argparse.Namespace:
         help="Label to store as the source file (defaults to CSV filename)",
     )
     ingest_parser.add_argument("--notes", default=None, help="Notes for this run")
+    ingest_parser.add_argument(
+        "--engine",
+        choices=["auto", "c", "python"],
+        default="auto",
+        help="Score with libretention (c), in Python, or c when the library is available (auto)",
+    )
 
     return parser.parse_args()
 
@@ -286,7 +366,11 @@ def main() -> None:
             return
 
         source_label = args.source_label or os.path.basename(args.csv)
-        run_id = ingest_csv(conn, args.csv, source_label, args.notes)
+        use_engine = args.engine == "c" or (args.engine == "auto" and retention_engine.available())
+        if use_engine:
+            run_id = ingest_csv_engine(conn, args.csv, source_label, args.notes)
+        else:
+            run_id = ingest_csv(conn, args.csv, source_label, args.notes)
         print(f"Ingested run {run_id} from {source_label}.")
 
 
@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+"""ctypes binding over libretention, the C scoring engine.
+
+Scored rows stay in C; columns come back as typed buffers (array.array,
+viewable through memoryview) in rank order, so callers such as db_sync can
+move a whole roster without one Python object per row.
+"""
+import array
+import ctypes
+import os
+from dataclasses import dataclass
+from typing import Dict, Optional
+
+LIB_ENV = "RETENTION_WATCH_LIB"
+
+RW_OK = 0
+RW_ERR_IO = -1
+
+DOUBLE_COLUMNS = {
+    "days_inactive": 0,
+    "attendance_rate": 1,
+    "engagement_score": 2,
+    "gpa": 3,
+    "last_contact_days": 4,
+    "survey_score": 5,
+    "risk_score": 6,
+    "attendance_trend": 14,
+    "engagement_trend": 15,
+}
+INT_COLUMNS = {
+    "open_flags": 7,
+    "tier": 8,
+    "action": 9,
+    "cohort_id": 10,
+}
+STRING_COLUMNS = {
+    "scholar_id": 11,
+    "name": 12,
+    "cohort": 13,
+}
+TIER_COUNT = 3
+ACTION_COUNT = 6
+
+
+class RwConfig(ctypes.Structure):
+    _fields_ = [
+        ("high_threshold", ctypes.c_double),
+        ("medium_threshold", ctypes.c_double),
+        ("cohort_filter", ctypes.c_char_p),
+    ]
+
+
+class RwTotals(ctypes.Structure):
+    _fields_ = [
+        ("rows_read", ctypes.c_int),
+        ("skipped", ctypes.c_int),
+        ("filtered", ctypes.c_int),
+        ("loaded", ctypes.c_int),
+        ("high", ctypes.c_int),
+        ("medium", ctypes.c_int),
+        ("low", ctypes.c_int),
+        ("avg_risk", ctypes.c_double),
+    ]
+
+
+class RwExportOptions(ctypes.Structure):
+    _fields_ = [
+        ("min_risk", ctypes.c_double),
+        ("drivers", ctypes.c_int),
+        ("reference", ctypes.c_int),
+        ("zscores", ctypes.c_int),
+    ]
+
+
+class EngineError(RuntimeError):
+    pass
+
+
+@dataclass
+class StringColumn:
+    """Arrow-style packed strings: value i is data[offsets[i]:offsets[i + 1]]."""
+
+    offsets: array.array
+    data: bytearray
+
+    def __len__(self) -> int:
+        return len(self.offsets) - 1
+
+    def __getitem__(self, index: int) -> str:
+        return self.data[self.offsets[index]:self.offsets[index + 1]].decode("utf-8")
+
+
+_lib = None
+
+
+def _library_candidates():
+    configured = os.environ.get(LIB_ENV)
+    if configured:
+        yield configured
+    here = os.path.dirname(os.path.abspath(__file__))
+    yield os.path.join(here, "libretention.so")
+    yield "libretention.so.2"
+
+
+def load_library() -> ctypes.CDLL:
+    global _lib
+    if _lib is not None:
+        return _lib
+    errors = []
+    for candidate in _library_candidates():
+        try:
+            lib = ctypes.CDLL(candidate)
+            break
+        except OSError as exc:
+            errors.append(str(exc))
+    else:
+        raise EngineError("libretention not found (run make or set RETENTION_WATCH_LIB): " + "; ".join(errors))
+
+    engine_p = ctypes.c_void_p
+    lib.rw_api_version.restype = ctypes.c_int
+    lib.rw_strerror.argtypes = [ctypes.c_int]
+    lib.rw_strerror.restype = ctypes.c_char_p
+    lib.rw_config_init.argtypes = [ctypes.POINTER(RwConfig)]
+    lib.rw_engine_new.argtypes = [ctypes.POINTER(RwConfig)]
+    lib.rw_engine_new.restype = engine_p
+    lib.rw_engine_free.argtypes = [engine_p]
+    lib.rw_load_csv_file.argtypes = [engine_p, ctypes.c_char_p]
+    lib.rw_load_csv_buffer.argtypes = [engine_p, ctypes.c_char_p, ctypes.c_size_t]
+    lib.rw_score.argtypes = [engine_p]
+    lib.rw_aggregate.argtypes = [engine_p]
+    lib.rw_count.argtypes = [engine_p]
+    lib.rw_get_totals.argtypes = [engine_p, ctypes.POINTER(RwTotals)]
+    lib.rw_column_double.argtypes = [engine_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_size_t]
+    lib.rw_column_int.argtypes = [engine_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_size_t]
+    lib.rw_column_strings.argtypes = [engine_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.rw_column_strings.restype = ctypes.c_longlong
+    lib.rw_tier_name.argtypes = [ctypes.c_int]
+    lib.rw_tier_name.restype = ctypes.c_char_p
+    lib.rw_action_name.argtypes = [ctypes.c_int]
+    lib.rw_action_name.restype = ctypes.c_char_p
+    lib.rw_export_buffer.argtypes = [
+        engine_p,
+        ctypes.POINTER(RwExportOptions),
+        ctypes.POINTER(ctypes.c_void_p),
+        ctypes.POINTER(ctypes.c_size_t),
+    ]
+    lib.rw_buffer_free.argtypes = [ctypes.c_void_p]
+
+    if lib.rw_api_version() != 2:
+        raise EngineError(f"libretention API version {lib.rw_api_version()} is not supported")
+    _lib = lib
+    return lib
+
+
+def available() -> bool:
+    try:
+        load_library()
+    except EngineError:
+        return False
+    return True
+
+
+def _buffer_address(buf) -> int:
+    if len(buf) == 0:
+        return 0
+    return ctypes.addressof((ctypes.c_char * 1).from_buffer(buf))
+
+
+class Engine:
+    """One scoring run. Load, then score; columns are in rank order."""
+
+    def __init__(
+        self,
+        high_threshold: float = 75.0,
+        medium_threshold: float = 50.0,
+        cohort_filter: Optional[str] = None,
+    ) -> None:
+        self._lib = load_library()
+        config = RwConfig()
+        self._lib.rw_config_init(ctypes.byref(config))
+        config.high_threshold = high_threshold
+        config.medium_threshold = medium_threshold
+        config.cohort_filter = cohort_filter.encode("utf-8") if cohort_filter else None
+        self._engine = self._lib.rw_engine_new(ctypes.byref(config))
+        if not self._engine:
+            raise EngineError("Invalid thresholds: high must be greater than medium.")
+
+    def close(self) -> None:
+        if self._engine:
+            self._lib.rw_engine_free(self._engine)
+            self._engine = None
+
+    def __enter__(self) -> "Engine":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def __del__(self) -> None:
+        self.close()
+
+    def _check(self, rc: int, what: str) -> None:
+        if rc != RW_OK:
+            raise EngineError(f"{what}: {self._lib.rw_strerror(rc).decode()}")
+
+    def load_csv(self, path: str) -> None:
+        rc = self._lib.rw_load_csv_file(self._engine, os.fsencode(path))
+        if rc == RW_ERR_IO:
+            raise OSError(f"Failed to open CSV: {path}")
+        self._check(rc, "load")
+
+    def load_bytes(self, data: bytes) -> None:
+        self._check(self._lib.rw_load_csv_buffer(self._engine, data, len(data)), "load")
+
+    def score(self) -> None:
+        self._check(self._lib.rw_aggregate(self._engine), "score")
+
+    def __len__(self) -> int:
+        return self._lib.rw_count(self._engine)
+
+    def totals(self) -> Dict[str, float]:
+        totals = RwTotals()
+        self._lib.rw_get_totals(self._engine, ctypes.byref(totals))
+        return {name: getattr(totals, name) for name, _ in RwTotals._fields_}
+
+    def column(self, name: str):
+        count = len(self)
+        if name in DOUBLE_COLUMNS:
+            values = array.array("d", bytes(8 * count))
+            rc = self._lib.rw_column_double(self._engine, DOUBLE_COLUMNS[name], _buffer_address(values), count)
+        elif name in INT_COLUMNS:
+            values = array.array("i", bytes(4 * count))
+            rc = self._lib.rw_column_int(self._engine, INT_COLUMNS[name], _buffer_address(values), count)
+        elif name in STRING_COLUMNS:
+            column = STRING_COLUMNS[name]
+            size = self._lib.rw_column_strings(self._engine, column, None, None, 0)
+            offsets = array.array("q", bytes(8 * (count + 1)))
+            data = bytearray(size)
+            self._lib.rw_column_strings(self._engine, column, _buffer_address(offsets), _buffer_address(data), size)
+            return StringColumn(offsets, data)
+        else:
+            raise KeyError(name)
+        self._check(rc, f"column {name}")
+        return values
+
+    def columns(self) -> Dict[str, object]:
+        names = list(STRING_COLUMNS) + list(DOUBLE_COLUMNS) + list(INT_COLUMNS)
+        return {name: self.column(name) for name in names}
+
+    @staticmethod
+    def tier_names():
+        lib = load_library()
+        return [lib.rw_tier_name(i).decode() for i in range(TIER_COUNT)]
+
+    @staticmethod
+    def action_names():
+        lib = load_library()
+        return [lib.rw_action_name(i).decode() for i in range(ACTION_COUNT)]
+
+    def export_csv(self, min_risk: float = 0.0, drivers: bool = False, zscores: bool = False) -> bytes:
+        """The -export CSV (header included) rendered in C."""
+        options = RwExportOptions(min_risk, 1 if drivers else 0, 0, 1 if zscores else 0)
+        data = ctypes.c_void_p()
+        size = ctypes.c_size_t()
+        rc = self._lib.rw_export_buffer(self._engine, ctypes.byref(options), ctypes.byref(data), ctypes.byref(size))
+        try:
+            self._check(rc, "export")
+            return ctypes.string_at(data, size.value)
+        finally:
+            self._lib.rw_buffer_free(data)
@@ -0,0 +1,363 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+#define ADVISOR_MAX_FIELDS 8
+
+/* Capacity-constrained outreach assignment. Scholars are taken in rank
+ * order, so each advisor's work list comes out highest risk first. Every
+ * cohort keeps a max-heap of the advisors who take it, keyed by remaining
+ * capacity, plus one heap for advisors who take any cohort. An advisor can
+ * sit in several heaps, so entries go stale as capacity is used; a stale
+ * top is re-keyed on the way out (capacity only shrinks, so a stale entry
+ * never hides a better advisor). With A advisors each scholar costs
+ * O(log A), which keeps 1M scholars x 2k advisors well under a second. */
+
+typedef struct {
+  int room;
+  int advisor;
+} HeapEntry;
+
+typedef struct {
+  HeapEntry *items;
+  int count;
+  int capacity;
+} AdvisorHeap;
+
+static const char *match_names[] = {"caseload", "cohort", "any"};
+
+static char *trim_field(char *s) {
+  while (*s && isspace((unsigned char)*s)) s++;
+  char *end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1])) end--;
+  *end = '\0';
+  return s;
+}
+
+static int entry_before(HeapEntry a, HeapEntry b) {
+  return a.room > b.room || (a.room == b.room && a.advisor < b.advisor);
+}
+
+static void sift_down(AdvisorHeap *heap, int i) {
+  HeapEntry item = heap->items[i];
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= heap->count) break;
+    if (child + 1 < heap->count && entry_before(heap->items[child + 1], heap->items[child])) child++;
+    if (!entry_before(heap->items[child], item)) break;
+    heap->items[i] = heap->items[child];
+    i = child;
+  }
+  heap->items[i] = item;
+}
+
+static int heap_push(AdvisorHeap *heap, HeapEntry entry) {
+  if (heap->count >= heap->capacity) {
+    int capacity = heap->capacity == 0 ? 8 : heap->capacity * 2;
+    HeapEntry *items = realloc(heap->items, sizeof(HeapEntry) * (size_t)capacity);
+    if (!items) return RW_ERR_NOMEM;
+    heap->items = items;
+    heap->capacity = capacity;
+  }
+  int i = heap->count++;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!entry_before(entry, heap->items[parent])) break;
+    heap->items[i] = heap->items[parent];
+    i = parent;
+  }
+  heap->items[i] = entry;
+  return RW_OK;
+}
+
+static void heap_pop(AdvisorHeap *heap) {
+  heap->items[0] = heap->items[--heap->count];
+  if (heap->count > 0) sift_down(heap, 0);
+}
+
+/* The advisor with the most room in heap, left on top; -1 when full. */
+static int heap_peek(AdvisorHeap *heap, const Advisor *advisors) {
+  while (heap->count > 0) {
+    HeapEntry top = heap->items[0];
+    int room = advisors[top.advisor].capacity - advisors[top.advisor].assigned;
+    if (room == top.room) return top.advisor;
+    if (room > 0) {
+      heap->items[0].room = room;
+      sift_down(heap, 0);
+    } else {
+      heap_pop(heap);
+    }
+  }
+  return -1;
+}
+
+static int split_affinities(AdvisorPool *pool, Advisor *advisor, char *list) {
+  int count = 0;
+  for (char *p = list; *p; p++) {
+    if (*p == ';') count++;
+  }
+  advisor->cohorts = malloc(sizeof(char *) * (size_t)(count + 1));
+  advisor->cohort_count = 0;
+  if (!advisor->cohorts) return RW_ERR_NOMEM;
+  char *cursor = list;
+  char *token;
+  while ((token = strsep(&cursor, ";")) != NULL) {
+    token = trim_field(token);
+    if (!*token) continue;
+    char *cohort = rw_arena_strdup(&pool->arena, token);
+    if (!cohort) return RW_ERR_NOMEM;
+    advisor->cohorts[advisor->cohort_count++] = cohort;
+  }
+  return RW_OK;
+}
+
+static int pool_load(AdvisorPool *pool, const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) return RW_ERR_IO;
+  char *line = NULL;
+  size_t len = 0;
+  int line_no = 0;
+  int rc = RW_OK;
+  while (rc == RW_OK && getline(&line, &len, fp) != -1) {
+    line_no++;
+    line[strcspn(line, "\r\n")] = '\0';
+    char *fields[ADVISOR_MAX_FIELDS];
+    int field_count = 0;
+    char *cursor = line;
+    while (field_count < ADVISOR_MAX_FIELDS) {
+      char *token = strsep(&cursor, ",");
+      if (!token) break;
+      fields[field_count++] = trim_field(token);
+    }
+    if (field_count < 2 || fields[0][0] == '\0') continue;
+    if (line_no == 1 && strcmp(fields[0], "advisor") == 0) continue;
+
+    char *interned;
+    int id = rw_dict_intern(&pool->names, &pool->arena, fields[0], &interned);
+    if (id < 0) {
+      rc = RW_ERR_NOMEM;
+      break;
+    }
+    if (id < pool->count) continue; /* repeated advisor: the first row wins */
+    if (pool->count >= pool->capacity) {
+      int capacity = pool->capacity == 0 ? 16 : pool->capacity * 2;
+      Advisor *advisors = realloc(pool->advisors, sizeof(Advisor) * (size_t)capacity);
+      if (!advisors) {
+        rc = RW_ERR_NOMEM;
+        break;
+      }
+      pool->advisors = advisors;
+      pool->capacity = capacity;
+    }
+    Advisor *advisor = &pool->advisors[pool->count++];
+    memset(advisor, 0, sizeof(*advisor));
+    advisor->name = interned;
+    advisor->capacity = atoi(fields[1]);
+    if (advisor->capacity < 0) advisor->capacity = 0;
+    rc = split_affinities(pool, advisor, field_count > 2 ? fields[2] : "");
+  }
+  free(line);
+  if (ferror(fp) && rc == RW_OK) rc = RW_ERR_IO;
+  fclose(fp);
+  return rc;
+}
+
+void rw_pool_free(AdvisorPool *pool) {
+  for (int i = 0; i < pool->count; i++) {
+    free(pool->advisors[i].cohorts);
+  }
+  free(pool->advisors);
+  free(pool->assignment);
+  free(pool->match);
+  free(pool->work_offsets);
+  free(pool->work_ranks);
+  rw_dict_free(&pool->names);
+  rw_arena_free(&pool->arena);
+  memset(pool, 0, sizeof(*pool));
+}
+
+int rw_load_advisors(rw_engine *engine, const char *path) {
+  AdvisorPool *pool = calloc(1, sizeof(AdvisorPool));
+  if (!pool) return RW_ERR_NOMEM;
+  int rc = pool_load(pool, path);
+  if (rc != RW_OK) {
+    rw_pool_free(pool);
+    free(pool);
+    return rc;
+  }
+  if (engine->pool) {
+    rw_pool_free(engine->pool);
+    free(engine->pool);
+  }
+  engine->pool = pool;
+  engine->assigned = 0;
+  return RW_OK;
+}
+
+static int build_worklists(AdvisorPool *pool, int count) {
+  pool->work_offsets = calloc((size_t)pool->count + 1, sizeof(int));
+  pool->work_ranks = malloc(sizeof(int) * (size_t)(pool->assigned > 0 ? pool->assigned : 1));
+  if (!pool->work_offsets || !pool->work_ranks) return RW_ERR_NOMEM;
+  for (int a = 0; a < pool->count; a++) {
+    pool->work_offsets[a + 1] = pool->work_offsets[a] + pool->advisors[a].assigned;
+  }
+  int *fill = malloc(sizeof(int) * (size_t)(pool->count > 0 ? pool->count : 1));
+  if (!fill) return RW_ERR_NOMEM;
+  memcpy(fill, pool->work_offsets, sizeof(int) * (size_t)pool->count);
+  for (int rank = 0; rank < count; rank++) {
+    int a = pool->assignment[rank];
+    if (a >= 0) pool->work_ranks[fill[a]++] = rank;
+  }
+  free(fill);
+  return RW_OK;
+}
+
+int rw_assign(rw_engine *engine, double min_risk, const char *caseload_column) {
+  AdvisorPool *pool = engine->pool;
+  if (!pool || !engine->scored) return RW_ERR_CONFIG;
+  int rc = rw_live_end(engine);
+  if (rc == RW_OK) rc = rw_join_apply(engine);
+  if (rc != RW_OK) return rc;
+
+  int caseload = -1;
+  if (caseload_column) {
+    for (int c = 0; c < rw_join_column_count(engine); c++) {
+      if (strcmp(rw_join_column_name(engine, c), caseload_column) == 0) caseload = c;
+    }
+    if (caseload < 0) return RW_ERR_CONFIG;
+  }
+
+  int count = engine->count;
+  free(pool->assignment);
+  free(pool->match);
+  free(pool->work_offsets);
+  free(pool->work_ranks);
+  pool->work_offsets = NULL;
+  pool->work_ranks = NULL;
+  pool->assignment = malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+  pool->match = malloc((size_t)(count > 0 ? count : 1));
+  if (!pool->assignment || !pool->match) return RW_ERR_NOMEM;
+  pool->assigned = 0;
+  pool->considered = 0;
+  for (int a = 0; a < pool->count; a++) {
+    pool->advisors[a].assigned = 0;
+    pool->advisors[a].risk_sum = 0.0;
+  }
+
+  rw_trace_begin("assign", "assign");
+  int cohort_count = engine->cohort_dict.count;
+  AdvisorHeap *heaps = calloc((size_t)cohort_count + 1, sizeof(AdvisorHeap));
+  AdvisorHeap *any = heaps ? &heaps[cohort_count] : NULL;
+  if (!heaps) rc = RW_ERR_NOMEM;
+  for (int a = 0; rc == RW_OK && a < pool->count; a++) {
+    const Advisor *advisor = &pool->advisors[a];
+    if (advisor->capacity == 0) continue;
+    HeapEntry entry = {advisor->capacity, a};
+    if (advisor->cohort_count == 0) {
+      rc = heap_push(any, entry);
+      continue;
+    }
+    for (int c = 0; rc == RW_OK && c < advisor->cohort_count; c++) {
+      int cohort_id = rw_dict_find(&engine->cohort_dict, advisor->cohorts[c]);
+      if (cohort_id >= 0) rc = heap_push(&heaps[cohort_id], entry);
+    }
+  }
+
+  for (int rank = 0; rc == RW_OK && rank < count; rank++) {
+    const Scholar *s = &engine->scholars[rank];
+    pool->assignment[rank] = -1;
+    pool->match[rank] = -1;
+    if (s->risk_score < min_risk) continue;
+    pool->considered++;
+
+    int chosen = -1;
+    int match = RW_MATCH_CASELOAD;
+    if (caseload >= 0) {
+      const char *name = rw_join_value(engine, rank, caseload);
+      int a = name ? rw_dict_find(&pool->names, name) : -1;
+      if (a >= 0 && pool->advisors[a].assigned < pool->advisors[a].capacity) chosen = a;
+    }
+    AdvisorHeap *heap = NULL;
+    if (chosen < 0) {
+      match = RW_MATCH_COHORT;
+      heap = &heaps[s->cohort_id];
+      chosen = heap_peek(heap, pool->advisors);
+    }
+    if (chosen < 0) {
+      match = RW_MATCH_ANY;
+      heap = any;
+      chosen = heap_peek(heap, pool->advisors);
+    }
+    if (chosen < 0) continue;
+
+    Advisor *advisor = &pool->advisors[chosen];
+    advisor->assigned++;
+    advisor->risk_sum += s->risk_score;
+    pool->assignment[rank] = chosen;
+    pool->match[rank] = (signed char)match;
+    pool->assigned++;
+    /* The chosen advisor is on top of heap; re-key it in place. */
+    if (heap) {
+      int room = advisor->capacity - advisor->assigned;
+      if (room > 0) {
+        heap->items[0].room = room;
+        sift_down(heap, 0);
+      } else {
+        heap_pop(heap);
+      }
+    }
+  }
+
+  for (int c = 0; heaps && c <= cohort_count; c++) {
+    free(heaps[c].items);
+  }
+  free(heaps);
+  if (rc == RW_OK) rc = build_worklists(pool, count);
+  rw_trace_end("assign", "assign", count);
+  if (rc == RW_OK) engine->assigned = 1;
+  return rc;
+}
+
+int rw_advisor_count(const rw_engine *engine) {
+  return engine->pool ? engine->pool->count : 0;
+}
+
+int rw_advisor_at(const rw_engine *engine, int index, rw_advisor *out) {
+  if (!engine->pool || index < 0 || index >= engine->pool->count) return RW_ERR_RANGE;
+  const Advisor *advisor = &engine->pool->advisors[index];
+  out->name = advisor->name;
+  out->capacity = advisor->capacity;
+  out->assigned = engine->assigned ? advisor->assigned : 0;
+  out->avg_risk = out->assigned > 0 ? advisor->risk_sum / (double)advisor->assigned : 0.0;
+  return RW_OK;
+}
+
+int rw_assignment_at(const rw_engine *engine, int rank, int *match) {
+  if (match) *match = -1;
+  if (!engine->assigned || rank < 0 || rank >= engine->count) return -1;
+  if (match) *match = engine->pool->match[rank];
+  return engine->pool->assignment[rank];
+}
+
+int rw_worklist_at(const rw_engine *engine, int advisor, int index) {
+  const AdvisorPool *pool = engine->pool;
+  if (!engine->assigned || advisor < 0 || advisor >= pool->count) return RW_ERR_RANGE;
+  int start = pool->work_offsets[advisor];
+  if (index < 0 || start + index >= pool->work_offsets[advisor + 1]) return RW_ERR_RANGE;
+  return pool->work_ranks[start + index];
+}
+
+void rw_assign_totals(const rw_engine *engine, int *considered, int *assigned) {
+  int done = engine->assigned;
+  *considered = done ? engine->pool->considered : 0;
+  *assigned = done ? engine->pool->assigned : 0;
+}
+
+const char *rw_match_name(int code) {
+  return code >= 0 && code <= RW_MATCH_ANY ? match_names[code] : NULL;
+}
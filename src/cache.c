@@ -0,0 +1,175 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+
+#define CACHE_SUFFIX ".rwsnap"
+#define HASH_CHUNK (1 << 20)
+
+/* The Makefile passes a checksum of the sources; other builds fall back
+ * to when this file was compiled. */
+#ifndef RW_BUILD_ID
+#define RW_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+typedef struct {
+  char *path;
+  time_t used;
+  long long size;
+} CacheEntry;
+
+/* 64-bit multiply-xorshift over 8-byte words; content addressing only,
+ * not a defence against crafted collisions. */
+static uint64_t hash_mix(uint64_t h, uint64_t v) {
+  h ^= v;
+  h *= 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 29;
+  return h;
+}
+
+static uint64_t hash_bytes(uint64_t h, const unsigned char *data, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t v;
+    memcpy(&v, data + i, sizeof(v));
+    h = hash_mix(h, v);
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, data + i, n - i);
+  return hash_mix(h, tail ^ ((uint64_t)(n - i) << 56));
+}
+
+static uint64_t hash_string(uint64_t h, const char *s) {
+  return hash_bytes(h, (const unsigned char *)s, strlen(s) + 1);
+}
+
+static int hash_file(const char *path, uint64_t *hash) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return RW_ERR_IO;
+  unsigned char *buffer = malloc(HASH_CHUNK);
+  if (!buffer) {
+    close(fd);
+    return RW_ERR_NOMEM;
+  }
+
+  uint64_t h = *hash;
+  unsigned long long total = 0;
+  ssize_t n;
+  while ((n = read(fd, buffer, HASH_CHUNK)) > 0) {
+    /* Chunks are full except the last, so word alignment is stable. */
+    h = hash_bytes(h, buffer, (size_t)n);
+    total += (unsigned long long)n;
+  }
+  free(buffer);
+  close(fd);
+  if (n < 0) return RW_ERR_IO;
+  *hash = hash_mix(h, total);
+  return RW_OK;
+}
+
+int cache_key(const char *input_path, const rw_config *config, uint64_t *key) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  int rc = hash_file(input_path, &h);
+  if (rc != RW_OK) return rc;
+  h = hash_bytes(h, (const unsigned char *)&config->high_threshold, sizeof(double));
+  h = hash_bytes(h, (const unsigned char *)&config->medium_threshold, sizeof(double));
+  h = hash_string(h, config->cohort_filter ? config->cohort_filter : "");
+  h = hash_string(h, rw_version());
+  h = hash_string(h, RW_BUILD_ID);
+  *key = h;
+  return RW_OK;
+}
+
+int cache_key_add_file(uint64_t *key, const char *tag, const char *path) {
+  uint64_t h = hash_string(*key, tag);
+  int rc = hash_file(path, &h);
+  if (rc == RW_OK) *key = h;
+  return rc;
+}
+
+void cache_entry_path(const char *dir, uint64_t key, char *out, size_t size) {
+  snprintf(out, size, "%s/%016llx" CACHE_SUFFIX, dir, (unsigned long long)key);
+}
+
+/* A hit refreshes the entry's mtime, which is the LRU clock. */
+int cache_lookup(rw_engine *engine, const char *dir, uint64_t key) {
+  char path[4096];
+  cache_entry_path(dir, key, path, sizeof(path));
+  int rc = rw_snapshot_read(engine, path, key);
+  if (rc == RW_OK) {
+    utimensat(AT_FDCWD, path, NULL, 0);
+  }
+  return rc;
+}
+
+static int compare_entry_used(const void *a, const void *b) {
+  const CacheEntry *ea = a;
+  const CacheEntry *eb = b;
+  if (ea->used < eb->used) return -1;
+  if (ea->used > eb->used) return 1;
+  return strcmp(ea->path, eb->path);
+}
+
+static void cache_evict(const char *dir, const char *keep, long long limit_bytes) {
+  DIR *d = opendir(dir);
+  if (!d) return;
+  CacheEntry *entries = NULL;
+  int count = 0;
+  int capacity = 0;
+  long long total = 0;
+  struct dirent *ent;
+  size_t suffix_len = strlen(CACHE_SUFFIX);
+  while ((ent = readdir(d)) != NULL) {
+    size_t len = strlen(ent->d_name);
+    if (len <= suffix_len || strcmp(ent->d_name + len - suffix_len, CACHE_SUFFIX) != 0) continue;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+    struct stat st;
+    if (stat(path, &st) != 0) continue;
+    if (count >= capacity) {
+      capacity = capacity == 0 ? 16 : capacity * 2;
+      CacheEntry *grown = realloc(entries, sizeof(CacheEntry) * capacity);
+      if (!grown) break;
+      entries = grown;
+    }
+    entries[count].path = strdup(path);
+    entries[count].used = st.st_mtime;
+    entries[count].size = (long long)st.st_size;
+    total += entries[count].size;
+    count++;
+  }
+  closedir(d);
+
+  qsort(entries, count, sizeof(CacheEntry), compare_entry_used);
+  for (int i = 0; i < count && total > limit_bytes; i++) {
+    if (strcmp(entries[i].path, keep) == 0) continue;
+    if (unlink(entries[i].path) == 0) total -= entries[i].size;
+  }
+  for (int i = 0; i < count; i++) {
+    free(entries[i].path);
+  }
+  free(entries);
+}
+
+int cache_store(rw_engine *engine, const char *dir, uint64_t key, long long limit_bytes) {
+  if (mkdir(dir, 0777) != 0 && errno != EEXIST) return RW_ERR_IO;
+  char path[4096];
+  char tmp_path[4160];
+  cache_entry_path(dir, key, path, sizeof(path));
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+  int rc = rw_snapshot_write(engine, tmp_path, key);
+  if (rc == RW_OK && rename(tmp_path, path) != 0) rc = RW_ERR_IO;
+  if (rc != RW_OK) {
+    remove(tmp_path);
+    return rc;
+  }
+  cache_evict(dir, path, limit_bytes);
+  return RW_OK;
+}
@@ -0,0 +1,22 @@
+#ifndef RETENTION_CACHE_H
+#define RETENTION_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "retention.h"
+
+/* Content-addressed result cache for the CLI: entries are snapshots named
+ * by a key over the input bytes, the scoring configuration and the build,
+ * evicted least-recently-used once the directory exceeds its byte budget. */
+
+#define CACHE_DEFAULT_LIMIT_MB 256
+
+int cache_key(const char *input_path, const rw_config *config, uint64_t *key);
+/* Folds a tagged side input (such as an id list) into the key. */
+int cache_key_add_file(uint64_t *key, const char *tag, const char *path);
+void cache_entry_path(const char *dir, uint64_t key, char *out, size_t size);
+int cache_lookup(rw_engine *engine, const char *dir, uint64_t key);
+int cache_store(rw_engine *engine, const char *dir, uint64_t key, long long limit_bytes);
+
+#endif
@@ -0,0 +1,352 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+#define CHANGE_MAX_FIELDS 16
+#define CHANGE_ROSTER_FIELDS 11
+#define CHANGE_UPSERT 0
+#define CHANGE_DELETE 1
+
+/* Change streams: upsert/delete records keyed by scholar_id, applied to a
+ * scored roster in place. The change ids are hashed (the last record for
+ * an id wins) and the ranked roster is probed once to find their rows.
+ * Changed and deleted rows are taken out, the upserts are rescored and
+ * sorted among themselves, and one merge from the back puts them in rank
+ * order, so only the k changed scholars are scored and sorted. Current
+ * aggregates are adjusted by taking back the old rows and adding the new
+ * ones instead of being rebuilt. */
+
+typedef struct {
+  int op;
+  int rank;
+  Scholar row;
+} Change;
+
+typedef struct {
+  Change *items;
+  int count;
+  int capacity;
+  StringDict ids;
+  StringArena arena;
+} ChangeSet;
+
+static char *trim_field(char *s) {
+  while (*s && isspace((unsigned char)*s)) s++;
+  char *end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1])) end--;
+  *end = '\0';
+  return s;
+}
+
+static double field_double(const char *s) {
+  return *s ? atof(s) : 0.0;
+}
+
+static int compare_risk_desc(const void *a, const void *b) {
+  const Scholar *sa = a;
+  const Scholar *sb = b;
+  if (sa->risk_score < sb->risk_score) return 1;
+  if (sa->risk_score > sb->risk_score) return -1;
+  return 0;
+}
+
+static void change_set_free(ChangeSet *set) {
+  free(set->items);
+  rw_dict_free(&set->ids);
+  rw_arena_free(&set->arena);
+}
+
+/* Parses one change line in place. Upserts the cohort filter rejects turn
+ * into deletes, since the scholar has left the filtered roster. */
+static int parse_change(const rw_engine *engine, ChangeSet *set, char *line, rw_changes_stats *stats) {
+  char *fields[CHANGE_MAX_FIELDS];
+  int field_count = 0;
+  char *cursor = line;
+  while (field_count < CHANGE_MAX_FIELDS) {
+    char *token = strsep(&cursor, ",");
+    if (!token) break;
+    fields[field_count++] = trim_field(token);
+  }
+  if (field_count == 1 && fields[0][0] == '\0') return RW_OK;
+  if (field_count >= 2 && strcmp(fields[1], "scholar_id") == 0) return RW_OK;
+
+  stats->rows++;
+  int op;
+  if (field_count >= 2 && strcmp(fields[0], "delete") == 0) op = CHANGE_DELETE;
+  else if (field_count >= CHANGE_ROSTER_FIELDS && strcmp(fields[0], "upsert") == 0) op = CHANGE_UPSERT;
+  else op = -1;
+  if (op < 0 || fields[1][0] == '\0') {
+    stats->skipped++;
+    return RW_OK;
+  }
+  if (!rw_id_allowed(engine, fields[1])) {
+    stats->filtered++;
+    return RW_OK;
+  }
+  if (op == CHANGE_UPSERT && engine->cohort_filter && strcmp(fields[3], engine->cohort_filter) != 0) {
+    stats->filtered++;
+    op = CHANGE_DELETE;
+  }
+
+  char *id;
+  int index = rw_dict_intern(&set->ids, &set->arena, fields[1], &id);
+  if (index < 0) return RW_ERR_NOMEM;
+  if (index == set->count) {
+    if (set->count >= set->capacity) {
+      int capacity = set->capacity == 0 ? 64 : set->capacity * 2;
+      Change *items = realloc(set->items, sizeof(Change) * (size_t)capacity);
+      if (!items) return RW_ERR_NOMEM;
+      set->items = items;
+      set->capacity = capacity;
+    }
+    set->count++;
+  }
+  Change *change = &set->items[index];
+  change->op = op;
+  change->rank = -1;
+  memset(&change->row, 0, sizeof(change->row));
+  change->row.id = id;
+  if (op == CHANGE_UPSERT) {
+    change->row.name = rw_arena_strdup(&set->arena, fields[2]);
+    change->row.cohort = rw_arena_strdup(&set->arena, fields[3]);
+    if (!change->row.name || !change->row.cohort) return RW_ERR_NOMEM;
+    change->row.days_inactive = field_double(fields[4]);
+    change->row.attendance_rate = field_double(fields[5]);
+    change->row.engagement_score = field_double(fields[6]);
+    change->row.gpa = field_double(fields[7]);
+    change->row.last_contact_days = field_double(fields[8]);
+    change->row.survey_score = field_double(fields[9]);
+    change->row.open_flags = *fields[10] ? atoi(fields[10]) : 0;
+  }
+  return RW_OK;
+}
+
+/* Builds the roster row for an upsert. An existing scholar keeps its id
+ * and its event-derived trends; a new one gets copies in the engine arena.
+ * Only allocates, so a failure leaves the roster as it was. */
+static int fill_upsert(rw_engine *engine, const Change *change, const Scholar *old, Scholar *out) {
+  *out = change->row;
+  if (old) {
+    out->id = old->id;
+    out->attendance_trend = old->attendance_trend;
+    out->engagement_trend = old->engagement_trend;
+  } else {
+    out->id = rw_arena_strdup(&engine->arena, change->row.id);
+    out->attendance_trend = NAN;
+    out->engagement_trend = NAN;
+  }
+  out->name = rw_arena_strdup(&engine->arena, change->row.name);
+  out->cohort_id = rw_dict_intern(&engine->cohort_dict, &engine->arena, change->row.cohort, &out->cohort);
+  if (!out->id || !out->name || out->cohort_id < 0) return RW_ERR_NOMEM;
+  out->risk_score = rw_compute_risk(out);
+  return RW_OK;
+}
+
+/* Live engines take each change as an O(log n) unlink and relink in the
+ * index; the aggregates are always current there. */
+static int apply_live(rw_engine *engine, ChangeSet *set, rw_changes_stats *stats) {
+  int old_dict_count = engine->cohort_dict.count;
+  int rc = RW_OK;
+  for (int c = 0; rc == RW_OK && c < set->count; c++) {
+    const Change *change = &set->items[c];
+    int slot = rw_live_slot(engine, change->row.id);
+    Scholar row;
+    if (change->op == CHANGE_UPSERT) {
+      rc = fill_upsert(engine, change, slot >= 0 ? &engine->scholars[slot] : NULL, &row);
+      if (rc != RW_OK) break;
+    }
+    if (slot >= 0) {
+      rc = rw_aggregate_scholar(engine, &engine->scholars[slot], -1);
+      if (rc != RW_OK) break;
+      rw_live_unlink(engine, slot);
+    }
+    if (change->op == CHANGE_UPSERT) {
+      rc = rw_aggregate_grow(engine, old_dict_count);
+      old_dict_count = engine->cohort_dict.count;
+      if (rc != RW_OK) break;
+      int linked = rw_live_link(engine, &row);
+      if (linked < 0) {
+        rc = RW_ERR_NOMEM;
+        break;
+      }
+      rc = rw_aggregate_scholar(engine, &engine->scholars[linked], 1);
+      if (rc != RW_OK) break;
+      if (slot >= 0) stats->updated++;
+      else stats->inserted++;
+      stats->rescored++;
+    } else if (slot >= 0) {
+      stats->deleted++;
+    } else {
+      stats->missing++;
+    }
+  }
+  if (rc == RW_OK) rc = rw_aggregate_refresh(engine);
+  if (rc != RW_OK) rw_invalidate(engine);
+  return rc;
+}
+
+static int apply_change_set(rw_engine *engine, ChangeSet *set, rw_changes_stats *stats) {
+  if (set->count == 0) return RW_OK;
+  if (engine->live) return apply_live(engine, set, stats);
+
+  rw_trace_begin("changes", "changes");
+  Scholar *scholars = engine->scholars;
+  int count = engine->count;
+  int first_rank = count;
+  for (int i = 0; i < count; i++) {
+    int index = rw_dict_find(&set->ids, scholars[i].id);
+    if (index < 0) continue;
+    set->items[index].rank = i;
+    if (i < first_rank) first_rank = i;
+  }
+
+  /* A joined roster keeps per-rank join rows, so it is joined and
+   * aggregated again instead. */
+  int incremental = engine->aggregated && !engine->join;
+  if (engine->join) {
+    engine->join_applied = 0;
+    engine->aggregated = 0;
+  }
+  int old_dict_count = engine->cohort_dict.count;
+
+  Scholar *fresh = malloc(sizeof(Scholar) * (size_t)set->count);
+  if (!fresh) {
+    rw_trace_end("changes", "changes", 0);
+    return RW_ERR_NOMEM;
+  }
+  /* Out of memory stops at the failed change; the ones before it are
+   * still merged, and the aggregates dropped. */
+  int rc = RW_OK;
+  int fresh_count = 0;
+  for (int c = 0; c < set->count; c++) {
+    const Change *change = &set->items[c];
+    Scholar *old = change->rank >= 0 ? &scholars[change->rank] : NULL;
+    if (change->op == CHANGE_UPSERT) {
+      rc = fill_upsert(engine, change, old, &fresh[fresh_count]);
+      if (rc != RW_OK) break;
+      fresh_count++;
+    }
+    if (old && incremental && rw_aggregate_scholar(engine, old, -1) != RW_OK) {
+      /* Aggregated again on the next read instead. */
+      incremental = 0;
+      engine->aggregated = 0;
+    }
+    if (change->op == CHANGE_UPSERT) {
+      if (old) stats->updated++;
+      else stats->inserted++;
+    } else if (old) {
+      stats->deleted++;
+    } else {
+      stats->missing++;
+    }
+    if (old) old->id = NULL;
+  }
+
+  int kept = first_rank;
+  for (int i = first_rank; i < count; i++) {
+    if (scholars[i].id) scholars[kept++] = scholars[i];
+  }
+  engine->count = kept;
+  int total = kept + fresh_count;
+  if (total > engine->capacity) {
+    Scholar *grown = realloc(engine->scholars, sizeof(Scholar) * (size_t)total);
+    if (!grown) {
+      free(fresh);
+      rw_invalidate(engine);
+      rw_trace_end("changes", "changes", 0);
+      return RW_ERR_NOMEM;
+    }
+    engine->scholars = scholars = grown;
+    engine->capacity = total;
+  }
+
+  /* Ties keep the scholars already ranked ahead of the changed ones. */
+  qsort(fresh, (size_t)fresh_count, sizeof(Scholar), compare_risk_desc);
+  int i = kept - 1;
+  int j = fresh_count - 1;
+  for (int out = total - 1; j >= 0; out--) {
+    if (i >= 0 && scholars[i].risk_score < fresh[j].risk_score) scholars[out] = scholars[i--];
+    else scholars[out] = fresh[j--];
+  }
+  engine->count = total;
+  engine->assigned = 0;
+
+  if (rc != RW_OK) {
+    engine->aggregated = 0;
+  } else if (incremental) {
+    rc = rw_aggregate_grow(engine, old_dict_count);
+    for (int f = 0; rc == RW_OK && f < fresh_count; f++) rc = rw_aggregate_scholar(engine, &fresh[f], 1);
+    if (rc == RW_OK) rc = rw_aggregate_refresh(engine);
+    if (rc != RW_OK) engine->aggregated = 0;
+  }
+  free(fresh);
+  stats->rescored += fresh_count;
+  rw_trace_end("changes", "changes", set->count);
+  return rc;
+}
+
+/* Applies the parsed set and releases it. */
+static int finish_changes(rw_engine *engine, ChangeSet *set, int rc, rw_changes_stats *stats) {
+  rw_stage_end(STAGE_PARSE, stats->rows);
+  if (rc == RW_OK) {
+    rw_stage_begin(STAGE_SCORE);
+    rc = apply_change_set(engine, set, stats);
+    rw_stage_end(STAGE_SCORE, stats->rescored);
+  }
+  change_set_free(set);
+  return rc;
+}
+
+int rw_apply_changes_file(rw_engine *engine, const char *path, rw_changes_stats *stats) {
+  rw_changes_stats local;
+  if (!stats) stats = &local;
+  memset(stats, 0, sizeof(*stats));
+  if (!engine->scored) return RW_ERR_CONFIG;
+  FILE *fp = fopen(path, "r");
+  if (!fp) return RW_ERR_IO;
+
+  ChangeSet set;
+  memset(&set, 0, sizeof(set));
+  char *line = NULL;
+  size_t len = 0;
+  int rc = RW_OK;
+  rw_stage_begin(STAGE_PARSE);
+  while (rc == RW_OK && getline(&line, &len, fp) != -1) {
+    line[strcspn(line, "\r\n")] = '\0';
+    rc = parse_change(engine, &set, line, stats);
+  }
+  free(line);
+  if (ferror(fp) && rc == RW_OK) rc = RW_ERR_IO;
+  fclose(fp);
+  return finish_changes(engine, &set, rc, stats);
+}
+
+int rw_apply_changes_buffer(rw_engine *engine, const char *data, size_t size, rw_changes_stats *stats) {
+  rw_changes_stats local;
+  if (!stats) stats = &local;
+  memset(stats, 0, sizeof(*stats));
+  if (!engine->scored) return RW_ERR_CONFIG;
+  char *copy = malloc(size + 1);
+  if (!copy) return RW_ERR_NOMEM;
+  memcpy(copy, data, size);
+  copy[size] = '\0';
+
+  ChangeSet set;
+  memset(&set, 0, sizeof(set));
+  int rc = RW_OK;
+  rw_stage_begin(STAGE_PARSE);
+  char *cursor = copy;
+  while (rc == RW_OK && cursor) {
+    char *line = strsep(&cursor, "\n");
+    line[strcspn(line, "\r")] = '\0';
+    rc = parse_change(engine, &set, line, stats);
+  }
+  free(copy);
+  return finish_changes(engine, &set, rc, stats);
+}
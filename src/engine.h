@@ -0,0 +1,281 @@
+#ifndef RETENTION_ENGINE_H
+#define RETENTION_ENGINE_H
+
+/* Internal engine layout shared by the libretention translation units. Not
+ * installed; embedders use retention.h. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "retention.h"
+
+typedef struct {
+  char *id;
+  char *name;
+  char *cohort;
+  double days_inactive;
+  double attendance_rate;
+  double engagement_score;
+  double gpa;
+  double last_contact_days;
+  double survey_score;
+  int open_flags;
+  int cohort_id;
+  /* 7-day minus 30-day attendance and engagement from -events; NaN
+   * without windowed data. */
+  float attendance_trend;
+  float engagement_trend;
+  double risk_score;
+} Scholar;
+
+/* Welford running moments: mean and m2 (the sum of squared deviations)
+ * take one update per value without the cancellation of a sum of
+ * squares, and two partial results merge exactly (Chan et al.). min_count
+ * and max_count are the values sitting at each bound; a bound goes NaN
+ * (lost) only when a removal takes the last of them. */
+typedef struct {
+  int count;
+  double mean;
+  double m2;
+  double min;
+  double max;
+  int min_count;
+  int max_count;
+} RunningStats;
+
+typedef struct {
+  char *name;
+  int total;
+  int high;
+  int medium;
+  int low;
+  double risk_sum;
+  /* Per RW_COL_* column below RW_STAT_COLUMNS; unused for groups. */
+  RunningStats stats[RW_STAT_COLUMNS];
+} CohortSummary;
+
+typedef struct LiveIndex LiveIndex;
+typedef struct ShmSegment ShmSegment;
+typedef struct Sampler Sampler;
+
+typedef struct {
+  /* Borrowed from the static action names. */
+  const char *action;
+  int total;
+  int high;
+  int medium;
+  int low;
+  double risk_sum;
+} ActionSummary;
+
+/* Bump allocator for roster strings. Blocks grow geometrically, so loading n
+ * rows costs O(log n) allocations and everything is released at once. */
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t used;
+  size_t size;
+  char data[];
+} ArenaBlock;
+
+typedef struct {
+  ArenaBlock *head;
+  size_t next_size;
+} StringArena;
+
+/* Open-addressing map from interned string to a dense id (insertion order). */
+typedef struct {
+  char **keys;
+  int *ids;
+  int capacity;
+  int count;
+} StringDict;
+
+typedef struct {
+  uint64_t *bloom;
+  uint64_t bloom_mask;
+  char **keys;
+  uint64_t *hashes;
+  size_t capacity;
+  size_t count;
+  StringArena arena;
+} IdSet;
+
+/* Secondary CSV attached with -join. Row r's value for column c is
+ * values[r * column_count + c]; keys maps the key column to r. */
+typedef struct {
+  char **columns;
+  int column_count;
+  char **values;
+  int rows;
+  int row_capacity;
+  StringDict keys;
+  StringArena arena;
+  /* Group id per row for -group-by, interned in groups; -1 when unset. */
+  int group_column;
+  StringDict groups;
+  int *row_groups;
+} JoinTable;
+
+/* Advisors for rw_assign, in file order. cohorts lists the cohort names
+ * the advisor takes; none means any cohort. */
+typedef struct {
+  char *name;
+  int capacity;
+  char **cohorts;
+  int cohort_count;
+  int assigned;
+  double risk_sum;
+} Advisor;
+
+typedef struct {
+  Advisor *advisors;
+  int count;
+  int capacity;
+  StringDict names;
+  StringArena arena;
+  /* Advisor and match kind per rank (-1 when unassigned), and the work
+   * lists: advisor a's ranks are work_ranks[work_offsets[a]..[a + 1]). */
+  int *assignment;
+  signed char *match;
+  int *work_offsets;
+  int *work_ranks;
+  int assigned;
+  int considered;
+} AdvisorPool;
+
+struct rw_engine {
+  double high_threshold;
+  double medium_threshold;
+  char *cohort_filter;
+  IdSet *include_ids;
+  IdSet *exclude_ids;
+  JoinTable *join;
+  int where_column;
+  char *where_value;
+
+  StringArena arena;
+  StringDict cohort_dict;
+  Scholar *scholars;
+  int count;
+  int capacity;
+  int rows_read;
+  int skipped;
+  int filtered;
+  int scored;
+  /* Set by rw_live_begin: scholars is then slot storage and the ranking
+   * lives in the index. */
+  LiveIndex *live;
+  /* Backing store for strings of a roster read from a snapshot. */
+  char *snapshot_data;
+  /* Join row per rank (-1 when unmatched), valid while join_applied. */
+  int *join_rows;
+  int join_applied;
+  AdvisorPool *pool;
+  /* Set by rw_assign; cleared whenever ranks move. */
+  int assigned;
+
+  int aggregated;
+  /* Set once rw_stats_prepare has filled the cohort moments; changes keep
+   * them current from then on. */
+  int moments;
+  /* Set when a removal lost a cohort bound; rw_cohort_stats_at rescans. */
+  int bounds_lost;
+  int high;
+  int medium;
+  int low;
+  double total_risk;
+  CohortSummary *cohorts;
+  int cohort_count;
+  int cohort_capacity;
+  int *cohort_slots;
+  ActionSummary *actions;
+  int action_count;
+  int action_capacity;
+  CohortSummary **cohort_focus;
+  ActionSummary **action_focus;
+  CohortSummary *groups;
+  int group_count;
+  int group_capacity;
+  int *group_slots;
+
+  /* Segment kept mapped between rw_shm_publish calls. */
+  ShmSegment *shm;
+  /* Set by rw_sample_set: loads keep only a sample of the rows. */
+  Sampler *sampler;
+};
+
+char *rw_arena_strdup(StringArena *arena, const char *s);
+void rw_arena_free(StringArena *arena);
+uint64_t rw_hash_string(const char *s);
+int rw_dict_intern(StringDict *dict, StringArena *arena, const char *key, char **interned);
+int rw_dict_find(const StringDict *dict, const char *key);
+void rw_dict_free(StringDict *dict);
+
+int rw_idset_load(IdSet *set, const char *path);
+int rw_idset_contains(const IdSet *set, const char *id, uint64_t hash);
+void rw_idset_free(IdSet *set);
+/* Applies the include/exclude id sets; 1 when the scholar is kept. */
+int rw_id_allowed(const rw_engine *engine, const char *id);
+
+/* Drops scoring, aggregates, join and assignment after the roster changes. */
+void rw_invalidate(rw_engine *engine);
+/* Adds (sign 1) or takes back (sign -1) one scholar's share of the totals
+ * and of its cohort and action summaries; RW_ERR_NOMEM when a new summary
+ * cannot be stored. rw_aggregate_refresh then drops emptied summaries and
+ * re-sorts the focus lists. */
+int rw_aggregate_scholar(rw_engine *engine, const Scholar *s, int sign);
+int rw_aggregate_refresh(rw_engine *engine);
+/* Grows cohort_slots after cohorts were interned beyond old_count. */
+int rw_aggregate_grow(rw_engine *engine, int old_count);
+
+/* Live index (live.c). rw_live_slot is -1 for a scholar not in the
+ * roster; rw_live_link stores row (its id must not be linked) and returns
+ * its slot, or -1 when out of memory. */
+void rw_live_free(LiveIndex *live);
+int rw_live_slot(const rw_engine *engine, const char *id);
+void rw_live_unlink(rw_engine *engine, int slot);
+int rw_live_link(rw_engine *engine, const Scholar *row);
+const Scholar *rw_live_at(const rw_engine *engine, int rank);
+int rw_live_rank(const rw_engine *engine, int slot);
+/* Writes the slots in rank order into slots (room for engine->count). */
+int rw_live_order(const rw_engine *engine, int *slots);
+int rw_live_count_at_least(const rw_engine *engine, double min_risk);
+void rw_shm_free(ShmSegment *segment);
+/* Sampling decision for the next row offered: RW_SAMPLE_DROP, RW_SAMPLE_APPEND,
+ * or the index of the reservoir row it replaces. */
+#define RW_SAMPLE_DROP -2
+#define RW_SAMPLE_APPEND -1
+int rw_sample_next(rw_engine *engine);
+void rw_sampler_free(Sampler *sampler);
+/* Running moments (stats.c). Values that are not numbers are skipped. */
+double rw_stat_value(const Scholar *s, int column);
+void rw_stats_add(RunningStats *stats, double value);
+void rw_stats_remove(RunningStats *stats, double value);
+void rw_stats_merge(RunningStats *into, const RunningStats *from);
+double rw_stats_zscore(const RunningStats *stats, double value);
+/* Moments of the ranked roster per cohort id, into the zeroed
+ * out[cohort_id * RW_STAT_COLUMNS + column]. The rows are split into
+ * parts by count alone and the parts merged in order, so the result does
+ * not depend on the thread count. */
+int rw_stats_by_cohort(const rw_engine *engine, RunningStats *out);
+/* Rebuilds the min and max that removals lost (NaN), for every cohort in
+ * one pass over the roster. Only reads of the range need it. */
+int rw_stats_rebound(rw_engine *engine);
+/* Fills the cohort moments of an aggregated engine on first use, and with
+ * bounds set also rebuilds lost ranges. Every reader of the moments calls
+ * it first, so engines that never read them skip the pass. */
+int rw_stats_prepare(const rw_engine *engine, int bounds);
+void rw_join_free(JoinTable *join);
+void rw_pool_free(AdvisorPool *pool);
+/* Group id of the scholar at rank for -group-by; -1 when not grouping. The
+ * unmatched group is groups.count. */
+int rw_join_group_of(const rw_engine *engine, int rank);
+const char *rw_join_group_name(const rw_engine *engine, int group);
+
+double rw_compute_risk(const Scholar *s);
+int rw_tier_code(double score, double high_threshold, double medium_threshold);
+const char *rw_risk_tier(double score, double high_threshold, double medium_threshold);
+int rw_action_code(const Scholar *s);
+const char *rw_action_hint(const Scholar *s);
+
+#endif
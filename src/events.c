@@ -0,0 +1,515 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+#define EVENTS_MAX_THREADS 64
+#define EVENTS_BYTES_PER_THREAD (1 << 20)
+#define EVENT_TABLE_MIN_CAPACITY 1024
+#define EVENT_ID_MAX 256
+#define ENGAGED_PER_WEEK 3.0
+#define NO_DAY INT_MIN
+#define RING_DAYS 32
+#define RING_COUNT_BITS 7
+#define RING_COUNT_MAX ((1u << RING_COUNT_BITS) - 1)
+#define RING_TAG_SHIFT (3 * RING_COUNT_BITS)
+#define RING_COUNTS_MASK ((1u << RING_TAG_SHIFT) - 1)
+#define RING_DAY_LIMIT (RING_DAYS << (32 - RING_TAG_SHIFT))
+
+/* Raw event ingest. The log is mapped once and cut into one byte range per
+ * worker at line boundaries. Each worker parses its range into its own
+ * tables, one per partition (id hash modulo the worker count), so parsing
+ * takes no locks. Worker p then folds partition p of every other worker
+ * into its own, and the roster probes partition hash % workers. Scholar
+ * state is a few counters and last-seen days, so merging is max and sum.
+ *
+ * The 7- and 30-day windows come from a ring of RING_DAYS day buckets per
+ * scholar. A bucket packs the day's attended, absent and engaged counts
+ * (saturating at RING_COUNT_MAX) under a tag of day / RING_DAYS, so a
+ * bucket is reused by the next lap and a bucket whose tag does not match
+ * the day asked for is simply empty for that day. States live in a dense
+ * array behind the hash slots so the table's empty half costs four bytes
+ * a slot rather than a whole ring. */
+
+typedef struct {
+  int last_activity;
+  int last_contact;
+  int attended;
+  int absent;
+  int engaged;
+  int events;
+  int matched;
+  uint32_t ring[RING_DAYS];
+} EventState;
+
+typedef struct {
+  char **keys;
+  uint64_t *hashes;
+  uint32_t *slots; /* index into states */
+  EventState *states;
+  size_t capacity;
+  size_t count;
+  size_t state_capacity;
+} EventTable;
+
+typedef struct EventWorker {
+  const char *begin;
+  const char *end;
+  struct EventWorker *workers;
+  int worker_count;
+  int index;
+  EventTable *tables;
+  StringArena arena;
+  int as_of_day;
+  int min_day;
+  int max_day;
+  long long events;
+  long long skipped;
+  long long unknown;
+  int rc;
+} EventWorker;
+
+/* Days since 1970-01-01 (proleptic Gregorian), or NO_DAY when s is not a
+ * YYYY-MM-DD date. */
+static int parse_day(const char *s, size_t len) {
+  if (len < 10 || s[4] != '-' || s[7] != '-') return NO_DAY;
+  int digits[8];
+  const int at[8] = {0, 1, 2, 3, 5, 6, 8, 9};
+  for (int i = 0; i < 8; i++) {
+    char c = s[at[i]];
+    if (c < '0' || c > '9') return NO_DAY;
+    digits[i] = c - '0';
+  }
+  int y = digits[0] * 1000 + digits[1] * 100 + digits[2] * 10 + digits[3];
+  int m = digits[4] * 10 + digits[5];
+  int d = digits[6] * 10 + digits[7];
+  if (y < 1970 || m < 1 || m > 12 || d < 1 || d > 31) return NO_DAY;
+  y -= m <= 2;
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static size_t partition_of(uint64_t hash, int partitions) {
+  return (size_t)((hash >> 40) % (uint64_t)partitions);
+}
+
+static void state_init(EventState *st) {
+  memset(st, 0, sizeof(*st));
+  st->last_activity = NO_DAY;
+  st->last_contact = NO_DAY;
+}
+
+static uint32_t ring_tag(int day) {
+  return (uint32_t)day / RING_DAYS;
+}
+
+static uint32_t ring_count(uint32_t bucket, int kind) {
+  return (bucket >> (RING_COUNT_BITS * (2 - kind))) & RING_COUNT_MAX;
+}
+
+/* Adds the counts of bucket from into bucket into. Buckets with different
+ * tags hold different days in the same slot; the later day wins. */
+static uint32_t ring_merge_bucket(uint32_t into, uint32_t from) {
+  if ((from & RING_COUNTS_MASK) == 0) return into;
+  if ((into & RING_COUNTS_MASK) == 0 || (from >> RING_TAG_SHIFT) > (into >> RING_TAG_SHIFT)) return from;
+  if ((from >> RING_TAG_SHIFT) < (into >> RING_TAG_SHIFT)) return into;
+  uint32_t merged = into & ~RING_COUNTS_MASK;
+  for (int kind = 0; kind < 3; kind++) {
+    uint32_t sum = ring_count(into, kind) + ring_count(from, kind);
+    if (sum > RING_COUNT_MAX) sum = RING_COUNT_MAX;
+    merged |= sum << (RING_COUNT_BITS * (2 - kind));
+  }
+  return merged;
+}
+
+static void ring_add(EventState *st, int day, int kind) {
+  if (day >= RING_DAY_LIMIT) return;
+  uint32_t *bucket = &st->ring[day % RING_DAYS];
+  *bucket = ring_merge_bucket(*bucket, ring_tag(day) << RING_TAG_SHIFT | 1u << (RING_COUNT_BITS * (2 - kind)));
+}
+
+static void state_merge(EventState *into, const EventState *from) {
+  if (from->last_activity > into->last_activity) into->last_activity = from->last_activity;
+  if (from->last_contact > into->last_contact) into->last_contact = from->last_contact;
+  into->attended += from->attended;
+  into->absent += from->absent;
+  into->engaged += from->engaged;
+  into->events += from->events;
+  for (int i = 0; i < RING_DAYS; i++) into->ring[i] = ring_merge_bucket(into->ring[i], from->ring[i]);
+}
+
+static int table_grow(EventTable *table) {
+  size_t capacity = table->capacity == 0 ? EVENT_TABLE_MIN_CAPACITY : table->capacity * 2;
+  char **keys = calloc(capacity, sizeof(char *));
+  uint64_t *hashes = malloc(sizeof(uint64_t) * capacity);
+  uint32_t *slots = malloc(sizeof(uint32_t) * capacity);
+  EventState *states = realloc(table->states, sizeof(EventState) * (capacity / 2));
+  if (states) {
+    table->states = states;
+    table->state_capacity = capacity / 2;
+  }
+  if (!keys || !hashes || !slots || !states) {
+    free(keys);
+    free(hashes);
+    free(slots);
+    return RW_ERR_NOMEM;
+  }
+  size_t mask = capacity - 1;
+  for (size_t i = 0; i < table->capacity; i++) {
+    if (!table->keys[i]) continue;
+    size_t j = table->hashes[i] & mask;
+    while (keys[j]) j = (j + 1) & mask;
+    keys[j] = table->keys[i];
+    hashes[j] = table->hashes[i];
+    slots[j] = table->slots[i];
+  }
+  free(table->keys);
+  free(table->hashes);
+  free(table->slots);
+  table->keys = keys;
+  table->hashes = hashes;
+  table->slots = slots;
+  table->capacity = capacity;
+  return RW_OK;
+}
+
+static EventState *table_find(const EventTable *table, const char *id, uint64_t hash) {
+  if (table->capacity == 0) return NULL;
+  size_t mask = table->capacity - 1;
+  size_t i = hash & mask;
+  while (table->keys[i]) {
+    if (table->hashes[i] == hash && strcmp(table->keys[i], id) == 0) return &table->states[table->slots[i]];
+    i = (i + 1) & mask;
+  }
+  return NULL;
+}
+
+/* Finds or adds id; a new key is stored as given (arena is NULL) or copied
+ * into arena. Returns NULL when out of memory. */
+static EventState *table_upsert(EventTable *table, StringArena *arena, char *id, uint64_t hash) {
+  if ((table->count + 1) * 2 > table->capacity && table_grow(table) != RW_OK) return NULL;
+  size_t mask = table->capacity - 1;
+  size_t i = hash & mask;
+  while (table->keys[i]) {
+    if (table->hashes[i] == hash && strcmp(table->keys[i], id) == 0) return &table->states[table->slots[i]];
+    i = (i + 1) & mask;
+  }
+  char *key = arena ? rw_arena_strdup(arena, id) : id;
+  if (!key) return NULL;
+  table->keys[i] = key;
+  table->hashes[i] = hash;
+  table->slots[i] = (uint32_t)table->count;
+  EventState *st = &table->states[table->count++];
+  state_init(st);
+  return st;
+}
+
+static void table_free(EventTable *table) {
+  free(table->keys);
+  free(table->hashes);
+  free(table->slots);
+  free(table->states);
+  memset(table, 0, sizeof(*table));
+}
+
+static const char *trim_span(const char *s, const char *end, size_t *len) {
+  while (s < end && (*s == ' ' || *s == '\t')) s++;
+  while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+  *len = (size_t)(end - s);
+  return s;
+}
+
+static int span_is(const char *s, size_t len, const char *word) {
+  return strlen(word) == len && memcmp(s, word, len) == 0;
+}
+
+static void parse_event(EventWorker *w, const char *line, const char *end) {
+  const char *c1 = memchr(line, ',', (size_t)(end - line));
+  const char *c2 = c1 ? memchr(c1 + 1, ',', (size_t)(end - c1 - 1)) : NULL;
+  size_t id_len, type_len, date_len;
+  const char *id = trim_span(line, c1 ? c1 : end, &id_len);
+  if (!c2) {
+    if (id_len > 0) w->skipped++;
+    return;
+  }
+  const char *type = trim_span(c1 + 1, c2, &type_len);
+  const char *date = trim_span(c2 + 1, end, &date_len);
+  if (span_is(id, id_len, "scholar_id")) return;
+
+  int day = parse_day(date, date_len);
+  if (id_len == 0 || id_len >= EVENT_ID_MAX || day == NO_DAY || day > w->as_of_day) {
+    w->skipped++;
+    return;
+  }
+  int kind;
+  if (span_is(type, type_len, "attended")) kind = 0;
+  else if (span_is(type, type_len, "absent")) kind = 1;
+  else if (span_is(type, type_len, "engaged")) kind = 2;
+  else if (span_is(type, type_len, "contact")) kind = 3;
+  else {
+    w->unknown++;
+    return;
+  }
+
+  char key[EVENT_ID_MAX];
+  memcpy(key, id, id_len);
+  key[id_len] = '\0';
+  uint64_t hash = rw_hash_string(key);
+  EventState *st = table_upsert(&w->tables[partition_of(hash, w->worker_count)], &w->arena, key, hash);
+  if (!st) {
+    w->rc = RW_ERR_NOMEM;
+    return;
+  }
+  w->events++;
+  st->events++;
+  if (day < w->min_day) w->min_day = day;
+  if (day > w->max_day) w->max_day = day;
+  if (kind < 3) ring_add(st, day, kind);
+  switch (kind) {
+    case 0:
+      st->attended++;
+      if (day > st->last_activity) st->last_activity = day;
+      break;
+    case 1:
+      st->absent++;
+      break;
+    case 2:
+      st->engaged++;
+      if (day > st->last_activity) st->last_activity = day;
+      break;
+    default:
+      if (day > st->last_contact) st->last_contact = day;
+      break;
+  }
+}
+
+static void *parse_range(void *arg) {
+  EventWorker *w = arg;
+  rw_trace_begin("events chunk", "chunk");
+  const char *p = w->begin;
+  long long lines = 0;
+  while (p < w->end && w->rc == RW_OK) {
+    const char *newline = memchr(p, '\n', (size_t)(w->end - p));
+    const char *line_end = newline ? newline : w->end;
+    parse_event(w, p, line_end);
+    p = line_end + 1;
+    lines++;
+  }
+  rw_trace_end("events chunk", "chunk", (long)lines);
+  return NULL;
+}
+
+/* Folds partition index of every other worker into this worker's table;
+ * keys keep pointing into the owning worker's arena. */
+static void *merge_partition(void *arg) {
+  EventWorker *w = arg;
+  EventTable *into = &w->tables[w->index];
+  rw_trace_begin("events merge", "chunk");
+  for (int j = 0; j < w->worker_count && w->rc == RW_OK; j++) {
+    if (j == w->index) continue;
+    const EventTable *from = &w->workers[j].tables[w->index];
+    for (size_t i = 0; i < from->capacity; i++) {
+      if (!from->keys[i]) continue;
+      EventState *st = table_upsert(into, NULL, from->keys[i], from->hashes[i]);
+      if (!st) {
+        w->rc = RW_ERR_NOMEM;
+        break;
+      }
+      state_merge(st, &from->states[from->slots[i]]);
+    }
+  }
+  rw_trace_end("events merge", "chunk", (long)into->count);
+  return NULL;
+}
+
+/* Runs fn on every worker, the first on the calling thread. */
+static void run_workers(EventWorker *workers, int count, void *(*fn)(void *)) {
+  pthread_t threads[EVENTS_MAX_THREADS];
+  int started[EVENTS_MAX_THREADS] = {0};
+  for (int i = 1; i < count; i++) {
+    started[i] = pthread_create(&threads[i], NULL, fn, &workers[i]) == 0;
+    if (!started[i]) fn(&workers[i]);
+  }
+  fn(&workers[0]);
+  for (int i = 1; i < count; i++) {
+    if (started[i]) pthread_join(threads[i], NULL);
+  }
+}
+
+static int pick_threads(int requested, size_t size) {
+  int threads = requested;
+  if (threads <= 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 0 ? (int)online : 1;
+  }
+  long long by_size = (long long)(size / EVENTS_BYTES_PER_THREAD) + 1;
+  if (threads > by_size) threads = (int)by_size;
+  if (threads > EVENTS_MAX_THREADS) threads = EVENTS_MAX_THREADS;
+  return threads < 1 ? 1 : threads;
+}
+
+/* Attendance and engagement over the days days ending at as_of, from the
+ * ring; attendance is NaN when the window holds no sessions. */
+static void window_rates(const EventState *st, int as_of, int days, double *attendance, double *engagement) {
+  uint32_t counts[3] = {0, 0, 0};
+  for (int day = as_of - days + 1; day <= as_of; day++) {
+    if (day < 0 || day >= RING_DAY_LIMIT) continue;
+    uint32_t bucket = st->ring[day % RING_DAYS];
+    if (bucket >> RING_TAG_SHIFT != ring_tag(day)) continue;
+    for (int kind = 0; kind < 3; kind++) counts[kind] += ring_count(bucket, kind);
+  }
+  *attendance = counts[0] + counts[1] > 0 ? 100.0 * counts[0] / (double)(counts[0] + counts[1]) : NAN;
+  double engagement_rate = 100.0 * counts[2] / (ENGAGED_PER_WEEK * days / 7.0);
+  *engagement = engagement_rate > 100.0 ? 100.0 : engagement_rate;
+}
+
+static void apply_state(Scholar *s, const EventState *st, int as_of, int first_day) {
+  double span_days = (double)(as_of - first_day + 1);
+  int last_activity = st->last_activity == NO_DAY ? first_day : st->last_activity;
+  int last_contact = st->last_contact == NO_DAY ? first_day : st->last_contact;
+  s->days_inactive = (double)(as_of - last_activity);
+  s->last_contact_days = (double)(as_of - last_contact);
+  if (st->attended + st->absent > 0) {
+    s->attendance_rate = 100.0 * st->attended / (double)(st->attended + st->absent);
+  }
+  double weeks = span_days / 7.0 < 1.0 ? 1.0 : span_days / 7.0;
+  double engagement = 100.0 * st->engaged / (ENGAGED_PER_WEEK * weeks);
+  s->engagement_score = engagement > 100.0 ? 100.0 : engagement;
+
+  double attendance_7d, engagement_7d, attendance_30d, engagement_30d;
+  window_rates(st, as_of, 7, &attendance_7d, &engagement_7d);
+  window_rates(st, as_of, 30, &attendance_30d, &engagement_30d);
+  s->attendance_trend = (float)(attendance_7d - attendance_30d);
+  s->engagement_trend = (float)(engagement_7d - engagement_30d);
+}
+
+int rw_apply_events(rw_engine *engine, const char *path, const rw_events_options *options,
+                    rw_events_stats *stats) {
+  rw_events_options defaults = {NULL, 0};
+  if (!options) options = &defaults;
+  int as_of_day = INT_MAX;
+  if (options->as_of) {
+    as_of_day = parse_day(options->as_of, strlen(options->as_of));
+    if (as_of_day == NO_DAY) return RW_ERR_CONFIG;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return RW_ERR_IO;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return RW_ERR_IO;
+  }
+  size_t size = (size_t)st.st_size;
+  const char *data = NULL;
+  if (size > 0) {
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      close(fd);
+      return RW_ERR_IO;
+    }
+    data = mapped;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  rw_stage_begin(STAGE_PARSE);
+  int count = pick_threads(options->threads, size);
+  EventWorker *workers = calloc((size_t)count, sizeof(EventWorker));
+  int rc = workers ? RW_OK : RW_ERR_NOMEM;
+  const char *cursor = data;
+  for (int i = 0; rc == RW_OK && i < count; i++) {
+    EventWorker *w = &workers[i];
+    w->workers = workers;
+    w->worker_count = count;
+    w->index = i;
+    w->as_of_day = as_of_day;
+    w->min_day = INT_MAX;
+    w->max_day = INT_MIN;
+    w->tables = calloc((size_t)count, sizeof(EventTable));
+    if (!w->tables) rc = RW_ERR_NOMEM;
+    /* Ranges end just past a newline so no line is split. */
+    const char *end = i + 1 == count ? data + size : data + size / (size_t)count * (size_t)(i + 1);
+    if (end < cursor) end = cursor;
+    if (i + 1 < count && end < data + size) {
+      const char *newline = memchr(end, '\n', (size_t)(data + size - end));
+      end = newline ? newline + 1 : data + size;
+    }
+    w->begin = cursor;
+    w->end = end;
+    cursor = end;
+  }
+
+  if (rc == RW_OK) run_workers(workers, count, parse_range);
+  for (int i = 0; rc == RW_OK && i < count; i++) {
+    if (workers[i].rc != RW_OK) rc = workers[i].rc;
+  }
+  if (rc == RW_OK && count > 1) {
+    run_workers(workers, count, merge_partition);
+    for (int i = 0; rc == RW_OK && i < count; i++) {
+      if (workers[i].rc != RW_OK) rc = workers[i].rc;
+    }
+  }
+
+  rw_events_stats totals;
+  memset(&totals, 0, sizeof(totals));
+  totals.threads = count;
+  int first_day = INT_MAX;
+  int last_day = INT_MIN;
+  for (int i = 0; workers && i < count; i++) {
+    totals.events += workers[i].events;
+    totals.skipped += workers[i].skipped;
+    totals.unknown_types += workers[i].unknown;
+    if (workers[i].min_day < first_day) first_day = workers[i].min_day;
+    if (workers[i].max_day > last_day) last_day = workers[i].max_day;
+    if (workers[i].tables) totals.scholars += (int)workers[i].tables[i].count;
+  }
+
+  if (rc == RW_OK && totals.events > 0) {
+    int as_of = options->as_of ? as_of_day : last_day;
+    long long matched_events = 0;
+    for (int i = 0; i < engine->count; i++) {
+      Scholar *s = &engine->scholars[i];
+      uint64_t hash = rw_hash_string(s->id);
+      size_t part = partition_of(hash, count);
+      EventState *state = table_find(&workers[part].tables[part], s->id, hash);
+      if (!state) continue;
+      apply_state(s, state, as_of, first_day);
+      if (!state->matched) {
+        state->matched = 1;
+        matched_events += state->events;
+        totals.matched++;
+      }
+    }
+    totals.orphans = totals.events - matched_events;
+    totals.first_day = first_day;
+    totals.as_of_day = as_of;
+    rw_invalidate(engine);
+  }
+  rw_stage_end(STAGE_PARSE, (long)totals.events);
+
+  for (int i = 0; workers && i < count; i++) {
+    for (int j = 0; workers[i].tables && j < count; j++) {
+      table_free(&workers[i].tables[j]);
+    }
+    free(workers[i].tables);
+    rw_arena_free(&workers[i].arena);
+  }
+  free(workers);
+  if (data) munmap((void *)data, size);
+  if (stats) *stats = totals;
+  return rc;
+}
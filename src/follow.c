@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "follow.h"
+#include "instrument.h"
+
+#define FOLLOW_READ_BYTES 65536
+
+static volatile sig_atomic_t follow_stop = 0;
+
+static void stop_following(int sig) {
+  (void)sig;
+  follow_stop = 1;
+}
+
+static void print_live_text(const rw_engine *engine, const FollowOptions *opt, const rw_changes_stats *stats,
+                            double apply_ms) {
+  rw_totals totals;
+  rw_get_totals(engine, &totals);
+  printf("Live: %d scholars (high %d | medium %d | low %d), %d at or above risk %.1f", totals.loaded, totals.high,
+         totals.medium, totals.low, rw_count_at_least(engine, opt->min_risk), opt->min_risk);
+  if (stats) {
+    printf("; %d changes, %d rescored in %.2f ms", stats->rows, stats->rescored, apply_ms);
+  }
+  printf("\n");
+
+  rw_iter iter;
+  rw_scholar s;
+  char driver_text[256];
+  int printed = 0;
+  rw_topk_begin(engine, opt->min_risk, opt->limit, &iter);
+  while (rw_topk_next(&iter, &s)) {
+    printf("%2d. %-14s %-18s cohort %-10s risk %.1f (%s) -> %s", ++printed, s.scholar_id, s.name, s.cohort, s.risk,
+           s.tier, s.action);
+    if (opt->drivers) {
+      rw_drivers_at(engine, s.rank, driver_text, sizeof(driver_text));
+      printf(" | drivers: %s", driver_text);
+    }
+    printf("\n");
+  }
+}
+
+/* One JSON object per line, so a consumer can read the stream line by
+ * line. */
+static void print_live_json(const rw_engine *engine, const FollowOptions *opt, const rw_changes_stats *stats,
+                            double apply_ms) {
+  rw_totals totals;
+  rw_get_totals(engine, &totals);
+  printf("{\"total\": %d, \"tiers\": {\"high\": %d, \"medium\": %d, \"low\": %d}, \"min_risk\": %.1f, "
+         "\"at_or_above_min_risk\": %d, \"changes\": %d, \"rescored\": %d, \"apply_ms\": %.3f, \"action_queue\": [",
+         totals.loaded, totals.high, totals.medium, totals.low, opt->min_risk,
+         rw_count_at_least(engine, opt->min_risk), stats ? stats->rows : 0, stats ? stats->rescored : 0, apply_ms);
+  rw_iter iter;
+  rw_scholar s;
+  char driver_text[256];
+  int printed = 0;
+  rw_topk_begin(engine, opt->min_risk, opt->limit, &iter);
+  while (rw_topk_next(&iter, &s)) {
+    printf("%s{\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"risk\": %.1f, \"tier\": \"%s\", "
+           "\"action\": \"%s\"",
+           printed++ > 0 ? ", " : "", s.scholar_id, s.name, s.cohort, s.risk, s.tier, s.action);
+    if (opt->drivers) {
+      rw_drivers_at(engine, s.rank, driver_text, sizeof(driver_text));
+      printf(", \"drivers\": \"%s\"", driver_text);
+    }
+    printf("}");
+  }
+  printf("]}\n");
+}
+
+/* Sends the scholars named in a batch of change lines to the sink: their
+ * current row, or a delete when they left the roster. */
+static void sink_changed(rw_engine *engine, const FollowOptions *opt, const char *lines, size_t size) {
+  const char *end = lines + size;
+  rw_scholar s;
+  char id[256];
+  for (const char *line = lines; line < end;) {
+    const char *next = memchr(line, '\n', (size_t)(end - line));
+    next = next ? next + 1 : end;
+    const char *field = memchr(line, ',', (size_t)(next - line));
+    if (field) {
+      field++;
+      while (field < next && (*field == ' ' || *field == '\t')) field++;
+      size_t len = 0;
+      while (field + len < next && field[len] != ',' && field[len] != '\n' && field[len] != '\r') len++;
+      while (len > 0 && (field[len - 1] == ' ' || field[len - 1] == '\t')) len--;
+      if (len > 0 && len < sizeof(id)) {
+        memcpy(id, field, len);
+        id[len] = '\0';
+        if (strcmp(id, "scholar_id") != 0) {
+          int found = rw_scholar_find(engine, id, &s) == RW_OK;
+          sink_push_scholar(opt->sink, engine, found ? &s : NULL, id, opt->drivers);
+        }
+      }
+    }
+    line = next;
+  }
+  sink_flush(opt->sink);
+}
+
+/* Prints the batch and republishes the segment; 0 after an error. */
+static int print_live(rw_engine *engine, const FollowOptions *opt, const rw_changes_stats *stats, double apply_ms) {
+  if (opt->json) print_live_json(engine, opt, stats, apply_ms);
+  else print_live_text(engine, opt, stats, apply_ms);
+  fflush(stdout);
+  if (opt->server) serve_update(opt->server, engine);
+  if (opt->shm_name) {
+    int rc = rw_shm_publish(engine, opt->shm_name);
+    if (rc != RW_OK) {
+      if (rc == RW_ERR_IO) perror("Failed to publish shared memory");
+      else fprintf(stderr, "Failed to publish shared memory: %s\n", rw_strerror(rc));
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int follow_changes(rw_engine *engine, const char *path, const FollowOptions *options) {
+  int from_stdin = strcmp(path, "-") == 0;
+  int fd = from_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+  if (fd < 0) {
+    perror("Failed to follow changes");
+    return 0;
+  }
+  /* A named regular file is tailed; stdin ends at EOF even when it is a
+   * redirected file. */
+  struct stat st;
+  int polled = !from_stdin && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+
+  int rc = rw_live_begin(engine);
+  if (rc != RW_OK) {
+    fprintf(stderr, "Failed to start live mode: %s\n", rw_strerror(rc));
+    if (!from_stdin) close(fd);
+    return 0;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop_following;
+  sigemptyset(&action.sa_mask);
+  struct sigaction old_int, old_term;
+  sigaction(SIGINT, &action, &old_int);
+  sigaction(SIGTERM, &action, &old_term);
+  follow_stop = 0;
+
+  char *pending = NULL;
+  size_t used = 0;
+  size_t capacity = 0;
+  int ok = print_live(engine, options, NULL, 0.0);
+  while (!follow_stop && ok) {
+    if (capacity - used < FOLLOW_READ_BYTES) {
+      size_t grown_capacity = capacity == 0 ? 2 * FOLLOW_READ_BYTES : capacity * 2;
+      char *grown = realloc(pending, grown_capacity);
+      if (!grown) {
+        fprintf(stderr, "Failed to follow changes: %s\n", rw_strerror(RW_ERR_NOMEM));
+        ok = 0;
+        break;
+      }
+      pending = grown;
+      capacity = grown_capacity;
+    }
+    if (options->server && !polled) {
+      /* Answer requests until the stream has something to read. */
+      int ready = serve_wait(options->server, fd, -1);
+      if (ready < 0) {
+        perror("Failed to serve HTTP");
+        ok = 0;
+        break;
+      }
+      if (!ready) continue;
+    }
+    ssize_t got = read(fd, pending + used, FOLLOW_READ_BYTES);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      perror("Failed to follow changes");
+      ok = 0;
+      break;
+    }
+    if (got == 0) {
+      if (!polled) break;
+      if (options->server) {
+        if (serve_wait(options->server, -1, FOLLOW_POLL_MS) < 0) {
+          perror("Failed to serve HTTP");
+          ok = 0;
+          break;
+        }
+      } else {
+        struct timespec pause = {0, FOLLOW_POLL_MS * 1000000L};
+        nanosleep(&pause, NULL);
+      }
+      continue;
+    }
+    used += (size_t)got;
+
+    /* Apply whole lines only; a partial last line waits for the rest. */
+    char *last = memrchr(pending, '\n', used);
+    if (!last) continue;
+    size_t batch = (size_t)(last - pending) + 1;
+    struct timespec start, end;
+    rw_changes_stats stats;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = rw_apply_changes_buffer(engine, pending, batch, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (rc != RW_OK) {
+      fprintf(stderr, "Failed to apply changes: %s\n", rw_strerror(rc));
+      ok = 0;
+      break;
+    }
+    if (options->sink) sink_changed(engine, options, pending, batch);
+    memmove(pending, pending + batch, used - batch);
+    used -= batch;
+    ok = print_live(engine, options, &stats, rw_elapsed_ms(&start, &end));
+  }
+
+  free(pending);
+  sigaction(SIGINT, &old_int, NULL);
+  sigaction(SIGTERM, &old_term, NULL);
+  if (!from_stdin) close(fd);
+  rc = rw_live_end(engine);
+  if (rc != RW_OK && ok) {
+    fprintf(stderr, "Failed to leave live mode: %s\n", rw_strerror(rc));
+    ok = 0;
+  }
+  return ok;
+}
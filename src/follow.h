@@ -0,0 +1,32 @@
+#ifndef RETENTION_FOLLOW_H
+#define RETENTION_FOLLOW_H
+
+#include "retention.h"
+#include "serve.h"
+#include "sink.h"
+
+/* Resident -follow mode for the CLI: the scored roster goes live and a
+ * change stream is applied batch by batch as lines arrive, printing the
+ * live totals and top of the queue after each batch. */
+
+#define FOLLOW_POLL_MS 500
+
+typedef struct {
+  double min_risk;
+  int limit;
+  int drivers;
+  int json;
+  /* Republished after every batch when set (-shm). */
+  const char *shm_name;
+  /* Receives the changed scholars of every batch when set (-sink). */
+  Sink *sink;
+  /* Answers HTTP requests between batches when set (-serve). */
+  Server *server;
+} FollowOptions;
+
+/* Follows path (a file that is polled for appended lines, or "-" for
+ * stdin until EOF) until SIGINT or SIGTERM, then leaves the engine ranked
+ * again. Returns 0 after printing an error. */
+int follow_changes(rw_engine *engine, const char *path, const FollowOptions *options);
+
+#endif
@@ -0,0 +1,159 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "engine.h"
+
+#define IDSET_MIN_CAPACITY 64
+#define BLOOM_BITS_PER_KEY 16
+
+/* Scholar id sets for -include-ids/-exclude-ids. Membership goes through
+ * a blocked Bloom filter first: four bits in a single 64-bit word chosen by
+ * the hash, so the common miss costs one load. Hits are confirmed in an
+ * open-addressing table that keeps the full hash beside each key. */
+
+static char *trim_field(char *s) {
+  while (*s && isspace((unsigned char)*s)) s++;
+  char *end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1])) end--;
+  *end = '\0';
+  return s;
+}
+
+static uint64_t bloom_bits(uint64_t hash) {
+  uint64_t h = hash >> 32;
+  uint64_t bits = 0;
+  for (int i = 0; i < 4; i++) {
+    bits |= 1ULL << (h & 63);
+    h >>= 6;
+  }
+  return bits;
+}
+
+static int idset_grow(IdSet *set) {
+  size_t capacity = set->capacity == 0 ? IDSET_MIN_CAPACITY : set->capacity * 2;
+  char **keys = calloc(capacity, sizeof(char *));
+  uint64_t *hashes = malloc(sizeof(uint64_t) * capacity);
+  if (!keys || !hashes) {
+    free(keys);
+    free(hashes);
+    return RW_ERR_NOMEM;
+  }
+  size_t mask = capacity - 1;
+  for (size_t i = 0; i < set->capacity; i++) {
+    if (!set->keys[i]) continue;
+    size_t j = set->hashes[i] & mask;
+    while (keys[j]) j = (j + 1) & mask;
+    keys[j] = set->keys[i];
+    hashes[j] = set->hashes[i];
+  }
+  free(set->keys);
+  free(set->hashes);
+  set->keys = keys;
+  set->hashes = hashes;
+  set->capacity = capacity;
+  return RW_OK;
+}
+
+static int idset_insert(IdSet *set, const char *id) {
+  if ((set->count + 1) * 2 > set->capacity && idset_grow(set) != RW_OK) return RW_ERR_NOMEM;
+  uint64_t hash = rw_hash_string(id);
+  size_t mask = set->capacity - 1;
+  size_t i = hash & mask;
+  while (set->keys[i]) {
+    if (set->hashes[i] == hash && strcmp(set->keys[i], id) == 0) return RW_OK;
+    i = (i + 1) & mask;
+  }
+  char *key = rw_arena_strdup(&set->arena, id);
+  if (!key) return RW_ERR_NOMEM;
+  set->keys[i] = key;
+  set->hashes[i] = hash;
+  set->count++;
+  return RW_OK;
+}
+
+static int idset_build_bloom(IdSet *set) {
+  size_t words = 1;
+  while (words * 64 < set->count * BLOOM_BITS_PER_KEY) words *= 2;
+  set->bloom = calloc(words, sizeof(uint64_t));
+  if (!set->bloom) return RW_ERR_NOMEM;
+  set->bloom_mask = words - 1;
+  for (size_t i = 0; i < set->capacity; i++) {
+    if (!set->keys[i]) continue;
+    set->bloom[set->hashes[i] & set->bloom_mask] |= bloom_bits(set->hashes[i]);
+  }
+  return RW_OK;
+}
+
+/* One id per line; only the first comma-separated field is used, so a
+ * caseload CSV works as-is. Blank lines and a scholar_id header are skipped. */
+int rw_idset_load(IdSet *set, const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) return RW_ERR_IO;
+  memset(set, 0, sizeof(*set));
+  char *line = NULL;
+  size_t len = 0;
+  int rc = RW_OK;
+  while (rc == RW_OK && getline(&line, &len, fp) != -1) {
+    char *comma = strchr(line, ',');
+    if (comma) *comma = '\0';
+    char *id = trim_field(line);
+    if (*id == '\0' || strcmp(id, "scholar_id") == 0) continue;
+    rc = idset_insert(set, id);
+  }
+  free(line);
+  if (ferror(fp) && rc == RW_OK) rc = RW_ERR_IO;
+  fclose(fp);
+  if (rc == RW_OK && set->capacity == 0) rc = idset_grow(set);
+  if (rc == RW_OK) rc = idset_build_bloom(set);
+  if (rc != RW_OK) rw_idset_free(set);
+  return rc;
+}
+
+int rw_idset_contains(const IdSet *set, const char *id, uint64_t hash) {
+  uint64_t bits = bloom_bits(hash);
+  if ((set->bloom[hash & set->bloom_mask] & bits) != bits) return 0;
+  size_t mask = set->capacity - 1;
+  size_t i = hash & mask;
+  while (set->keys[i]) {
+    if (set->hashes[i] == hash && strcmp(set->keys[i], id) == 0) return 1;
+    i = (i + 1) & mask;
+  }
+  return 0;
+}
+
+void rw_idset_free(IdSet *set) {
+  free(set->bloom);
+  free(set->keys);
+  free(set->hashes);
+  rw_arena_free(&set->arena);
+  memset(set, 0, sizeof(*set));
+}
+
+int rw_id_allowed(const rw_engine *engine, const char *id) {
+  if (!engine->include_ids && !engine->exclude_ids) return 1;
+  uint64_t hash = rw_hash_string(id);
+  if (engine->include_ids && !rw_idset_contains(engine->include_ids, id, hash)) return 0;
+  if (engine->exclude_ids && rw_idset_contains(engine->exclude_ids, id, hash)) return 0;
+  return 1;
+}
+
+int rw_load_id_filter(rw_engine *engine, const char *path, int mode) {
+  if (mode != RW_IDS_INCLUDE && mode != RW_IDS_EXCLUDE) return RW_ERR_CONFIG;
+  IdSet *set = malloc(sizeof(IdSet));
+  if (!set) return RW_ERR_NOMEM;
+  int rc = rw_idset_load(set, path);
+  if (rc != RW_OK) {
+    free(set);
+    return rc;
+  }
+  IdSet **slot = mode == RW_IDS_INCLUDE ? &engine->include_ids : &engine->exclude_ids;
+  if (*slot) {
+    rw_idset_free(*slot);
+    free(*slot);
+  }
+  *slot = set;
+  return RW_OK;
+}
@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "instrument.h"
+
+#define TRACE_INITIAL_EVENTS 1024
+
+typedef struct {
+  int enabled;
+  int fds[PERF_EVENT_COUNT];
+} PerfCounters;
+
+typedef struct {
+  const char *name;
+  const char *category;
+  char phase;
+  long rows;
+  struct timespec at;
+} TraceEvent;
+
+/* One buffer per recording thread, appended without locking and linked into
+ * a global list on first use so the exit handler can flush every thread. */
+typedef struct TraceBuffer {
+  struct TraceBuffer *next;
+  long tid;
+  int count;
+  int capacity;
+  TraceEvent *events;
+} TraceBuffer;
+
+const char *rw_stage_names[STAGE_COUNT] = {"parse", "score", "sort", "export", "aggregate", "report"};
+
+/* Process-wide and unsynchronized, so only written once the CLI opts in
+ * with rw_stages_open; engines on other threads leave them alone. */
+StageStats rw_stage_stats[STAGE_COUNT];
+static PerfCounters perf = {0, {-1, -1, -1, -1}};
+static int stages_enabled = 0;
+
+static const char *trace_path = NULL;
+static struct timespec trace_epoch;
+static _Atomic(TraceBuffer *) trace_buffers = NULL;
+static _Thread_local TraceBuffer *trace_local = NULL;
+
+static atomic_int alloc_tracking = 0;
+static _Atomic uint64_t alloc_total_allocs = 0;
+static _Atomic uint64_t alloc_total_frees = 0;
+static _Atomic uint64_t alloc_total_bytes = 0;
+
+double rw_elapsed_ms(const struct timespec *start, const struct timespec *end) {
+  return (double)(end->tv_sec - start->tv_sec) * 1000.0 + (double)(end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+#ifdef __linux__
+static int perf_open_counter(uint32_t type, uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = group_fd == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+/* Opens one counter group (cycles leads; instructions, cache and branch
+ * misses follow) that is reset and enabled around each stage. Returns 0 and
+ * leaves perf.enabled unset when the kernel denies access. */
+int rw_perf_counters_open(void) {
+#ifdef __linux__
+  static const uint64_t configs[PERF_EVENT_COUNT] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  perf.fds[0] = perf_open_counter(PERF_TYPE_HARDWARE, configs[0], -1);
+  if (perf.fds[0] < 0) {
+    fprintf(stderr, "Perf counters unavailable (%s); reporting wall time only.\n", strerror(errno));
+    perf.fds[0] = -1;
+    return 0;
+  }
+  for (int i = 1; i < PERF_EVENT_COUNT; i++) {
+    perf.fds[i] = perf_open_counter(PERF_TYPE_HARDWARE, configs[i], perf.fds[0]);
+  }
+  perf.enabled = 1;
+  return 1;
+#else
+  fprintf(stderr, "Perf counters are only supported on Linux; reporting wall time only.\n");
+  return 0;
+#endif
+}
+
+void rw_perf_counters_close(void) {
+  for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+    if (perf.fds[i] >= 0) close(perf.fds[i]);
+    perf.fds[i] = -1;
+  }
+  perf.enabled = 0;
+}
+
+static long current_tid(void) {
+#ifdef __linux__
+  return (long)syscall(SYS_gettid);
+#else
+  return (long)getpid();
+#endif
+}
+
+static TraceBuffer *trace_buffer(void) {
+  if (trace_local) return trace_local;
+  TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+  if (!buffer) return NULL;
+  buffer->tid = current_tid();
+  buffer->next = atomic_load(&trace_buffers);
+  while (!atomic_compare_exchange_weak(&trace_buffers, &buffer->next, buffer)) {
+  }
+  trace_local = buffer;
+  return buffer;
+}
+
+static void trace_record(char phase, const char *name, const char *category, long rows) {
+  if (!trace_path) return;
+  TraceBuffer *buffer = trace_buffer();
+  if (!buffer) return;
+  if (buffer->count >= buffer->capacity) {
+    int capacity = buffer->capacity == 0 ? TRACE_INITIAL_EVENTS : buffer->capacity * 2;
+    TraceEvent *events = realloc(buffer->events, sizeof(TraceEvent) * capacity);
+    if (!events) return;
+    buffer->events = events;
+    buffer->capacity = capacity;
+  }
+  TraceEvent *ev = &buffer->events[buffer->count++];
+  ev->name = name;
+  ev->category = category;
+  ev->phase = phase;
+  ev->rows = rows;
+  clock_gettime(CLOCK_MONOTONIC, &ev->at);
+}
+
+void rw_trace_begin(const char *name, const char *category) {
+  trace_record('B', name, category, -1);
+}
+
+void rw_trace_end(const char *name, const char *category, long rows) {
+  trace_record('E', name, category, rows);
+}
+
+/* Writes the Chrome trace-event JSON (loadable in chrome://tracing and
+ * Perfetto). Registered with atexit so error exits still flush. */
+static void trace_flush(void) {
+  if (!trace_path) return;
+  FILE *out = fopen(trace_path, "w");
+  if (!out) {
+    perror("Failed to write trace");
+    return;
+  }
+  long pid = (long)getpid();
+  int first = 1;
+  fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for (TraceBuffer *buffer = atomic_load(&trace_buffers); buffer; buffer = buffer->next) {
+    fprintf(out, "%s  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %ld, \"tid\": %ld, \"args\": {\"name\": \"%s\"}}",
+            first ? "" : ",\n", pid, buffer->tid, buffer->tid == pid ? "main" : "worker");
+    first = 0;
+    for (int i = 0; i < buffer->count; i++) {
+      TraceEvent *ev = &buffer->events[i];
+      fprintf(out, ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": %ld, \"tid\": %ld",
+              ev->name, ev->category, ev->phase, rw_elapsed_ms(&trace_epoch, &ev->at) * 1000.0, pid, buffer->tid);
+      if (ev->rows >= 0) {
+        fprintf(out, ", \"args\": {\"rows\": %ld}", ev->rows);
+      }
+      fprintf(out, "}");
+    }
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+
+  TraceBuffer *buffer = atomic_exchange(&trace_buffers, NULL);
+  while (buffer) {
+    TraceBuffer *next = buffer->next;
+    free(buffer->events);
+    free(buffer);
+    buffer = next;
+  }
+  trace_local = NULL;
+  trace_path = NULL;
+}
+
+void rw_trace_open(const char *path) {
+  trace_path = path;
+  clock_gettime(CLOCK_MONOTONIC, &trace_epoch);
+  atexit(trace_flush);
+}
+
+void rw_alloc_stats_open(int supported) {
+  if (!supported) {
+    fprintf(stderr, "Allocation stats need glibc malloc interposition; counts will read zero.\n");
+  }
+  atomic_store(&alloc_tracking, 1);
+}
+
+void rw_alloc_note(uint64_t allocs, uint64_t frees, uint64_t bytes) {
+  if (!atomic_load_explicit(&alloc_tracking, memory_order_relaxed)) return;
+  if (allocs) atomic_fetch_add_explicit(&alloc_total_allocs, allocs, memory_order_relaxed);
+  if (frees) atomic_fetch_add_explicit(&alloc_total_frees, frees, memory_order_relaxed);
+  if (bytes) atomic_fetch_add_explicit(&alloc_total_bytes, bytes, memory_order_relaxed);
+}
+
+AllocCounts rw_alloc_snapshot(void) {
+  AllocCounts counts;
+  counts.allocs = atomic_load_explicit(&alloc_total_allocs, memory_order_relaxed);
+  counts.frees = atomic_load_explicit(&alloc_total_frees, memory_order_relaxed);
+  counts.bytes = atomic_load_explicit(&alloc_total_bytes, memory_order_relaxed);
+  return counts;
+}
+
+void rw_stages_open(void) {
+  stages_enabled = 1;
+}
+
+void rw_stage_begin(Stage stage) {
+  rw_trace_begin(rw_stage_names[stage], "stage");
+  RW_PROBE1(stage__start, (int)stage);
+  if (!stages_enabled) return;
+  rw_stage_stats[stage].alloc_mark = rw_alloc_snapshot();
+#ifdef __linux__
+  if (perf.enabled) {
+    ioctl(perf.fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf.fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+  clock_gettime(CLOCK_MONOTONIC, &rw_stage_stats[stage].started);
+}
+
+void rw_stage_end(Stage stage, long rows) {
+  rw_trace_end(rw_stage_names[stage], "stage", rows);
+  RW_PROBE2(stage__done, (int)stage, rows);
+  if (!stages_enabled) return;
+  StageStats *st = &rw_stage_stats[stage];
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  st->wall_ms += rw_elapsed_ms(&st->started, &now);
+  st->rows += rows;
+  AllocCounts counts = rw_alloc_snapshot();
+  st->allocs.allocs += counts.allocs - st->alloc_mark.allocs;
+  st->allocs.frees += counts.frees - st->alloc_mark.frees;
+  st->allocs.bytes += counts.bytes - st->alloc_mark.bytes;
+#ifdef __linux__
+  if (perf.enabled) {
+    ioctl(perf.fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    /* Group read layout: nr, then one value per successfully opened counter. */
+    uint64_t buffer[1 + PERF_EVENT_COUNT];
+    if (read(perf.fds[0], buffer, sizeof(buffer)) > 0) {
+      int slot = 1;
+      for (int i = 0; i < PERF_EVENT_COUNT && slot <= (int)buffer[0]; i++) {
+        if (perf.fds[i] < 0) continue;
+        st->counters[i] += buffer[slot++];
+      }
+    }
+  }
+#endif
+}
+
+void rw_print_perf_report(void) {
+  fprintf(stderr, "\nStage performance:\n");
+  if (perf.enabled) {
+    fprintf(stderr, "%-10s %10s %8s %14s %14s %6s %14s %15s\n",
+            "stage", "wall ms", "rows", "cycles", "instructions", "IPC", "cache-miss/row", "branch-miss/row");
+  } else {
+    fprintf(stderr, "%-10s %10s %8s %12s\n", "stage", "wall ms", "rows", "ns/row");
+  }
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    StageStats *st = &rw_stage_stats[i];
+    double rows = st->rows > 0 ? (double)st->rows : 1.0;
+    if (!perf.enabled) {
+      fprintf(stderr, "%-10s %10.3f %8ld %12.1f\n", rw_stage_names[i], st->wall_ms, st->rows, st->wall_ms * 1e6 / rows);
+      continue;
+    }
+    double ipc = st->counters[0] > 0 ? (double)st->counters[1] / (double)st->counters[0] : 0.0;
+    fprintf(stderr, "%-10s %10.3f %8ld %14llu %14llu %6.2f ",
+            rw_stage_names[i], st->wall_ms, st->rows,
+            (unsigned long long)st->counters[0], (unsigned long long)st->counters[1], ipc);
+    if (perf.fds[2] >= 0) fprintf(stderr, "%14.2f ", (double)st->counters[2] / rows);
+    else fprintf(stderr, "%14s ", "n/a");
+    if (perf.fds[3] >= 0) fprintf(stderr, "%15.2f\n", (double)st->counters[3] / rows);
+    else fprintf(stderr, "%15s\n", "n/a");
+  }
+}
+
+void rw_print_alloc_report(long rows) {
+  AllocCounts total = rw_alloc_snapshot();
+  double per_row = rows > 0 ? (double)rows : 1.0;
+  fprintf(stderr, "\nAllocations:\n");
+  fprintf(stderr, "%-10s %10s %10s %14s %12s\n", "stage", "allocs", "frees", "bytes", "allocs/row");
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    AllocCounts *c = &rw_stage_stats[i].allocs;
+    fprintf(stderr, "%-10s %10llu %10llu %14llu %12.4f\n", rw_stage_names[i],
+            (unsigned long long)c->allocs, (unsigned long long)c->frees, (unsigned long long)c->bytes,
+            (double)c->allocs / per_row);
+  }
+  fprintf(stderr, "%-10s %10llu %10llu %14llu %12.4f\n", "total",
+          (unsigned long long)total.allocs, (unsigned long long)total.frees, (unsigned long long)total.bytes,
+          (double)total.allocs / per_row);
+}
@@ -0,0 +1,77 @@
+#ifndef RETENTION_INSTRUMENT_H
+#define RETENTION_INSTRUMENT_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* USDT probes for bpftrace/perf (provider "retention_watch"). They compile
+ * to a nop when <sys/sdt.h> is missing or RW_NO_USDT is defined. */
+#if defined(__has_include) && !defined(RW_NO_USDT)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RW_HAVE_USDT 1
+#endif
+#endif
+#ifdef RW_HAVE_USDT
+#define RW_PROBE1(name, a) DTRACE_PROBE1(retention_watch, name, a)
+#define RW_PROBE2(name, a, b) DTRACE_PROBE2(retention_watch, name, a, b)
+#else
+#define RW_PROBE1(name, a) do { (void)(a); } while (0)
+#define RW_PROBE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#endif
+
+#define PERF_EVENT_COUNT 4
+#define BATCH_ROWS 4096
+
+typedef enum {
+  STAGE_PARSE,
+  STAGE_SCORE,
+  STAGE_SORT,
+  STAGE_EXPORT,
+  STAGE_AGGREGATE,
+  STAGE_REPORT,
+  STAGE_COUNT
+} Stage;
+
+typedef struct {
+  uint64_t allocs;
+  uint64_t frees;
+  uint64_t bytes;
+} AllocCounts;
+
+typedef struct {
+  double wall_ms;
+  long rows;
+  uint64_t counters[PERF_EVENT_COUNT];
+  AllocCounts allocs;
+  AllocCounts alloc_mark;
+  struct timespec started;
+} StageStats;
+
+extern const char *rw_stage_names[STAGE_COUNT];
+extern StageStats rw_stage_stats[STAGE_COUNT];
+
+double rw_elapsed_ms(const struct timespec *start, const struct timespec *end);
+
+/* Stage stats and perf counters are only kept after rw_stages_open, which
+ * the CLI calls before it starts any engine work. */
+void rw_stages_open(void);
+void rw_stage_begin(Stage stage);
+void rw_stage_end(Stage stage, long rows);
+
+void rw_trace_open(const char *path);
+void rw_trace_begin(const char *name, const char *category);
+void rw_trace_end(const char *name, const char *category, long rows);
+
+int rw_perf_counters_open(void);
+void rw_perf_counters_close(void);
+void rw_print_perf_report(void);
+
+/* Allocation counters are fed by whoever interposes the allocator (the CLI
+ * does on glibc); the library only snapshots them around stages. */
+void rw_alloc_stats_open(int supported);
+void rw_alloc_note(uint64_t allocs, uint64_t frees, uint64_t bytes);
+AllocCounts rw_alloc_snapshot(void);
+void rw_print_alloc_report(long rows);
+
+#endif
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+/* -join: a secondary CSV hashed on its key column. Keys go through the
+ * same interning dictionary as cohorts, so a key's dictionary id is its row.
+ * Applying the join probes once per ranked scholar, in rank order, and
+ * -where compacts the roster in the same pass, so nothing is re-sorted. */
+
+static const char unmatched_group[] = "(unmatched)";
+
+static char *trim_field(char *s) {
+  while (*s && isspace((unsigned char)*s)) s++;
+  char *end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1])) end--;
+  *end = '\0';
+  return s;
+}
+
+/* Splits line in place into *fields, which grows to fit a wide file; -1
+ * when out of memory. */
+static int split_fields(char *line, char ***fields, int *capacity) {
+  int count = 0;
+  char *cursor = line;
+  char *token;
+  while ((token = strsep(&cursor, ",")) != NULL) {
+    if (count == *capacity) {
+      int grown_capacity = *capacity == 0 ? 16 : *capacity * 2;
+      char **grown = realloc(*fields, sizeof(char *) * (size_t)grown_capacity);
+      if (!grown) return -1;
+      *fields = grown;
+      *capacity = grown_capacity;
+    }
+    (*fields)[count++] = trim_field(token);
+  }
+  return count;
+}
+
+static int add_row(JoinTable *join, char **fields, int field_count, int key_index) {
+  char *interned;
+  int id = rw_dict_intern(&join->keys, &join->arena, fields[key_index], &interned);
+  if (id < 0) return RW_ERR_NOMEM;
+  if (id < join->rows) return RW_OK; /* duplicate key: the first row wins */
+  if (join->rows >= join->row_capacity) {
+    int capacity = join->row_capacity == 0 ? 64 : join->row_capacity * 2;
+    char **values = realloc(join->values, sizeof(char *) * (size_t)capacity * (size_t)join->column_count);
+    if (!values && join->column_count > 0) return RW_ERR_NOMEM;
+    join->values = values;
+    join->row_capacity = capacity;
+  }
+  char **row = join->values + (size_t)join->rows * (size_t)join->column_count;
+  int column = 0;
+  for (int i = 0; i <= join->column_count; i++) {
+    if (i == key_index) continue;
+    row[column] = rw_arena_strdup(&join->arena, i < field_count ? fields[i] : "");
+    if (!row[column++]) return RW_ERR_NOMEM;
+  }
+  join->rows++;
+  return RW_OK;
+}
+
+static int join_load(JoinTable *join, const char *path, const char *key) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) return RW_ERR_IO;
+  char *line = NULL;
+  size_t len = 0;
+  char **fields = NULL;
+  int field_capacity = 0;
+  int key_index = -1;
+  int rc = RW_OK;
+
+  if (getline(&line, &len, fp) != -1) {
+    line[strcspn(line, "\r\n")] = '\0';
+    int count = split_fields(line, &fields, &field_capacity);
+    if (count < 0) rc = RW_ERR_NOMEM;
+    for (int i = 0; i < count; i++) {
+      if (strcmp(fields[i], key) == 0) key_index = i;
+    }
+    if (key_index >= 0) {
+      join->column_count = count - 1;
+      join->columns = malloc(sizeof(char *) * (size_t)(count > 1 ? count - 1 : 1));
+      if (!join->columns) rc = RW_ERR_NOMEM;
+      for (int i = 0, column = 0; rc == RW_OK && i < count; i++) {
+        if (i == key_index) continue;
+        join->columns[column] = rw_arena_strdup(&join->arena, fields[i]);
+        if (!join->columns[column++]) rc = RW_ERR_NOMEM;
+      }
+    }
+  }
+  if (key_index < 0 && rc == RW_OK) rc = ferror(fp) ? RW_ERR_IO : RW_ERR_CONFIG;
+
+  while (rc == RW_OK && getline(&line, &len, fp) != -1) {
+    line[strcspn(line, "\r\n")] = '\0';
+    int count = split_fields(line, &fields, &field_capacity);
+    if (count < 0) {
+      rc = RW_ERR_NOMEM;
+      break;
+    }
+    if (count <= key_index || fields[key_index][0] == '\0') continue;
+    rc = add_row(join, fields, count, key_index);
+  }
+  free(fields);
+  free(line);
+  if (ferror(fp) && rc == RW_OK) rc = RW_ERR_IO;
+  fclose(fp);
+  return rc;
+}
+
+static int join_column_index(const JoinTable *join, const char *column) {
+  for (int i = 0; i < join->column_count; i++) {
+    if (strcmp(join->columns[i], column) == 0) return i;
+  }
+  return -1;
+}
+
+void rw_join_free(JoinTable *join) {
+  free(join->columns);
+  free(join->values);
+  free(join->row_groups);
+  rw_dict_free(&join->keys);
+  rw_dict_free(&join->groups);
+  rw_arena_free(&join->arena);
+  memset(join, 0, sizeof(*join));
+}
+
+int rw_load_join(rw_engine *engine, const char *path, const char *key) {
+  JoinTable *join = calloc(1, sizeof(JoinTable));
+  if (!join) return RW_ERR_NOMEM;
+  join->group_column = -1;
+  int rc = join_load(join, path, key);
+  if (rc != RW_OK) {
+    rw_join_free(join);
+    free(join);
+    return rc;
+  }
+  if (engine->join) {
+    rw_join_free(engine->join);
+    free(engine->join);
+  }
+  engine->join = join;
+  engine->where_column = -1;
+  free(engine->where_value);
+  engine->where_value = NULL;
+  engine->join_applied = 0;
+  return RW_OK;
+}
+
+int rw_join_where(rw_engine *engine, const char *column, const char *value) {
+  if (!engine->join) return RW_ERR_CONFIG;
+  int index = join_column_index(engine->join, column);
+  if (index < 0) return RW_ERR_CONFIG;
+  char *copy = strdup(value);
+  if (!copy) return RW_ERR_NOMEM;
+  free(engine->where_value);
+  engine->where_value = copy;
+  engine->where_column = index;
+  return RW_OK;
+}
+
+int rw_join_group_by(rw_engine *engine, const char *column) {
+  JoinTable *join = engine->join;
+  if (!join) return RW_ERR_CONFIG;
+  int index = join_column_index(join, column);
+  if (index < 0) return RW_ERR_CONFIG;
+  int *row_groups = malloc(sizeof(int) * (size_t)(join->rows > 0 ? join->rows : 1));
+  if (!row_groups) return RW_ERR_NOMEM;
+  rw_dict_free(&join->groups);
+  int rc = RW_OK;
+  for (int r = 0; rc == RW_OK && r < join->rows; r++) {
+    char *interned;
+    row_groups[r] = rw_dict_intern(&join->groups, &join->arena,
+                                   join->values[(size_t)r * (size_t)join->column_count + (size_t)index], &interned);
+    if (row_groups[r] < 0) rc = RW_ERR_NOMEM;
+  }
+  free(join->row_groups);
+  if (rc != RW_OK) {
+    /* The previous groups are gone with the dictionary. */
+    free(row_groups);
+    join->row_groups = NULL;
+    join->group_column = -1;
+    return rc;
+  }
+  join->row_groups = row_groups;
+  join->group_column = index;
+  return RW_OK;
+}
+
+int rw_join_apply(rw_engine *engine) {
+  JoinTable *join = engine->join;
+  if (!join) return RW_OK;
+  if (!engine->scored) return RW_ERR_CONFIG;
+  if (engine->join_applied) return RW_OK;
+  if (rw_live_end(engine) != RW_OK) return RW_ERR_NOMEM;
+
+  int count = engine->count;
+  int *rows = realloc(engine->join_rows, sizeof(int) * (size_t)(count > 0 ? count : 1));
+  if (!rows) return RW_ERR_NOMEM;
+  engine->join_rows = rows;
+
+  rw_trace_begin("join", "join");
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    int row = rw_dict_find(&join->keys, engine->scholars[i].id);
+    if (engine->where_column >= 0) {
+      const char *value = row >= 0 ? join->values[(size_t)row * (size_t)join->column_count + (size_t)engine->where_column] : NULL;
+      if (!value || strcmp(value, engine->where_value) != 0) {
+        engine->filtered++;
+        continue;
+      }
+    }
+    if (kept != i) engine->scholars[kept] = engine->scholars[i];
+    rows[kept++] = row;
+  }
+  engine->count = kept;
+  rw_trace_end("join", "join", count);
+  engine->join_applied = 1;
+  engine->assigned = 0;
+  engine->aggregated = 0;
+  return RW_OK;
+}
+
+int rw_join_column_count(const rw_engine *engine) {
+  return engine->join ? engine->join->column_count : 0;
+}
+
+const char *rw_join_column_name(const rw_engine *engine, int column) {
+  if (!engine->join || column < 0 || column >= engine->join->column_count) return NULL;
+  return engine->join->columns[column];
+}
+
+const char *rw_join_value(const rw_engine *engine, int rank, int column) {
+  const JoinTable *join = engine->join;
+  if (!join || !engine->join_applied || rank < 0 || rank >= engine->count) return NULL;
+  if (column < 0 || column >= join->column_count) return NULL;
+  int row = engine->join_rows[rank];
+  return row >= 0 ? join->values[(size_t)row * (size_t)join->column_count + (size_t)column] : NULL;
+}
+
+int rw_join_group_of(const rw_engine *engine, int rank) {
+  const JoinTable *join = engine->join;
+  if (!join || !engine->join_applied || join->group_column < 0) return -1;
+  int row = engine->join_rows[rank];
+  return row >= 0 ? join->row_groups[row] : join->groups.count;
+}
+
+const char *rw_join_group_name(const rw_engine *engine, int group) {
+  const StringDict *groups = &engine->join->groups;
+  if (group == groups->count) return unmatched_group;
+  for (int i = 0; i < groups->capacity; i++) {
+    if (groups->keys[i] && groups->ids[i] == group) return groups->keys[i];
+  }
+  return unmatched_group;
+}
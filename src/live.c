@@ -0,0 +1,381 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+/* Live ranking for resident use. Once rw_live_begin runs, engine->scholars
+ * stops being kept in rank order: each scholar owns a slot (a deleted
+ * scholar who comes back gets the same one) and an order-statistic treap
+ * over the slots holds the ranking. Nodes are keyed by risk, highest
+ * first, then by slot, and carry subtree sizes, so an update, the scholar
+ * at a rank and the number of scholars at or above a risk are all
+ * O(log n). rw_live_end writes the roster back in rank order. */
+
+struct LiveIndex {
+  /* Scholar id -> dictionary id -> slot. */
+  StringDict ids;
+  StringArena arena;
+  int *slot_of;
+  int slot_count;
+  int *left;
+  int *right;
+  int *size;
+  uint32_t *priority;
+  /* Risk as ranked; NaN ranks last. */
+  double *key;
+  unsigned char *present;
+  int capacity;
+  int root;
+  uint32_t seed;
+};
+
+static uint32_t next_priority(LiveIndex *live) {
+  uint32_t x = live->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  live->seed = x;
+  return x;
+}
+
+static int node_size(const LiveIndex *live, int node) {
+  return node < 0 ? 0 : live->size[node];
+}
+
+static void update_size(LiveIndex *live, int node) {
+  live->size[node] = node_size(live, live->left[node]) + node_size(live, live->right[node]) + 1;
+}
+
+/* The one order of the index: risk key descending, then slot. Keys are
+ * never NaN (rank_key), so this is total. */
+static int compare_rank(double key_a, int a, double key_b, int b) {
+  if (key_a != key_b) return key_a > key_b ? -1 : 1;
+  return (a > b) - (a < b);
+}
+
+static int ranks_before(const LiveIndex *live, int a, int b) {
+  return compare_rank(live->key[a], a, live->key[b], b) < 0;
+}
+
+typedef struct {
+  double key;
+  int slot;
+} RankEntry;
+
+static int compare_entries(const void *a, const void *b) {
+  const RankEntry *ea = a;
+  const RankEntry *eb = b;
+  return compare_rank(ea->key, ea->slot, eb->key, eb->slot);
+}
+
+static int live_reserve(LiveIndex *live, int slots) {
+  if (slots <= live->capacity) return RW_OK;
+  int capacity = live->capacity == 0 ? 64 : live->capacity;
+  while (capacity < slots) capacity *= 2;
+  int *left = realloc(live->left, sizeof(int) * (size_t)capacity);
+  if (left) live->left = left;
+  int *right = realloc(live->right, sizeof(int) * (size_t)capacity);
+  if (right) live->right = right;
+  int *size = realloc(live->size, sizeof(int) * (size_t)capacity);
+  if (size) live->size = size;
+  uint32_t *priority = realloc(live->priority, sizeof(uint32_t) * (size_t)capacity);
+  if (priority) live->priority = priority;
+  double *key = realloc(live->key, sizeof(double) * (size_t)capacity);
+  if (key) live->key = key;
+  unsigned char *present = realloc(live->present, (size_t)capacity);
+  if (present) live->present = present;
+  int *slot_of = realloc(live->slot_of, sizeof(int) * (size_t)capacity);
+  if (slot_of) live->slot_of = slot_of;
+  if (!left || !right || !size || !priority || !key || !present || !slot_of) return RW_ERR_NOMEM;
+  live->capacity = capacity;
+  return RW_OK;
+}
+
+/* Splits tree into the nodes ranked before node and the rest. */
+static void split(LiveIndex *live, int tree, int node, int *before, int *rest) {
+  if (tree < 0) {
+    *before = -1;
+    *rest = -1;
+  } else if (ranks_before(live, tree, node)) {
+    split(live, live->right[tree], node, &live->right[tree], rest);
+    update_size(live, tree);
+    *before = tree;
+  } else {
+    split(live, live->left[tree], node, before, &live->left[tree]);
+    update_size(live, tree);
+    *rest = tree;
+  }
+}
+
+static int merge(LiveIndex *live, int a, int b) {
+  if (a < 0) return b;
+  if (b < 0) return a;
+  if (live->priority[a] > live->priority[b]) {
+    live->right[a] = merge(live, live->right[a], b);
+    update_size(live, a);
+    return a;
+  }
+  live->left[b] = merge(live, a, live->left[b]);
+  update_size(live, b);
+  return b;
+}
+
+static int erase(LiveIndex *live, int tree, int node) {
+  if (tree == node) return merge(live, live->left[tree], live->right[tree]);
+  if (ranks_before(live, node, tree)) live->left[tree] = erase(live, live->left[tree], node);
+  else live->right[tree] = erase(live, live->right[tree], node);
+  update_size(live, tree);
+  return tree;
+}
+
+static void insert(LiveIndex *live, int node) {
+  int before, rest;
+  live->left[node] = -1;
+  live->right[node] = -1;
+  live->size[node] = 1;
+  live->priority[node] = next_priority(live);
+  split(live, live->root, node, &before, &rest);
+  live->root = merge(live, merge(live, before, node), rest);
+}
+
+static int fix_sizes(LiveIndex *live, int node) {
+  if (node < 0) return 0;
+  live->size[node] = fix_sizes(live, live->left[node]) + fix_sizes(live, live->right[node]) + 1;
+  return live->size[node];
+}
+
+static double rank_key(double risk) {
+  return isnan(risk) ? -INFINITY : risk;
+}
+
+static void live_free(LiveIndex *live) {
+  rw_dict_free(&live->ids);
+  rw_arena_free(&live->arena);
+  free(live->left);
+  free(live->right);
+  free(live->size);
+  free(live->priority);
+  free(live->key);
+  free(live->present);
+  free(live->slot_of);
+  free(live);
+}
+
+int rw_live_begin(rw_engine *engine) {
+  if (engine->live) return RW_OK;
+  if (!engine->scored || engine->join) return RW_ERR_CONFIG;
+  int rc = rw_aggregate(engine);
+  if (rc != RW_OK) return rc;
+
+  LiveIndex *live = calloc(1, sizeof(LiveIndex));
+  if (!live) return RW_ERR_NOMEM;
+  live->seed = 0x9e3779b9u;
+  int count = engine->count;
+  if (live_reserve(live, count > 0 ? count : 1) != RW_OK) {
+    live_free(live);
+    return RW_ERR_NOMEM;
+  }
+
+  /* Slot i is row i. The treap is built over the slots in index order
+   * with a stack (a Cartesian tree on the priorities) in O(n). The ranked
+   * roster is already in that order unless it holds NaN risks, which the
+   * roster sort leaves anywhere; then the slots are sorted first. A
+   * repeated id maps to its last row. */
+  rw_trace_begin("live index", "live");
+  int *stack = malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+  RankEntry *order = NULL;
+  if (!stack) {
+    live_free(live);
+    rw_trace_end("live index", "live", 0);
+    return RW_ERR_NOMEM;
+  }
+  int sorted = 1;
+  for (int i = 0; i < count; i++) {
+    char *interned;
+    int id_index = rw_dict_intern(&live->ids, &live->arena, engine->scholars[i].id, &interned);
+    if (id_index < 0) {
+      free(stack);
+      live_free(live);
+      rw_trace_end("live index", "live", 0);
+      return RW_ERR_NOMEM;
+    }
+    live->slot_of[id_index] = i;
+    live->key[i] = rank_key(engine->scholars[i].risk_score);
+    live->present[i] = 1;
+    if (i > 0 && !ranks_before(live, i - 1, i)) sorted = 0;
+  }
+  if (!sorted) {
+    order = malloc(sizeof(RankEntry) * (size_t)count);
+    if (!order) {
+      free(stack);
+      live_free(live);
+      rw_trace_end("live index", "live", 0);
+      return RW_ERR_NOMEM;
+    }
+    for (int i = 0; i < count; i++) order[i] = (RankEntry){live->key[i], i};
+    qsort(order, (size_t)count, sizeof(RankEntry), compare_entries);
+  }
+  int depth = 0;
+  for (int r = 0; r < count; r++) {
+    int i = order ? order[r].slot : r;
+    live->priority[i] = next_priority(live);
+    live->right[i] = -1;
+    int last = -1;
+    while (depth > 0 && live->priority[stack[depth - 1]] < live->priority[i]) last = stack[--depth];
+    live->left[i] = last;
+    if (depth > 0) live->right[stack[depth - 1]] = i;
+    stack[depth++] = i;
+  }
+  live->slot_count = count;
+  live->root = depth > 0 ? stack[0] : -1;
+  fix_sizes(live, live->root);
+  free(stack);
+  free(order);
+  rw_trace_end("live index", "live", count);
+
+  engine->live = live;
+  return RW_OK;
+}
+
+int rw_live_order(const rw_engine *engine, int *slots) {
+  const LiveIndex *live = engine->live;
+  int *stack = malloc(sizeof(int) * (size_t)(engine->count > 0 ? engine->count : 1));
+  if (!stack) return RW_ERR_NOMEM;
+  int depth = 0;
+  int out = 0;
+  int node = live->root;
+  while (node >= 0 || depth > 0) {
+    while (node >= 0) {
+      stack[depth++] = node;
+      node = live->left[node];
+    }
+    node = stack[--depth];
+    slots[out++] = node;
+    node = live->right[node];
+  }
+  free(stack);
+  return RW_OK;
+}
+
+int rw_live_end(rw_engine *engine) {
+  LiveIndex *live = engine->live;
+  if (!live) return RW_OK;
+  int count = engine->count;
+  Scholar *ranked = malloc(sizeof(Scholar) * (size_t)(count > 0 ? count : 1));
+  int *order = malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+  if (!ranked || !order || rw_live_order(engine, order) != RW_OK) {
+    free(ranked);
+    free(order);
+    return RW_ERR_NOMEM;
+  }
+  for (int i = 0; i < count; i++) {
+    ranked[i] = engine->scholars[order[i]];
+  }
+  free(order);
+  free(engine->scholars);
+  engine->scholars = ranked;
+  engine->capacity = count > 0 ? count : 1;
+  engine->live = NULL;
+  live_free(live);
+  return RW_OK;
+}
+
+void rw_live_free(LiveIndex *live) {
+  if (live) live_free(live);
+}
+
+int rw_live_slot(const rw_engine *engine, const char *id) {
+  const LiveIndex *live = engine->live;
+  int id_index = rw_dict_find(&live->ids, id);
+  if (id_index < 0) return -1;
+  int slot = live->slot_of[id_index];
+  return live->present[slot] ? slot : -1;
+}
+
+void rw_live_unlink(rw_engine *engine, int slot) {
+  LiveIndex *live = engine->live;
+  live->root = erase(live, live->root, slot);
+  live->present[slot] = 0;
+  engine->count--;
+}
+
+int rw_live_link(rw_engine *engine, const Scholar *row) {
+  LiveIndex *live = engine->live;
+  if (live_reserve(live, live->slot_count + 1) != RW_OK) return -1;
+  int id_index = rw_dict_find(&live->ids, row->id);
+  int slot;
+  if (id_index >= 0) {
+    slot = live->slot_of[id_index];
+  } else {
+    char *interned;
+    id_index = rw_dict_intern(&live->ids, &live->arena, row->id, &interned);
+    if (id_index < 0) return -1;
+    slot = live->slot_count++;
+    live->slot_of[id_index] = slot;
+  }
+  if (slot >= engine->capacity) {
+    int capacity = engine->capacity == 0 ? 32 : engine->capacity;
+    while (capacity <= slot) capacity *= 2;
+    Scholar *scholars = realloc(engine->scholars, sizeof(Scholar) * (size_t)capacity);
+    if (!scholars) return -1;
+    engine->scholars = scholars;
+    engine->capacity = capacity;
+  }
+  engine->scholars[slot] = *row;
+  live->key[slot] = rank_key(row->risk_score);
+  live->present[slot] = 1;
+  insert(live, slot);
+  engine->count++;
+  return slot;
+}
+
+const Scholar *rw_live_at(const rw_engine *engine, int rank) {
+  const LiveIndex *live = engine->live;
+  int node = live->root;
+  while (node >= 0) {
+    int left = node_size(live, live->left[node]);
+    if (rank < left) {
+      node = live->left[node];
+    } else if (rank == left) {
+      return &engine->scholars[node];
+    } else {
+      rank -= left + 1;
+      node = live->right[node];
+    }
+  }
+  return NULL;
+}
+
+int rw_live_rank(const rw_engine *engine, int slot) {
+  const LiveIndex *live = engine->live;
+  int rank = 0;
+  int node = live->root;
+  while (node >= 0 && node != slot) {
+    if (ranks_before(live, slot, node)) {
+      node = live->left[node];
+    } else {
+      rank += node_size(live, live->left[node]) + 1;
+      node = live->right[node];
+    }
+  }
+  return rank + (node >= 0 ? node_size(live, live->left[node]) : 0);
+}
+
+int rw_live_count_at_least(const rw_engine *engine, double min_risk) {
+  const LiveIndex *live = engine->live;
+  int count = 0;
+  int node = live->root;
+  while (node >= 0) {
+    if (live->key[node] >= min_risk) {
+      count += node_size(live, live->left[node]) + 1;
+      node = live->right[node];
+    } else {
+      node = live->left[node];
+    }
+  }
+  return count;
+}
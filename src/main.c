@@ -1,223 +1,764 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
-#define MAX_FIELDS 16
+#include "retention.h"
+#include "instrument.h"
+#include "cache.h"
+#include "follow.h"
+#include "serve.h"
+#include "sink.h"
 
 typedef struct {
-  char *id;
-  char *name;
-  char *cohort;
-  double days_inactive;
-  double attendance_rate;
-  double engagement_score;
-  double gpa;
-  double last_contact_days;
-  double survey_score;
-  int open_flags;
-  double risk_score;
-} Scholar;
-
-typedef struct {
-  char *name;
-  int total;
+  int rows_read;
+  int skipped;
+  int filtered;
+  int loaded;
   int high;
   int medium;
   int low;
-  double avg_risk;
-} CohortSummary;
+  struct timespec started;
+} RunCounts;
 
-typedef struct {
-  char *action;
-  int total;
-  int high;
-  int medium;
-  int low;
-  double avg_risk;
-} ActionSummary;
+/* On glibc the allocator entry points are interposed here (this also sees
+ * the allocations libc makes for strdup, getline and stdio) and forwarded
+ * to the __libc_* implementations. Counting only happens under -alloc-stats. */
+#if defined(__GLIBC__)
+#define ALLOC_STATS_SUPPORTED 1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
 
-typedef struct {
-  const char *label;
-  double value;
-} Driver;
-
-static char *trim(char *s) {
-  while (*s && isspace((unsigned char)*s)) s++;
-  if (*s == 0) return s;
-  char *end = s + strlen(s) - 1;
-  while (end > s && isspace((unsigned char)*end)) end--;
-  end[1] = '\0';
-  return s;
+void *malloc(size_t size) {
+  rw_alloc_note(1, 0, size);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  rw_alloc_note(1, 0, (uint64_t)nmemb * size);
+  return __libc_calloc(nmemb, size);
 }
 
-static double clamp(double v, double min, double max) {
-  if (v < min) return min;
-  if (v > max) return max;
-  return v;
+void *realloc(void *ptr, size_t size) {
+  rw_alloc_note(1, ptr ? 1 : 0, size);
+  return __libc_realloc(ptr, size);
 }
 
+void free(void *ptr) {
+  if (ptr) rw_alloc_note(0, 1, 0);
+  __libc_free(ptr);
+}
+#else
+#define ALLOC_STATS_SUPPORTED 0
+#endif
+
 static double parse_double(const char *s) {
   if (!s || !*s) return 0.0;
   return atof(s);
 }
 
-static int parse_int(const char *s) {
-  if (!s || !*s) return 0;
-  return atoi(s);
+static int write_timings(const char *path) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    perror("Failed to write timings");
+    return 0;
+  }
+  fprintf(out, "{\n  \"stages\": {\n");
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    fprintf(out, "    \"%s\": {\"wall_ms\": %.4f, \"rows\": %ld, \"allocs\": %llu, \"alloc_bytes\": %llu}%s\n",
+            rw_stage_names[i], rw_stage_stats[i].wall_ms, rw_stage_stats[i].rows,
+            (unsigned long long)rw_stage_stats[i].allocs.allocs, (unsigned long long)rw_stage_stats[i].allocs.bytes,
+            (i + 1 == STAGE_COUNT) ? "" : ",");
+  }
+  fprintf(out, "  }\n}\n");
+  fclose(out);
+  return 1;
+}
+
+static long peak_rss_bytes(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return (long)usage.ru_maxrss;
+#else
+  return (long)usage.ru_maxrss * 1024L;
+#endif
 }
 
-static double compute_risk(const Scholar *s) {
-  double gpa_gap = clamp(4.0 - s->gpa, 0.0, 4.0);
-  double attendance_gap = clamp(100.0 - s->attendance_rate, 0.0, 100.0);
-  double engagement_gap = clamp(100.0 - s->engagement_score, 0.0, 100.0);
-  double survey_gap = clamp(100.0 - s->survey_score, 0.0, 100.0);
-
-  double score = 0.0;
-  score += s->days_inactive * 0.6;
-  score += s->last_contact_days * 0.4;
-  score += attendance_gap * 0.35;
-  score += engagement_gap * 0.25;
-  score += gpa_gap * 12.5;
-  score += survey_gap * 0.15;
-  score += s->open_flags * 6.0;
-  return clamp(score, 0.0, 100.0);
+static void metric_header(FILE *out, const char *name, const char *help) {
+  fprintf(out, "# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
 }
 
-static int compare_driver_desc(const void *a, const void *b) {
-  const Driver *da = (const Driver *)a;
-  const Driver *db = (const Driver *)b;
-  if (da->value < db->value) return 1;
-  if (da->value > db->value) return -1;
-  return 0;
+/* Writes Prometheus exposition text for the node_exporter textfile
+ * collector. The file is written beside PATH and renamed into place so a
+ * scrape never sees a partial file. */
+static int write_metrics(const char *path, const RunCounts *counts) {
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+  FILE *out = fopen(tmp_path, "w");
+  if (!out) {
+    perror("Failed to write metrics");
+    return 0;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  metric_header(out, "retention_watch_run_duration_seconds", "Wall time of the last run.");
+  fprintf(out, "retention_watch_run_duration_seconds %.6f\n", rw_elapsed_ms(&counts->started, &now) / 1000.0);
+  metric_header(out, "retention_watch_last_run_timestamp_seconds", "Unix time the last run finished.");
+  fprintf(out, "retention_watch_last_run_timestamp_seconds %ld\n", (long)time(NULL));
+  metric_header(out, "retention_watch_rows", "Rows seen by the last run, by outcome.");
+  fprintf(out, "retention_watch_rows{state=\"read\"} %d\n", counts->rows_read);
+  fprintf(out, "retention_watch_rows{state=\"skipped\"} %d\n", counts->skipped);
+  fprintf(out, "retention_watch_rows{state=\"filtered\"} %d\n", counts->filtered);
+  fprintf(out, "retention_watch_rows{state=\"loaded\"} %d\n", counts->loaded);
+  metric_header(out, "retention_watch_stage_duration_seconds", "Wall time per pipeline stage in the last run.");
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    fprintf(out, "retention_watch_stage_duration_seconds{stage=\"%s\"} %.6f\n", rw_stage_names[i], rw_stage_stats[i].wall_ms / 1000.0);
+  }
+  metric_header(out, "retention_watch_peak_rss_bytes", "Peak resident set size of the last run.");
+  fprintf(out, "retention_watch_peak_rss_bytes %ld\n", peak_rss_bytes());
+  metric_header(out, "retention_watch_tier_scholars", "Scholars per risk tier in the last run.");
+  fprintf(out, "retention_watch_tier_scholars{tier=\"high\"} %d\n", counts->high);
+  fprintf(out, "retention_watch_tier_scholars{tier=\"medium\"} %d\n", counts->medium);
+  fprintf(out, "retention_watch_tier_scholars{tier=\"low\"} %d\n", counts->low);
+
+  if (fclose(out) != 0 || rename(tmp_path, path) != 0) {
+    perror("Failed to write metrics");
+    remove(tmp_path);
+    return 0;
+  }
+  return 1;
+}
+
+/* Joined (-join) columns for one ranked scholar, appended to its JSON
+ * object or text line; unmatched scholars get null or "-". */
+static void print_join_json(const rw_engine *engine, int rank) {
+  int columns = rw_join_column_count(engine);
+  for (int c = 0; c < columns; c++) {
+    const char *value = rw_join_value(engine, rank, c);
+    if (value) {
+      printf(", \"%s\": \"%s\"", rw_join_column_name(engine, c), value);
+    } else {
+      printf(", \"%s\": null", rw_join_column_name(engine, c));
+    }
+  }
+}
+
+static void print_join_text(const rw_engine *engine, int rank) {
+  int columns = rw_join_column_count(engine);
+  for (int c = 0; c < columns; c++) {
+    const char *value = rw_join_value(engine, rank, c);
+    printf("%s%s: %s", c == 0 ? " | " : ", ", rw_join_column_name(engine, c), value ? value : "-");
+  }
+}
+
+/* The scholar's within-cohort risk z-score (-cohort-stats). */
+static double zscore(const rw_engine *engine, int rank) {
+  double z = 0.0;
+  rw_zscore_at(engine, rank, &z);
+  return z;
+}
+
+static void print_queue_json(const rw_engine *engine, double min_risk, int limit, int drivers, int zscores) {
+  rw_iter iter;
+  rw_scholar s;
+  char driver_text[256];
+  printf("  \"action_queue\": [\n");
+  int printed = 0;
+  rw_topk_begin(engine, min_risk, limit, &iter);
+  while (rw_topk_next(&iter, &s)) {
+    if (printed > 0) {
+      printf(",\n");
+    }
+    if (drivers) {
+      rw_drivers_at(engine, s.rank, driver_text, sizeof(driver_text));
+      printf("    {\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\", \"drivers\": \"%s\"",
+             s.scholar_id, s.name, s.cohort, s.risk, s.tier, s.action, driver_text);
+    } else {
+      printf("    {\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\"",
+             s.scholar_id, s.name, s.cohort, s.risk, s.tier, s.action);
+    }
+    if (zscores) printf(", \"risk_z\": %.2f", zscore(engine, s.rank));
+    print_join_json(engine, s.rank);
+    printf("}");
+    printed++;
+  }
+  if (printed > 0) {
+    printf("\n");
+  }
+}
+
+static void print_queue_text(const rw_engine *engine, double min_risk, int limit, int drivers, int zscores) {
+  rw_iter iter;
+  rw_scholar s;
+  char driver_text[256];
+  printf("\nAction queue (top %d, min risk %.1f):\n", limit, min_risk);
+  int printed = 0;
+  rw_topk_begin(engine, min_risk, limit, &iter);
+  while (rw_topk_next(&iter, &s)) {
+    if (drivers) {
+      rw_drivers_at(engine, s.rank, driver_text, sizeof(driver_text));
+      printf("%2d. %-14s %-18s cohort %-10s risk %.1f (%s) -> %s | drivers: %s",
+             printed + 1, s.scholar_id, s.name, s.cohort, s.risk, s.tier, s.action,
+             driver_text);
+    } else {
+      printf("%2d. %-14s %-18s cohort %-10s risk %.1f (%s) -> %s",
+             printed + 1, s.scholar_id, s.name, s.cohort, s.risk, s.tier, s.action);
+    }
+    if (zscores) printf(" | z %.2f", zscore(engine, s.rank));
+    print_join_text(engine, s.rank);
+    printf("\n");
+    printed++;
+  }
+  if (printed == 0) {
+    printf("No scholars met the minimum risk threshold.\n");
+  }
 }
 
-static void format_drivers(const Scholar *s, char *buffer, size_t size) {
-  Driver drivers[8];
-  int count = 0;
-
-  double gpa_gap = clamp(4.0 - s->gpa, 0.0, 4.0);
-  double attendance_gap = clamp(100.0 - s->attendance_rate, 0.0, 100.0);
-  double engagement_gap = clamp(100.0 - s->engagement_score, 0.0, 100.0);
-  double survey_gap = clamp(100.0 - s->survey_score, 0.0, 100.0);
-
-  double inactivity = s->days_inactive * 0.6;
-  double contact_gap = s->last_contact_days * 0.4;
-  double attendance = attendance_gap * 0.35;
-  double engagement = engagement_gap * 0.25;
-  double gpa = gpa_gap * 12.5;
-  double survey = survey_gap * 0.15;
-  double flags = s->open_flags * 6.0;
-
-  if (inactivity > 0.1) drivers[count++] = (Driver){"inactivity", inactivity};
-  if (contact_gap > 0.1) drivers[count++] = (Driver){"contact gap", contact_gap};
-  if (attendance > 0.1) drivers[count++] = (Driver){"attendance", attendance};
-  if (engagement > 0.1) drivers[count++] = (Driver){"engagement", engagement};
-  if (gpa > 0.1) drivers[count++] = (Driver){"gpa", gpa};
-  if (survey > 0.1) drivers[count++] = (Driver){"survey", survey};
-  if (flags > 0.1) drivers[count++] = (Driver){"open flags", flags};
-
-  if (count == 0) {
-    snprintf(buffer, size, "stable");
+/* One line per advisor with its load; the JSON form is one object. */
+static void print_assignment(const rw_engine *engine, double min_risk, int json) {
+  int considered, assigned;
+  rw_assign_totals(engine, &considered, &assigned);
+  int advisors = rw_advisor_count(engine);
+  rw_advisor advisor;
+  if (json) {
+    printf("  \"assignment\": {\"min_risk\": %.1f, \"considered\": %d, \"assigned\": %d, \"unassigned\": %d, \"advisors\": [\n",
+           min_risk, considered, assigned, considered - assigned);
+    for (int a = 0; a < advisors; a++) {
+      rw_advisor_at(engine, a, &advisor);
+      printf("    {\"advisor\": \"%s\", \"capacity\": %d, \"assigned\": %d, \"avg_risk\": %.1f}%s\n",
+             advisor.name, advisor.capacity, advisor.assigned, advisor.avg_risk, (a + 1 == advisors) ? "" : ",");
+    }
+    printf("  ]},\n");
     return;
   }
+  printf("\nAdvisor assignment (min risk %.1f): assigned %d of %d scholars, %d unassigned\n",
+         min_risk, assigned, considered, considered - assigned);
+  for (int a = 0; a < advisors; a++) {
+    rw_advisor_at(engine, a, &advisor);
+    printf("- %s: %d of %d, avg risk %.1f\n", advisor.name, advisor.assigned, advisor.capacity, advisor.avg_risk);
+  }
+}
 
-  qsort(drivers, count, sizeof(Driver), compare_driver_desc);
+/* Per-advisor work lists, advisors in file order and each list highest
+ * risk first. */
+static int write_worklist(const rw_engine *engine, const char *path) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    perror("Failed to write work list");
+    return 0;
+  }
+  fprintf(out, "advisor,position,scholar_id,name,cohort,risk_score,tier,action,match\n");
+  rw_advisor advisor;
+  rw_scholar s;
+  for (int a = 0; a < rw_advisor_count(engine); a++) {
+    rw_advisor_at(engine, a, &advisor);
+    for (int i = 0; i < advisor.assigned; i++) {
+      int match;
+      int rank = rw_worklist_at(engine, a, i);
+      rw_scholar_at(engine, rank, &s);
+      rw_assignment_at(engine, rank, &match);
+      fprintf(out, "%s,%d,%s,%s,%s,%.1f,%s,%s,%s\n", advisor.name, i + 1, s.scholar_id, s.name, s.cohort,
+              s.risk, s.tier, s.action, rw_match_name(match));
+    }
+  }
+  fclose(out);
+  return 1;
+}
 
-  buffer[0] = '\0';
-  int max = count < 3 ? count : 3;
-  for (int i = 0; i < max; i++) {
-    char chunk[64];
-    snprintf(chunk, sizeof(chunk), "%s %.1f", drivers[i].label, drivers[i].value);
-    if (i > 0) {
-      strncat(buffer, "; ", size - strlen(buffer) - 1);
+/* Mean, standard deviation and range of every stat column per cohort; the
+ * JSON form is one "cohort_stats" member. */
+static void print_cohort_stats(const rw_engine *engine, int json) {
+  int cohort_count = rw_cohort_count(engine);
+  rw_summary sum;
+  rw_stats stats;
+  if (json) printf("  \"cohort_stats\": [\n");
+  else printf("\nCohort statistics (mean, sd, min-max):\n");
+  for (int i = 0; i < cohort_count; i++) {
+    rw_cohort_at(engine, i, &sum);
+    if (json) printf("    {\"cohort\": \"%s\"", sum.name);
+    else printf("- %s:\n", sum.name);
+    for (int c = 0; c < RW_STAT_COLUMNS; c++) {
+      if (rw_cohort_stats_at(engine, i, c, &stats) != RW_OK) continue;
+      if (json) {
+        printf(", \"%s\": {\"count\": %d, \"mean\": %.2f, \"sd\": %.2f, \"min\": %.2f, \"max\": %.2f}",
+               rw_column_name(c), stats.count, stats.mean, sqrt(stats.variance), stats.min, stats.max);
+      } else {
+        printf("    %-18s %8.2f %8.2f %8.2f-%.2f\n", rw_column_name(c), stats.mean, sqrt(stats.variance), stats.min,
+               stats.max);
+      }
     }
-    strncat(buffer, chunk, size - strlen(buffer) - 1);
+    if (json) printf("}%s\n", (i + 1 == cohort_count) ? "" : ",");
   }
+  if (json) printf("  ],\n");
 }
 
-static const char *risk_tier(double score, double high_threshold, double medium_threshold) {
-  if (score >= high_threshold) return "high";
-  if (score >= medium_threshold) return "medium";
-  return "low";
+typedef struct {
+  int limit;
+  double min_risk;
+  double high_threshold;
+  double medium_threshold;
+  int json;
+  int json_full;
+  int drivers;
+  const char *summary_path;
+  const char *action_path;
+  const char *group_by;
+  int assign;
+  /* Per-cohort column statistics and risk z-scores. */
+  int cohort_stats;
+  /* -follow already streamed the live state: write only the files. */
+  int files_only;
+} ReportOptions;
+
+/* Writes the summary/action CSVs and the text or JSON report for an
+ * aggregated engine; returns 0 when an output file cannot be opened. */
+static int write_report(const rw_engine *engine, const ReportOptions *opt, rw_totals *totals) {
+  int count = rw_count(engine);
+  int limit = opt->limit;
+  double min_risk = opt->min_risk;
+  double high_threshold = opt->high_threshold;
+  double medium_threshold = opt->medium_threshold;
+  int drivers = opt->drivers;
+  const char *summary_path = opt->summary_path;
+  const char *action_path = opt->action_path;
+  rw_get_totals(engine, totals);
+  int cohort_count = rw_cohort_count(engine);
+  int action_count = rw_action_count(engine);
+  int group_count = rw_group_count(engine);
+  rw_summary sum;
+  rw_scholar s;
+  char driver_text[256];
+
+  if (summary_path) {
+    FILE *summary = fopen(summary_path, "w");
+    if (!summary) {
+      perror("Failed to write summary");
+      return 0;
+    }
+    fprintf(summary, "cohort,total,avg_risk,high,medium,low\n");
+    for (int i = 0; i < cohort_count; i++) {
+      rw_cohort_at(engine, i, &sum);
+      fprintf(summary, "%s,%d,%.1f,%d,%d,%d\n",
+              sum.name, sum.total, sum.avg_risk, sum.high, sum.medium, sum.low);
+    }
+    fclose(summary);
+  }
+
+  if (action_path) {
+    FILE *action_out = fopen(action_path, "w");
+    if (!action_out) {
+      perror("Failed to write action summary");
+      return 0;
+    }
+    fprintf(action_out, "action,total,avg_risk,high,medium,low\n");
+    for (int i = 0; i < action_count; i++) {
+      rw_action_at(engine, i, &sum);
+      fprintf(action_out, "%s,%d,%.1f,%d,%d,%d\n",
+              sum.name, sum.total, sum.avg_risk, sum.high, sum.medium, sum.low);
+    }
+    fclose(action_out);
+  }
+  if (opt->files_only) {
+    return 1;
+  }
+
+  int focus_max = cohort_count < 3 ? cohort_count : 3;
+  if (opt->json) {
+    printf("{\n");
+    printf("  \"total\": %d,\n", count);
+    printf("  \"average_risk\": %.1f,\n", totals->avg_risk);
+    printf("  \"risk_thresholds\": {\"high\": %.1f, \"medium\": %.1f},\n", high_threshold, medium_threshold);
+    printf("  \"tiers\": {\n");
+    printf("    \"high\": %d,\n", totals->high);
+    printf("    \"medium\": %d,\n", totals->medium);
+    printf("    \"low\": %d\n", totals->low);
+    printf("  },\n");
+    printf("  \"action_queue_min_risk\": %.1f,\n", min_risk);
+    printf("  \"cohorts\": [\n");
+    for (int i = 0; i < cohort_count; i++) {
+      rw_cohort_at(engine, i, &sum);
+      printf("    {\"cohort\": \"%s\", \"total\": %d, \"avg_risk\": %.1f, \"high\": %d, \"medium\": %d, \"low\": %d}%s\n",
+             sum.name, sum.total, sum.avg_risk, sum.high, sum.medium, sum.low,
+             (i + 1 == cohort_count) ? "" : ",");
+    }
+    printf("  ],\n");
+    printf("  \"cohort_focus\": [\n");
+    for (int i = 0; i < focus_max; i++) {
+      rw_cohort_focus_at(engine, i, &sum);
+      printf("    {\"cohort\": \"%s\", \"avg_risk\": %.1f, \"total\": %d, \"high\": %d, \"medium\": %d, \"low\": %d}%s\n",
+             sum.name, sum.avg_risk, sum.total, sum.high, sum.medium, sum.low,
+             (i + 1 == focus_max) ? "" : ",");
+    }
+    printf("  ],\n");
+    if (opt->cohort_stats) print_cohort_stats(engine, 1);
+    if (opt->group_by) {
+      printf("  \"group_by\": \"%s\",\n", opt->group_by);
+      printf("  \"groups\": [\n");
+      for (int i = 0; i < group_count; i++) {
+        rw_group_at(engine, i, &sum);
+        printf("    {\"group\": \"%s\", \"total\": %d, \"avg_risk\": %.1f, \"high\": %d, \"medium\": %d, \"low\": %d}%s\n",
+               sum.name, sum.total, sum.avg_risk, sum.high, sum.medium, sum.low,
+               (i + 1 == group_count) ? "" : ",");
+      }
+      printf("  ],\n");
+    }
+    printf("  \"actions\": [\n");
+    for (int i = 0; i < action_count; i++) {
+      rw_action_at(engine, i, &sum);
+      printf("    {\"action\": \"%s\", \"total\": %d, \"avg_risk\": %.1f, \"high\": %d, \"medium\": %d, \"low\": %d}%s\n",
+             sum.name, sum.total, sum.avg_risk, sum.high, sum.medium, sum.low,
+             (i + 1 == action_count) ? "" : ",");
+    }
+    printf("  ],\n");
+    if (opt->assign) print_assignment(engine, min_risk, 1);
+    print_queue_json(engine, min_risk, limit, drivers, opt->cohort_stats);
+    printf("  ]");
+    if (opt->json_full) {
+      printf(",\n  \"records\": [\n");
+      for (int i = 0; i < count; i++) {
+        rw_scholar_at(engine, i, &s);
+        if (drivers) {
+          rw_drivers_at(engine, i, driver_text, sizeof(driver_text));
+          printf("    {\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"days_inactive\": %.1f, \"attendance_rate\": %.1f, \"engagement_score\": %.1f, \"gpa\": %.2f, \"last_contact_days\": %.1f, \"survey_score\": %.1f, \"open_flags\": %d, \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\", \"drivers\": \"%s\"",
+                 s.scholar_id, s.name, s.cohort, s.days_inactive, s.attendance_rate, s.engagement_score,
+                 s.gpa, s.last_contact_days, s.survey_score, s.open_flags, s.risk,
+                 s.tier, s.action, driver_text);
+        } else {
+          printf("    {\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"days_inactive\": %.1f, \"attendance_rate\": %.1f, \"engagement_score\": %.1f, \"gpa\": %.2f, \"last_contact_days\": %.1f, \"survey_score\": %.1f, \"open_flags\": %d, \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\"",
+                 s.scholar_id, s.name, s.cohort, s.days_inactive, s.attendance_rate, s.engagement_score,
+                 s.gpa, s.last_contact_days, s.survey_score, s.open_flags, s.risk,
+                 s.tier, s.action);
+        }
+        if (opt->cohort_stats) printf(", \"risk_z\": %.2f", zscore(engine, i));
+        print_join_json(engine, i);
+        printf("}%s\n", (i + 1 == count) ? "" : ",");
+      }
+      printf("  ]\n");
+    } else {
+      printf("\n");
+    }
+    printf("}\n");
+  } else {
+    printf("Group Scholar Retention Watch\n\n");
+    printf("Records: %d  Average risk: %.1f  Skipped rows: %d\n", count, totals->avg_risk, totals->skipped);
+    printf("Risk tiers (high >= %.1f, medium >= %.1f): high %d | medium %d | low %d\n\n",
+           high_threshold, medium_threshold, totals->high, totals->medium, totals->low);
+
+    printf("Cohort summary:\n");
+    for (int i = 0; i < cohort_count; i++) {
+      rw_cohort_at(engine, i, &sum);
+      printf("- %s: total %d, avg risk %.1f, high %d, medium %d, low %d\n",
+             sum.name, sum.total, sum.avg_risk, sum.high, sum.medium, sum.low);
+    }
+
+    if (cohort_count > 0) {
+      printf("\nCohort focus (top %d by avg risk):\n", focus_max);
+      for (int i = 0; i < focus_max; i++) {
+        rw_cohort_focus_at(engine, i, &sum);
+        printf("- %s: avg risk %.1f (high %d, medium %d, low %d)\n",
+               sum.name, sum.avg_risk, sum.high, sum.medium, sum.low);
+      }
+    }
+
+    if (opt->cohort_stats) print_cohort_stats(engine, 0);
+
+    if (opt->group_by) {
+      printf("\nGroup summary (%s):\n", opt->group_by);
+      for (int i = 0; i < group_count; i++) {
+        rw_group_at(engine, i, &sum);
+        printf("- %s: total %d, avg risk %.1f, high %d, medium %d, low %d\n",
+               sum.name, sum.total, sum.avg_risk, sum.high, sum.medium, sum.low);
+      }
+    }
+
+    if (action_count > 0) {
+      printf("\nAction summary:\n");
+      for (int i = 0; i < action_count; i++) {
+        rw_action_focus_at(engine, i, &sum);
+        printf("- %s: total %d, avg risk %.1f (high %d, medium %d, low %d)\n",
+               sum.name, sum.total, sum.avg_risk, sum.high, sum.medium, sum.low);
+      }
+    }
+
+    print_queue_text(engine, min_risk, limit, drivers, opt->cohort_stats);
+    if (opt->assign) print_assignment(engine, min_risk, 0);
+  }
+  return 1;
 }
 
-static const char *action_hint(const Scholar *s) {
-  if (s->days_inactive >= 30.0) return "re-engage outreach";
-  if (s->attendance_rate < 70.0) return "attendance support";
-  if (s->gpa < 2.5) return "academic support";
-  if (s->open_flags > 0) return "resolve open flags";
-  if (s->engagement_score < 60.0) return "engagement nudge";
-  return "lightweight check-in";
+static void print_query_report(const rw_engine *engine, const rw_snapshot_stats *stats, double min_risk,
+                               int limit, int drivers, int json) {
+  if (json) {
+    printf("{\n");
+    printf("  \"snapshot\": {\"records\": %d, \"chunks\": %d, \"chunks_read\": %d, \"loaded\": %d},\n",
+           stats->rows_total, stats->chunks_total, stats->chunks_read, rw_count(engine));
+    printf("  \"action_queue_min_risk\": %.1f,\n", min_risk);
+    print_queue_json(engine, min_risk, limit, drivers, 0);
+    printf("  ]\n}\n");
+    return;
+  }
+  printf("Group Scholar Retention Watch\n\n");
+  printf("Snapshot query: read %d of %d chunks, loaded %d of %d records\n",
+         stats->chunks_read, stats->chunks_total, rw_count(engine), stats->rows_total);
+  print_queue_text(engine, min_risk, limit, drivers, 0);
 }
 
-static int compare_risk_desc(const void *a, const void *b) {
-  const Scholar *sa = (const Scholar *)a;
-  const Scholar *sb = (const Scholar *)b;
-  if (sa->risk_score < sb->risk_score) return 1;
-  if (sa->risk_score > sb->risk_score) return -1;
-  return 0;
+/* Risk quantiles in the -sample report. */
+static const double sample_quantiles[] = {0.5, 0.9, 0.95, 0.99};
+
+static void print_estimate_json(const char *name, const rw_estimate *e, int decimals) {
+  printf("\"%s\": {\"value\": %.*f, \"lower\": %.*f, \"upper\": %.*f}", name, decimals, e->value, decimals, e->low,
+         decimals, e->high);
 }
 
-static int compare_cohort_avg_desc(const void *a, const void *b) {
-  const CohortSummary *ca = *(const CohortSummary **)a;
-  const CohortSummary *cb = *(const CohortSummary **)b;
-  double avg_a = ca->avg_risk / (double)ca->total;
-  double avg_b = cb->avg_risk / (double)cb->total;
-  if (avg_a < avg_b) return 1;
-  if (avg_a > avg_b) return -1;
-  return 0;
+/* The -sample report: population estimates with confidence intervals in
+ * place of the ranked roster. */
+static void print_sample_report(const rw_engine *engine, const rw_sample_options *sample, double confidence,
+                                int json) {
+  rw_sample_totals est;
+  rw_estimate share, average, quantile;
+  rw_summary sum;
+  rw_sample_estimate(engine, confidence, &est);
+  const char *method = sample->size > 0 ? "reservoir" : "bernoulli";
+  int cohort_count = rw_cohort_count(engine);
+  int quantile_count = (int)(sizeof(sample_quantiles) / sizeof(sample_quantiles[0]));
+
+  if (json) {
+    printf("{\n");
+    printf("  \"sample\": {\"method\": \"%s\", \"rows\": %lld, \"sampled\": %d, \"confidence\": %.2f},\n", method,
+           est.population, est.sampled, confidence);
+    printf("  \"tiers\": {\n");
+    for (int t = 0; t < RW_TIER_COUNT; t++) {
+      printf("    \"%s\": {", rw_tier_name(t));
+      print_estimate_json("share", &est.tier_share[t], 4);
+      printf(", \"estimated_count\": %.0f}%s\n", est.tier_share[t].value * (double)est.population,
+             t + 1 == RW_TIER_COUNT ? "" : ",");
+    }
+    printf("  },\n  ");
+    print_estimate_json("average_risk", &est.average_risk, 2);
+    printf(",\n  \"risk_quantiles\": [\n");
+    for (int i = 0; i < quantile_count; i++) {
+      rw_sample_quantile(engine, sample_quantiles[i], confidence, &quantile);
+      printf("    {\"q\": %.2f, \"value\": %.1f, \"lower\": %.1f, \"upper\": %.1f}%s\n", sample_quantiles[i],
+             quantile.value, quantile.low, quantile.high, i + 1 == quantile_count ? "" : ",");
+    }
+    printf("  ],\n  \"cohorts\": [\n");
+    for (int i = 0; i < cohort_count; i++) {
+      rw_cohort_at(engine, i, &sum);
+      rw_sample_cohort_at(engine, i, confidence, &share, &average);
+      printf("    {\"cohort\": \"%s\", \"sampled\": %d, ", sum.name, sum.total);
+      print_estimate_json("share", &share, 4);
+      printf(", ");
+      print_estimate_json("average_risk", &average, 2);
+      printf("}%s\n", i + 1 == cohort_count ? "" : ",");
+    }
+    printf("  ]\n}\n");
+    return;
+  }
+
+  printf("Group Scholar Retention Watch\n\n");
+  printf("Sample: %d of %lld rows (%s), %.0f%% confidence intervals\n", est.sampled, est.population, method,
+         confidence * 100.0);
+  printf("Tiers:");
+  for (int t = 0; t < RW_TIER_COUNT; t++) {
+    const rw_estimate *e = &est.tier_share[t];
+    printf("%s %s %.1f%% [%.1f-%.1f%%] ~%.0f", t == 0 ? "" : " |", rw_tier_name(t), e->value * 100.0,
+           e->low * 100.0, e->high * 100.0, e->value * (double)est.population);
+  }
+  printf("\nAverage risk: %.1f [%.1f-%.1f]\n", est.average_risk.value, est.average_risk.low, est.average_risk.high);
+  printf("Risk quantiles:");
+  for (int i = 0; i < quantile_count; i++) {
+    rw_sample_quantile(engine, sample_quantiles[i], confidence, &quantile);
+    printf("%s p%g %.1f [%.1f-%.1f]", i == 0 ? "" : " |", sample_quantiles[i] * 100.0, quantile.value, quantile.low,
+           quantile.high);
+  }
+  printf("\n\nCohorts (share of scholars, average risk):\n");
+  for (int i = 0; i < cohort_count; i++) {
+    rw_cohort_at(engine, i, &sum);
+    rw_sample_cohort_at(engine, i, confidence, &share, &average);
+    printf("- %s: %.1f%% [%.1f-%.1f%%], avg risk %.1f [%.1f-%.1f] (n %d)\n", sum.name, share.value * 100.0,
+           share.low * 100.0, share.high * 100.0, average.value, average.low, average.high, sum.total);
+  }
 }
 
-static int compare_action_avg_desc(const void *a, const void *b) {
-  const ActionSummary *aa = *(const ActionSummary **)a;
-  const ActionSummary *ab = *(const ActionSummary **)b;
-  double avg_a = aa->avg_risk / (double)aa->total;
-  double avg_b = ab->avg_risk / (double)ab->total;
-  if (avg_a < avg_b) return 1;
-  if (avg_a > avg_b) return -1;
-  return 0;
+/* -sample RATE|N: a rate below 1 (0.01) or a percentage (1%) keeps each
+ * row independently; a whole number is a reservoir size. */
+static int parse_sample(const char *text, rw_sample_options *options) {
+  char *end;
+  double value = strtod(text, &end);
+  options->rate = 0.0;
+  options->size = 0;
+  options->seed = 0;
+  if (end == text) return 0;
+  if (strcmp(end, "%") == 0) {
+    options->rate = value / 100.0;
+  } else if (*end != '\0') {
+    return 0;
+  } else if (value < 1.0) {
+    options->rate = value;
+  } else if (value == floor(value) && value <= (double)INT_MAX) {
+    options->size = (int)value;
+  }
+  return options->size > 0 || (options->rate > 0.0 && options->rate <= 1.0);
 }
 
-static CohortSummary *find_or_create_cohort(CohortSummary **cohorts, int *count, const char *name) {
-  for (int i = 0; i < *count; i++) {
-    if (strcmp((*cohorts)[i].name, name) == 0) {
-      return &(*cohorts)[i];
-    }
-  }
-  *cohorts = realloc(*cohorts, sizeof(CohortSummary) * (*count + 1));
-  CohortSummary *cs = &(*cohorts)[*count];
-  cs->name = strdup(name);
-  cs->total = 0;
-  cs->high = 0;
-  cs->medium = 0;
-  cs->low = 0;
-  cs->avg_risk = 0.0;
-  (*count)++;
-  return cs;
+/* Loads -join PATH:KEY (KEY defaults to scholar_id) and the -where and
+ * -group-by settings over it; returns 0 after reporting an error. */
+static int load_join(rw_engine *engine, const char *spec, const char *where, const char *group_by) {
+  char path[4096];
+  const char *key = "scholar_id";
+  snprintf(path, sizeof(path), "%s", spec);
+  char *colon = strrchr(path, ':');
+  if (colon) {
+    *colon = '\0';
+    key = spec + (colon - path) + 1;
+  }
+  int rc = rw_load_join(engine, path, key);
+  if (rc == RW_ERR_IO) {
+    perror("Failed to read join file");
+    return 0;
+  }
+  if (rc == RW_ERR_CONFIG) {
+    fprintf(stderr, "Join key column %s not found in %s.\n", key, path);
+    return 0;
+  }
+  if (rc != RW_OK) {
+    fprintf(stderr, "Failed to load join file: %s\n", rw_strerror(rc));
+    return 0;
+  }
+
+  if (where) {
+    char column[256];
+    const char *eq = strchr(where, '=');
+    if (!eq || (size_t)(eq - where) >= sizeof(column)) {
+      fprintf(stderr, "-where expects COLUMN=VALUE.\n");
+      return 0;
+    }
+    memcpy(column, where, (size_t)(eq - where));
+    column[eq - where] = '\0';
+    if (rw_join_where(engine, column, eq + 1) != RW_OK) {
+      fprintf(stderr, "Unknown -where column %s in %s.\n", column, path);
+      return 0;
+    }
+  }
+  if (group_by && rw_join_group_by(engine, group_by) != RW_OK) {
+    fprintf(stderr, "Unknown -group-by column %s in %s.\n", group_by, path);
+    return 0;
+  }
+  return 1;
 }
 
-static ActionSummary *find_or_create_action(ActionSummary **actions, int *count, const char *name) {
-  for (int i = 0; i < *count; i++) {
-    if (strcmp((*actions)[i].action, name) == 0) {
-      return &(*actions)[i];
-    }
-  }
-  *actions = realloc(*actions, sizeof(ActionSummary) * (*count + 1));
-  ActionSummary *as = &(*actions)[*count];
-  as->action = strdup(name);
-  as->total = 0;
-  as->high = 0;
-  as->medium = 0;
-  as->low = 0;
-  as->avg_risk = 0.0;
-  (*count)++;
-  return as;
+static void print_event_stats(const rw_events_stats *stats, const char *path) {
+  char as_of[16] = "-";
+  if (stats->events > 0) {
+    time_t seconds = (time_t)stats->as_of_day * 86400;
+    struct tm day;
+    gmtime_r(&seconds, &day);
+    strftime(as_of, sizeof(as_of), "%Y-%m-%d", &day);
+  }
+  fprintf(stderr, "Events: %lld from %s (threads %d), %lld skipped, %lld unknown type, %lld for scholars not in the roster; "
+          "%d of %d scholars updated as of %s\n",
+          stats->events, path, stats->threads, stats->skipped, stats->unknown_types, stats->orphans,
+          stats->matched, stats->scholars, as_of);
+}
+
+static void print_change_stats(const rw_changes_stats *stats, const char *path) {
+  fprintf(stderr, "Changes: %d from %s, %d updated, %d inserted, %d deleted, %d deletes for scholars not in the roster, "
+          "%d skipped, %d filtered; %d rescored\n",
+          stats->rows, path, stats->updated, stats->inserted, stats->deleted, stats->missing, stats->skipped,
+          stats->filtered, stats->rescored);
+}
+
+/* The previous run's snapshot for -export-delta, read through the same
+ * config so tiers and the cohort filter match; NULL after an error. */
+static rw_engine *load_previous(const char *path, const rw_config *config) {
+  if (!rw_is_snapshot(path)) {
+    fprintf(stderr, "-export-delta needs a snapshot from an earlier run (write one with -snapshot PATH).\n");
+    return NULL;
+  }
+  rw_engine *previous = rw_engine_new(config);
+  if (!previous) {
+    fprintf(stderr, "Failed to read previous snapshot: %s\n", rw_strerror(RW_ERR_NOMEM));
+    return NULL;
+  }
+  rw_snapshot_filter filter = {-INFINITY, config->cohort_filter, -1};
+  int rc = rw_snapshot_query(previous, path, &filter, NULL);
+  if (rc != RW_OK) {
+    if (rc == RW_ERR_IO) perror("Failed to read previous snapshot");
+    else fprintf(stderr, "Failed to read previous snapshot: %s\n", rw_strerror(rc));
+    rw_engine_free(previous);
+    return NULL;
+  }
+  return previous;
+}
+
+/* Waits for the sink to drain and reports it on stderr; 0 when records
+ * were lost. */
+static int close_sink(Sink *sink, const char *url) {
+  SinkStats stats;
+  int ok = sink_close(sink, &stats);
+  fprintf(stderr, "Sink: %lld records in %lld batches to %s, %lld retries, %lld failed batches (%lld records); "
+          "producer waited %lld times (%.1f ms)\n",
+          stats.records, stats.batches, url, stats.retries, stats.failed_batches, stats.failed_records, stats.stalls,
+          stats.stalled_ms);
+  if (!ok) fprintf(stderr, "Failed to deliver every record to the sink.\n");
+  return ok;
+}
+
+/* Stops the HTTP server and reports it on stderr. */
+static void close_server(Server *server) {
+  ServeStats stats;
+  serve_close(server, &stats);
+  fprintf(stderr, "Served: %lld requests on %lld connections, %lld bodies rendered, %lld from cache, %lld not modified\n",
+          stats.requests, stats.connections, stats.renders, stats.cache_hits, stats.not_modified);
+}
+
+/* A TCP port for -serve, or -1. */
+static int parse_port(const char *text) {
+  char *end;
+  long port = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || port < 0 || port > 65535) return -1;
+  return (int)port;
 }
 
 static void print_usage(const char *prog) {
   printf("Group Scholar Retention Watch\n\n");
-  printf("Usage: %s <csv-file> [-limit N] [-min-risk SCORE] [-cohort NAME] [-export PATH] [-summary PATH] [-actions PATH] [-json] [-json-full] [-drivers] [-high-threshold SCORE] [-medium-threshold SCORE]\n\n", prog);
+  printf("Usage: %s <csv-file> [-limit N] [-min-risk SCORE] [-cohort NAME] [-export PATH] [-summary PATH] [-actions PATH] [-json] [-json-full] [-drivers] [-high-threshold SCORE] [-medium-threshold SCORE] [-perf-counters] [-trace PATH] [-timings PATH] [-reference] [-metrics PATH] [-alloc-stats] [-cache DIR] [-cache-limit MB] [-snapshot PATH] [-query] [-include-ids FILE] [-exclude-ids FILE] [-join PATH:KEY] [-where COLUMN=VALUE] [-group-by COLUMN] [-assign ADVISORS] [-worklist PATH] [-events PATH] [-as-of YYYY-MM-DD] [-threads N] [-changes PATH] [-follow PATH] [-shm NAME] [-export-delta PREV] [-sink URL] [-sink-batch N] [-sink-inflight N] [-sink-retries N] [-serve PORT] [-sample RATE|N] [-confidence LEVEL] [-cohort-stats]\n\n", prog);
+  printf("The input may also be a snapshot written with -snapshot; -query then prints only the action\n");
+  printf("queue and reads just the snapshot chunks that can match -min-risk, -cohort and -limit.\n");
+  printf("-join attaches the columns of a second CSV matched on its KEY column (e.g. an advisor\n");
+  printf("caseload keyed by scholar_id); -where and -group-by then filter and summarize by them.\n");
+  printf("-assign reads advisor,capacity,cohorts rows and assigns scholars at or above -min-risk\n");
+  printf("within capacity (caseload advisor first, if -join has an advisor column); -worklist writes\n");
+  printf("the per-advisor lists.\n");
+  printf("-events recomputes days_inactive, attendance_rate, engagement_score and last_contact_days\n");
+  printf("from a scholar_id,event_type,date log (attended, absent, engaged, contact) before scoring.\n");
+  printf("-changes applies op,scholar_id,... upsert/delete rows to the loaded roster or snapshot,\n");
+  printf("rescoring only the changed scholars; add -snapshot PATH to keep the result. -follow keeps\n");
+  printf("applying a change file (or - for stdin) as lines arrive, printing the live queue, until Ctrl-C.\n");
+  printf("-shm publishes the ranked columns and summaries to a POSIX shared-memory object (e.g. /retention)\n");
+  printf("for readers on the same host, after every batch with -follow.\n");
+  printf("-export-delta writes only the -export rows that changed since the snapshot PREV, with an\n");
+  printf("op column (insert, update, delete); PREV may be the -snapshot PATH this run replaces.\n");
+  printf("-sink POSTs the action queue (at or above -min-risk) to an http:// endpoint as JSON batches of\n");
+  printf("-sink-batch records, at most -sink-inflight at a time, retrying failures up to -sink-retries\n");
+  printf("times with backoff; -follow then sends the scholars each batch changed.\n");
+  printf("-serve answers GET /summary, /cohorts, /actions and /queue?limit=&min_risk=&cohort= as JSON on\n");
+  printf("127.0.0.1:PORT while -follow runs.\n");
+  printf("-sample keeps a random share of the rows (0.01 or 1%%) or a reservoir of N rows while reading and\n");
+  printf("prints tier shares, average risk, risk quantiles and cohort averages with -confidence intervals.\n");
+  printf("-cohort-stats adds the mean, standard deviation and range of every metric per cohort to the\n");
+  printf("report, and each scholar's risk z-score within its cohort to the queue, records and -export.\n\n");
   printf("CSV columns:\n");
   printf("  scholar_id,name,cohort,days_inactive,attendance_rate,engagement_score,gpa,last_contact_days,survey_score,open_flags\n\n");
 }
@@ -236,6 +777,37 @@ int main(int argc, char **argv) {
   int json = 0;
   int json_full = 0;
   int drivers = 0;
+  int perf_counters = 0;
+  const char *trace_out = NULL;
+  const char *timings_path = NULL;
+  int reference = 0;
+  const char *metrics_path = NULL;
+  int alloc_stats = 0;
+  const char *cache_dir = NULL;
+  long long cache_limit_mb = CACHE_DEFAULT_LIMIT_MB;
+  const char *snapshot_path = NULL;
+  int query = 0;
+  const char *include_ids = NULL;
+  const char *exclude_ids = NULL;
+  const char *join_spec = NULL;
+  const char *where = NULL;
+  const char *group_by = NULL;
+  const char *assign_path = NULL;
+  const char *worklist_path = NULL;
+  const char *events_path = NULL;
+  const char *changes_path = NULL;
+  const char *follow_path = NULL;
+  const char *shm_name = NULL;
+  const char *delta_path = NULL;
+  int http_port = -1;
+  int sampling = 0;
+  rw_sample_options sample = {0.0, 0, 0};
+  double confidence = 0.95;
+  int cohort_stats = 0;
+  SinkOptions sink_options = {NULL, SINK_DEFAULT_BATCH, SINK_DEFAULT_IN_FLIGHT, SINK_DEFAULT_RETRIES};
+  rw_events_options events = {NULL, 0};
+  RunCounts run = {0};
+  clock_gettime(CLOCK_MONOTONIC, &run.started);
   const char *cohort_filter = NULL;
   const char *export_path = NULL;
   const char *summary_path = NULL;
@@ -260,6 +832,82 @@ int main(int argc, char **argv) {
       json_full = 1;
     } else if (strcmp(argv[i], "-drivers") == 0) {
       drivers = 1;
+    } else if (strcmp(argv[i], "-perf-counters") == 0) {
+      perf_counters = 1;
+    } else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc) {
+      trace_out = argv[++i];
+    } else if (strcmp(argv[i], "-timings") == 0 && i + 1 < argc) {
+      timings_path = argv[++i];
+    } else if (strcmp(argv[i], "-reference") == 0) {
+      reference = 1;
+    } else if (strcmp(argv[i], "-metrics") == 0 && i + 1 < argc) {
+      metrics_path = argv[++i];
+    } else if (strcmp(argv[i], "-alloc-stats") == 0) {
+      alloc_stats = 1;
+    } else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc) {
+      cache_dir = argv[++i];
+    } else if (strcmp(argv[i], "-cache-limit") == 0 && i + 1 < argc) {
+      cache_limit_mb = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-snapshot") == 0 && i + 1 < argc) {
+      snapshot_path = argv[++i];
+    } else if (strcmp(argv[i], "-query") == 0) {
+      query = 1;
+    } else if (strcmp(argv[i], "-include-ids") == 0 && i + 1 < argc) {
+      include_ids = argv[++i];
+    } else if (strcmp(argv[i], "-exclude-ids") == 0 && i + 1 < argc) {
+      exclude_ids = argv[++i];
+    } else if (strcmp(argv[i], "-join") == 0 && i + 1 < argc) {
+      join_spec = argv[++i];
+    } else if (strcmp(argv[i], "-where") == 0 && i + 1 < argc) {
+      where = argv[++i];
+    } else if (strcmp(argv[i], "-group-by") == 0 && i + 1 < argc) {
+      group_by = argv[++i];
+    } else if (strcmp(argv[i], "-assign") == 0 && i + 1 < argc) {
+      assign_path = argv[++i];
+    } else if (strcmp(argv[i], "-worklist") == 0 && i + 1 < argc) {
+      worklist_path = argv[++i];
+    } else if (strcmp(argv[i], "-events") == 0 && i + 1 < argc) {
+      events_path = argv[++i];
+    } else if (strcmp(argv[i], "-as-of") == 0 && i + 1 < argc) {
+      events.as_of = argv[++i];
+    } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      events.threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-changes") == 0 && i + 1 < argc) {
+      changes_path = argv[++i];
+    } else if (strcmp(argv[i], "-follow") == 0 && i + 1 < argc) {
+      follow_path = argv[++i];
+    } else if (strcmp(argv[i], "-shm") == 0 && i + 1 < argc) {
+      shm_name = argv[++i];
+    } else if (strcmp(argv[i], "-export-delta") == 0 && i + 1 < argc) {
+      delta_path = argv[++i];
+    } else if (strcmp(argv[i], "-sample") == 0 && i + 1 < argc) {
+      sampling = parse_sample(argv[++i], &sample);
+      if (!sampling) {
+        fprintf(stderr, "-sample needs a rate in (0, 1], a percentage, or a reservoir size of at least 1.\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-confidence") == 0 && i + 1 < argc) {
+      confidence = parse_double(argv[++i]);
+      if (!(confidence > 0.0 && confidence < 1.0)) {
+        fprintf(stderr, "-confidence needs a level between 0 and 1 (e.g. 0.95).\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-cohort-stats") == 0) {
+      cohort_stats = 1;
+    } else if (strcmp(argv[i], "-serve") == 0 && i + 1 < argc) {
+      http_port = parse_port(argv[++i]);
+      if (http_port < 0) {
+        fprintf(stderr, "-serve needs a port from 0 to 65535.\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-sink") == 0 && i + 1 < argc) {
+      sink_options.url = argv[++i];
+    } else if (strcmp(argv[i], "-sink-batch") == 0 && i + 1 < argc) {
+      sink_options.batch_size = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-sink-inflight") == 0 && i + 1 < argc) {
+      sink_options.max_in_flight = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-sink-retries") == 0 && i + 1 < argc) {
+      sink_options.max_retries = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-high-threshold") == 0 && i + 1 < argc) {
       high_threshold = parse_double(argv[++i]);
     } else if (strcmp(argv[i], "-medium-threshold") == 0 && i + 1 < argc) {
@@ -274,372 +922,403 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  high_threshold = clamp(high_threshold, 0.0, 100.0);
-  medium_threshold = clamp(medium_threshold, 0.0, 100.0);
-  if (high_threshold <= medium_threshold) {
+  rw_config config;
+  rw_config_init(&config);
+  config.high_threshold = high_threshold;
+  config.medium_threshold = medium_threshold;
+  config.cohort_filter = cohort_filter;
+  rw_engine *engine = rw_engine_new(&config);
+  if (!engine) {
     fprintf(stderr, "Invalid thresholds: high must be greater than medium.\n");
     return 1;
   }
+  rw_get_config(engine, &config);
+  high_threshold = config.high_threshold;
+  medium_threshold = config.medium_threshold;
 
-  FILE *fp = fopen(path, "r");
-  if (!fp) {
-    perror("Failed to open CSV");
-    return 1;
+  if (alloc_stats || perf_counters || timings_path || metrics_path) {
+    rw_stages_open();
+  }
+  if (alloc_stats) {
+    rw_alloc_stats_open(ALLOC_STATS_SUPPORTED);
+  }
+  if (trace_out) {
+    rw_trace_open(trace_out);
+  }
+  if (perf_counters) {
+    rw_perf_counters_open();
   }
 
-  Scholar *scholars = NULL;
-  int count = 0;
-  int capacity = 0;
-  int skipped = 0;
-
-  char *line = NULL;
-  size_t len = 0;
-  ssize_t read;
-  int line_no = 0;
-
-  while ((read = getline(&line, &len, fp)) != -1) {
-    line_no++;
-    if (line_no == 1 && strstr(line, "scholar_id") != NULL) {
-      continue;
+  int rc;
+  const char *id_lists[2] = {include_ids, exclude_ids};
+  for (int mode = RW_IDS_INCLUDE; mode <= RW_IDS_EXCLUDE; mode++) {
+    if (!id_lists[mode]) continue;
+    int id_rc = rw_load_id_filter(engine, id_lists[mode], mode);
+    if (id_rc != RW_OK) {
+      if (id_rc == RW_ERR_IO) perror("Failed to read id list");
+      else fprintf(stderr, "Failed to read id list: %s\n", rw_strerror(id_rc));
+      rw_engine_free(engine);
+      return 1;
     }
+  }
 
-    char *fields[MAX_FIELDS];
-    int field_count = 0;
+  if (http_port >= 0 && !follow_path) {
+    fprintf(stderr, "-serve needs -follow PATH.\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (follow_path && join_spec) {
+    fprintf(stderr, "-follow cannot be combined with -join.\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if ((where || group_by) && !join_spec) {
+    fprintf(stderr, "-where and -group-by need -join PATH:KEY.\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (join_spec && !load_join(engine, join_spec, where, group_by)) {
+    rw_engine_free(engine);
+    return 1;
+  }
 
-    char *cursor = line;
-    while (field_count < MAX_FIELDS) {
-      char *token = strsep(&cursor, ",");
-      if (!token) break;
-      fields[field_count++] = trim(token);
+  if (worklist_path && !assign_path) {
+    fprintf(stderr, "-worklist needs -assign ADVISORS.\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (assign_path) {
+    rc = rw_load_advisors(engine, assign_path);
+    if (rc != RW_OK) {
+      if (rc == RW_ERR_IO) perror("Failed to read advisors");
+      else fprintf(stderr, "Failed to read advisors: %s\n", rw_strerror(rc));
+      rw_engine_free(engine);
+      return 1;
     }
+  }
 
-    if (field_count < 10) {
-      skipped++;
-      continue;
-    }
+  int from_snapshot = rw_is_snapshot(path);
+  if (events_path && from_snapshot) {
+    fprintf(stderr, "-events needs a CSV roster; a snapshot is already scored.\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (query && (changes_path || follow_path || shm_name || sink_options.url)) {
+    fprintf(stderr, "-changes, -follow, -shm and -sink need the whole roster; drop -query.\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (delta_path && (!export_path || query)) {
+    fprintf(stderr, "-export-delta needs -export PATH and the whole roster (no -query).\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (sampling && (from_snapshot || export_path || snapshot_path || summary_path || action_path || json_full ||
+                   changes_path || follow_path || shm_name || sink_options.url || assign_path)) {
+    fprintf(stderr, "-sample reads a CSV and prints estimates only; drop -export, -snapshot, -summary, -actions,\n"
+                    "-json-full, -changes, -follow, -shm, -sink and -assign.\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (sampling && rw_sample_set(engine, &sample) != RW_OK) {
+    fprintf(stderr, "Failed to set up sampling: %s\n", rw_strerror(RW_ERR_NOMEM));
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (query && cohort_stats) {
+    fprintf(stderr, "-cohort-stats needs the whole roster; drop -query.\n");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (query && !from_snapshot) {
+    fprintf(stderr, "-query needs a snapshot input (write one with -snapshot PATH).\n");
+    rw_engine_free(engine);
+    return 1;
+  }
 
-    Scholar s;
-    s.id = strdup(fields[0]);
-    s.name = strdup(fields[1]);
-    s.cohort = strdup(fields[2]);
-    s.days_inactive = parse_double(fields[3]);
-    s.attendance_rate = parse_double(fields[4]);
-    s.engagement_score = parse_double(fields[5]);
-    s.gpa = parse_double(fields[6]);
-    s.last_contact_days = parse_double(fields[7]);
-    s.survey_score = parse_double(fields[8]);
-    s.open_flags = parse_int(fields[9]);
-    s.risk_score = compute_risk(&s);
+  /* A cache hit restores the scored, ranked roster and skips parse, score
+   * and sort; output-only flags do not take part in the key. */
+  uint64_t key = 0;
+  int cached = 0;
+  int keyed = cache_dir && !from_snapshot && !sampling && cache_key(path, &config, &key) == RW_OK;
+  if (keyed && include_ids) keyed = cache_key_add_file(&key, "include-ids", include_ids) == RW_OK;
+  if (keyed && exclude_ids) keyed = cache_key_add_file(&key, "exclude-ids", exclude_ids) == RW_OK;
+  if (keyed && events_path) {
+    char tag[64];
+    snprintf(tag, sizeof(tag), "events %s", events.as_of ? events.as_of : "");
+    keyed = cache_key_add_file(&key, tag, events_path) == RW_OK;
+  }
+  if (keyed) {
+    cached = cache_lookup(engine, cache_dir, key) == RW_OK;
+  }
 
-    if (cohort_filter && strcmp(s.cohort, cohort_filter) != 0) {
-      free(s.id);
-      free(s.name);
-      free(s.cohort);
-      continue;
+  rw_snapshot_stats snapshot_stats = {0, 0, 0};
+  if (from_snapshot) {
+    /* A full read only skips chunks outside -cohort, which is exact; a
+     * query may also drop rows below -min-risk and stop after -limit. */
+    rw_snapshot_filter filter = {-INFINITY, cohort_filter, -1};
+    if (query) {
+      filter.min_risk = min_risk;
+      if (!export_path && !where) filter.limit = limit < 0 ? 0 : limit;
     }
-
-    if (count >= capacity) {
-      capacity = capacity == 0 ? 32 : capacity * 2;
-      scholars = realloc(scholars, sizeof(Scholar) * capacity);
+    rc = rw_snapshot_query(engine, path, &filter, &snapshot_stats);
+    if (rc == RW_ERR_CONFIG) {
+      fprintf(stderr, "Failed to read snapshot: unsupported or damaged file.\n");
+      rw_engine_free(engine);
+      return 1;
     }
-    scholars[count++] = s;
+  } else {
+    rc = cached ? RW_OK : rw_load_csv_file(engine, path);
+  }
+  if (rc == RW_ERR_IO) {
+    perror("Failed to open CSV");
+    rw_engine_free(engine);
+    return 1;
+  }
+  if (rc != RW_OK) {
+    fprintf(stderr, "Failed to load CSV: %s\n", rw_strerror(rc));
+    rw_engine_free(engine);
+    return 1;
   }
 
-  free(line);
-  fclose(fp);
-
-  if (count == 0) {
+  int count = rw_count(engine);
+  if (count == 0 && !query) {
     fprintf(stderr, "No records loaded.\n");
+    rw_engine_free(engine);
     return 1;
   }
 
-  qsort(scholars, count, sizeof(Scholar), compare_risk_desc);
-
-  if (export_path) {
-    FILE *out = fopen(export_path, "w");
-    if (!out) {
-      perror("Failed to write export");
+  if (events_path && !cached) {
+    rw_events_stats event_stats;
+    rc = rw_apply_events(engine, events_path, &events, &event_stats);
+    if (rc != RW_OK) {
+      if (rc == RW_ERR_IO) perror("Failed to read events");
+      else if (rc == RW_ERR_CONFIG) fprintf(stderr, "Invalid -as-of date (expected YYYY-MM-DD).\n");
+      else fprintf(stderr, "Failed to read events: %s\n", rw_strerror(rc));
+      rw_engine_free(engine);
       return 1;
     }
-    if (drivers) {
-      fprintf(out, "scholar_id,name,cohort,risk_score,tier,action,drivers,days_inactive,attendance_rate,engagement_score,gpa,last_contact_days,survey_score,open_flags\n");
-    } else {
-      fprintf(out, "scholar_id,name,cohort,risk_score,tier,action,days_inactive,attendance_rate,engagement_score,gpa,last_contact_days,survey_score,open_flags\n");
+    print_event_stats(&event_stats, events_path);
+  }
+
+  if (!cached && !from_snapshot) {
+    rw_score(engine);
+    if (keyed) {
+      rc = cache_store(engine, cache_dir, key, cache_limit_mb * 1024 * 1024);
+      if (rc != RW_OK) {
+        fprintf(stderr, "Failed to write cache entry: %s\n", rw_strerror(rc));
+      }
+    }
+  }
+
+  /* Changes apply to the cached or snapshot roster, so only the changed
+   * scholars are rescored; -snapshot then rolls the snapshot forward. */
+  if (changes_path) {
+    rw_changes_stats change_stats;
+    rc = rw_apply_changes_file(engine, changes_path, &change_stats);
+    if (rc != RW_OK) {
+      if (rc == RW_ERR_IO) perror("Failed to read changes");
+      else fprintf(stderr, "Failed to apply changes: %s\n", rw_strerror(rc));
+      rw_engine_free(engine);
+      return 1;
     }
-    for (int i = 0; i < count; i++) {
-      Scholar *s = &scholars[i];
-      if (s->risk_score < min_risk) {
-        continue;
+    print_change_stats(&change_stats, changes_path);
+    count = rw_count(engine);
+  }
+  if (follow_path) {
+    Server *server = NULL;
+    if (http_port >= 0) {
+      ServeOptions serve_options = {min_risk, limit, drivers};
+      server = serve_open(http_port, &serve_options);
+      if (!server) {
+        rw_engine_free(engine);
+        return 1;
       }
-      if (drivers) {
-        char driver_text[256];
-        format_drivers(s, driver_text, sizeof(driver_text));
-        fprintf(out,
-                "%s,%s,%s,%.1f,%s,%s,%s,%.1f,%.1f,%.1f,%.2f,%.1f,%.1f,%d\n",
-                s->id, s->name, s->cohort, s->risk_score, risk_tier(s->risk_score, high_threshold, medium_threshold),
-                action_hint(s), driver_text, s->days_inactive, s->attendance_rate, s->engagement_score,
-                s->gpa, s->last_contact_days, s->survey_score, s->open_flags);
-      } else {
-        fprintf(out,
-                "%s,%s,%s,%.1f,%s,%s,%.1f,%.1f,%.1f,%.2f,%.1f,%.1f,%d\n",
-                s->id, s->name, s->cohort, s->risk_score, risk_tier(s->risk_score, high_threshold, medium_threshold),
-                action_hint(s), s->days_inactive, s->attendance_rate, s->engagement_score,
-                s->gpa, s->last_contact_days, s->survey_score, s->open_flags);
+      fprintf(stderr, "Serving /summary, /cohorts, /actions and /queue on http://127.0.0.1:%d/\n", serve_port(server));
+    }
+    /* The sink gets the whole queue once, then what each batch changed. */
+    Sink *sink = NULL;
+    if (sink_options.url) {
+      sink = sink_open(&sink_options);
+      if (!sink) {
+        if (server) close_server(server);
+        rw_engine_free(engine);
+        return 1;
       }
+      sink_push_queue(sink, engine, min_risk, drivers);
     }
-    fclose(out);
-  }
-
-  int high = 0;
-  int medium = 0;
-  int low = 0;
-  double total_risk = 0.0;
-  double avg_risk = 0.0;
-
-  CohortSummary *cohorts = NULL;
-  int cohort_count = 0;
-  ActionSummary *actions = NULL;
-  int action_count = 0;
-
-  for (int i = 0; i < count; i++) {
-    total_risk += scholars[i].risk_score;
-    const char *tier = risk_tier(scholars[i].risk_score, high_threshold, medium_threshold);
-    if (strcmp(tier, "high") == 0) high++;
-    else if (strcmp(tier, "medium") == 0) medium++;
-    else low++;
-
-    CohortSummary *cs = find_or_create_cohort(&cohorts, &cohort_count, scholars[i].cohort);
-    cs->total++;
-    cs->avg_risk += scholars[i].risk_score;
-    if (strcmp(tier, "high") == 0) cs->high++;
-    else if (strcmp(tier, "medium") == 0) cs->medium++;
-    else cs->low++;
-
-    const char *action = action_hint(&scholars[i]);
-    ActionSummary *as = find_or_create_action(&actions, &action_count, action);
-    as->total++;
-    as->avg_risk += scholars[i].risk_score;
-    if (strcmp(tier, "high") == 0) as->high++;
-    else if (strcmp(tier, "medium") == 0) as->medium++;
-    else as->low++;
-  }
-
-  avg_risk = total_risk / (double)count;
-
-  CohortSummary **focus = NULL;
-  int focus_count = cohort_count;
-  if (cohort_count > 0) {
-    focus = malloc(sizeof(CohortSummary *) * cohort_count);
-    for (int i = 0; i < cohort_count; i++) {
-      focus[i] = &cohorts[i];
+    FollowOptions follow = {min_risk, limit, drivers, json, shm_name, sink, server};
+    int followed = follow_changes(engine, follow_path, &follow);
+    if (server) close_server(server);
+    if (sink && !close_sink(sink, sink_options.url)) followed = 0;
+    if (!followed) {
+      rw_engine_free(engine);
+      return 1;
     }
-    qsort(focus, cohort_count, sizeof(CohortSummary *), compare_cohort_avg_desc);
+    count = rw_count(engine);
   }
 
-  ActionSummary **action_focus = NULL;
-  int action_focus_count = action_count;
-  if (action_count > 0) {
-    action_focus = malloc(sizeof(ActionSummary *) * action_count);
-    for (int i = 0; i < action_count; i++) {
-      action_focus[i] = &actions[i];
-    }
-    qsort(action_focus, action_count, sizeof(ActionSummary *), compare_action_avg_desc);
+  /* The cache holds the roster before the join, so a caseload change never
+   * invalidates it; the join is one probe per ranked scholar. */
+  if (join_spec && rw_join_apply(engine) != RW_OK) {
+    fprintf(stderr, "Failed to apply join: %s\n", rw_strerror(RW_ERR_NOMEM));
+    rw_engine_free(engine);
+    return 1;
   }
 
-  if (summary_path) {
-    FILE *summary = fopen(summary_path, "w");
-    if (!summary) {
-      perror("Failed to write summary");
+  if (assign_path) {
+    /* A caseload joined with an advisor column pins scholars to their
+     * advisor while it has room. */
+    const char *caseload = NULL;
+    for (int c = 0; c < rw_join_column_count(engine); c++) {
+      if (strcmp(rw_join_column_name(engine, c), "advisor") == 0) caseload = "advisor";
+    }
+    rc = rw_assign(engine, min_risk, caseload);
+    if (rc != RW_OK) {
+      fprintf(stderr, "Failed to assign advisors: %s\n", rw_strerror(rc));
+      rw_engine_free(engine);
       return 1;
     }
-    fprintf(summary, "cohort,total,avg_risk,high,medium,low\n");
-    for (int i = 0; i < cohort_count; i++) {
-      CohortSummary *cs = &cohorts[i];
-      double avg = cs->avg_risk / (double)cs->total;
-      fprintf(summary, "%s,%d,%.1f,%d,%d,%d\n",
-              cs->name, cs->total, avg, cs->high, cs->medium, cs->low);
+    if (worklist_path && !write_worklist(engine, worklist_path)) {
+      rw_engine_free(engine);
+      return 1;
     }
-    fclose(summary);
   }
 
-  if (action_path) {
-    FILE *action_out = fopen(action_path, "w");
-    if (!action_out) {
-      perror("Failed to write action summary");
+  /* Read before -snapshot, which may overwrite the same file. */
+  rw_engine *previous = NULL;
+  if (delta_path && !(previous = load_previous(delta_path, &config))) {
+    rw_engine_free(engine);
+    return 1;
+  }
+
+  if (snapshot_path) {
+    rc = rw_snapshot_write(engine, snapshot_path, 0);
+    if (rc != RW_OK) {
+      fprintf(stderr, "Failed to write snapshot: %s\n", rw_strerror(rc));
+      rw_engine_free(previous);
+      rw_engine_free(engine);
       return 1;
     }
-    fprintf(action_out, "action,total,avg_risk,high,medium,low\n");
-    for (int i = 0; i < action_count; i++) {
-      ActionSummary *as = &actions[i];
-      double avg = as->avg_risk / (double)as->total;
-      fprintf(action_out, "%s,%d,%.1f,%d,%d,%d\n",
-              as->action, as->total, avg, as->high, as->medium, as->low);
-    }
-    fclose(action_out);
   }
 
-  if (json) {
-    printf("{\n");
-    printf("  \"total\": %d,\n", count);
-    printf("  \"average_risk\": %.1f,\n", avg_risk);
-    printf("  \"risk_thresholds\": {\"high\": %.1f, \"medium\": %.1f},\n", high_threshold, medium_threshold);
-    printf("  \"tiers\": {\n");
-    printf("    \"high\": %d,\n", high);
-    printf("    \"medium\": %d,\n", medium);
-    printf("    \"low\": %d\n", low);
-    printf("  },\n");
-    printf("  \"action_queue_min_risk\": %.1f,\n", min_risk);
-    printf("  \"cohorts\": [\n");
-    for (int i = 0; i < cohort_count; i++) {
-      CohortSummary *cs = &cohorts[i];
-      double avg = cs->avg_risk / (double)cs->total;
-      printf("    {\"cohort\": \"%s\", \"total\": %d, \"avg_risk\": %.1f, \"high\": %d, \"medium\": %d, \"low\": %d}%s\n",
-             cs->name, cs->total, avg, cs->high, cs->medium, cs->low,
-             (i + 1 == cohort_count) ? "" : ",");
-    }
-    printf("  ],\n");
-    printf("  \"cohort_focus\": [\n");
-    int focus_max = focus_count < 3 ? focus_count : 3;
-    for (int i = 0; i < focus_max; i++) {
-      CohortSummary *cs = focus[i];
-      double avg = cs->avg_risk / (double)cs->total;
-      printf("    {\"cohort\": \"%s\", \"avg_risk\": %.1f, \"total\": %d, \"high\": %d, \"medium\": %d, \"low\": %d}%s\n",
-             cs->name, avg, cs->total, cs->high, cs->medium, cs->low,
-             (i + 1 == focus_max) ? "" : ",");
-    }
-    printf("  ],\n");
-    printf("  \"actions\": [\n");
-    for (int i = 0; i < action_count; i++) {
-      ActionSummary *as = &actions[i];
-      double avg = as->avg_risk / (double)as->total;
-      printf("    {\"action\": \"%s\", \"total\": %d, \"avg_risk\": %.1f, \"high\": %d, \"medium\": %d, \"low\": %d}%s\n",
-             as->action, as->total, avg, as->high, as->medium, as->low,
-             (i + 1 == action_count) ? "" : ",");
+  /* The report aggregates anyway; doing it first lets the risk_z column
+   * reuse the cohort moments instead of a pass of its own. */
+  if (export_path && cohort_stats && rw_aggregate(engine) != RW_OK) {
+    fprintf(stderr, "Failed to aggregate: %s\n", rw_strerror(RW_ERR_NOMEM));
+    rw_engine_free(previous);
+    rw_engine_free(engine);
+    return 1;
+  }
+
+  if (export_path) {
+    FILE *out = fopen(export_path, "w");
+    if (!out) {
+      perror("Failed to write export");
+      rw_engine_free(previous);
+      rw_engine_free(engine);
+      return 1;
     }
-    printf("  ],\n");
-    printf("  \"action_queue\": [\n");
-    int printed = 0;
-    for (int i = 0; i < count && printed < limit; i++) {
-      Scholar *s = &scholars[i];
-      if (s->risk_score < min_risk) {
-        continue;
-      }
-      if (printed > 0) {
-        printf(",\n");
+    rw_export_options options = {min_risk, drivers, reference, cohort_stats};
+    if (previous) {
+      rw_delta_stats delta;
+      rc = rw_write_export_delta(engine, previous, out, &options, &delta);
+      rw_engine_free(previous);
+      if (rc != RW_OK) {
+        fprintf(stderr, "Failed to write export delta: %s\n", rw_strerror(rc));
+        fclose(out);
+        rw_engine_free(engine);
+        return 1;
       }
-      if (drivers) {
-        char driver_text[256];
-        format_drivers(s, driver_text, sizeof(driver_text));
-        printf("    {\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\", \"drivers\": \"%s\"}",
-               s->id, s->name, s->cohort, s->risk_score, risk_tier(s->risk_score, high_threshold, medium_threshold), action_hint(s), driver_text);
-      } else {
-        printf("    {\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\"}",
-               s->id, s->name, s->cohort, s->risk_score, risk_tier(s->risk_score, high_threshold, medium_threshold), action_hint(s));
+      fprintf(stderr, "Delta: %d inserted, %d updated, %d deleted, %d unchanged against %s\n", delta.inserted,
+              delta.updated, delta.deleted, delta.unchanged, delta_path);
+    } else {
+      rc = rw_write_export(engine, out, &options);
+      if (rc != RW_OK) {
+        fprintf(stderr, "Failed to write export: %s\n", rw_strerror(rc));
+        fclose(out);
+        rw_engine_free(engine);
+        return 1;
       }
-      printed++;
-    }
-    if (printed > 0) {
-      printf("\n");
     }
-    printf("  ]");
-    if (json_full) {
-      printf(",\n  \"records\": [\n");
-      for (int i = 0; i < count; i++) {
-        Scholar *s = &scholars[i];
-        if (drivers) {
-          char driver_text[256];
-          format_drivers(s, driver_text, sizeof(driver_text));
-          printf("    {\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"days_inactive\": %.1f, \"attendance_rate\": %.1f, \"engagement_score\": %.1f, \"gpa\": %.2f, \"last_contact_days\": %.1f, \"survey_score\": %.1f, \"open_flags\": %d, \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\", \"drivers\": \"%s\"}%s\n",
-                 s->id, s->name, s->cohort, s->days_inactive, s->attendance_rate, s->engagement_score,
-                 s->gpa, s->last_contact_days, s->survey_score, s->open_flags, s->risk_score,
-                 risk_tier(s->risk_score, high_threshold, medium_threshold), action_hint(s), driver_text, (i + 1 == count) ? "" : ",");
-        } else {
-          printf("    {\"scholar_id\": \"%s\", \"name\": \"%s\", \"cohort\": \"%s\", \"days_inactive\": %.1f, \"attendance_rate\": %.1f, \"engagement_score\": %.1f, \"gpa\": %.2f, \"last_contact_days\": %.1f, \"survey_score\": %.1f, \"open_flags\": %d, \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\"}%s\n",
-                 s->id, s->name, s->cohort, s->days_inactive, s->attendance_rate, s->engagement_score,
-                 s->gpa, s->last_contact_days, s->survey_score, s->open_flags, s->risk_score,
-                 risk_tier(s->risk_score, high_threshold, medium_threshold), action_hint(s), (i + 1 == count) ? "" : ",");
-        }
-      }
-      printf("  ]\n");
-    } else {
-      printf("\n");
+    if (fclose(out) != 0) {
+      perror("Failed to write export");
+      rw_engine_free(engine);
+      return 1;
     }
-    printf("}\n");
-  } else {
-    printf("Group Scholar Retention Watch\n\n");
-    printf("Records: %d  Average risk: %.1f  Skipped rows: %d\n", count, avg_risk, skipped);
-    printf("Risk tiers (high >= %.1f, medium >= %.1f): high %d | medium %d | low %d\n\n",
-           high_threshold, medium_threshold, high, medium, low);
+  }
 
-    printf("Cohort summary:\n");
-    for (int i = 0; i < cohort_count; i++) {
-      CohortSummary *cs = &cohorts[i];
-      double avg = cs->avg_risk / (double)cs->total;
-      printf("- %s: total %d, avg risk %.1f, high %d, medium %d, low %d\n",
-             cs->name, cs->total, avg, cs->high, cs->medium, cs->low);
+  rw_totals totals;
+  if (query) {
+    rw_get_totals(engine, &totals);
+    rw_stage_begin(STAGE_REPORT);
+    print_query_report(engine, &snapshot_stats, min_risk, limit, drivers, json);
+  } else {
+    if (rw_aggregate(engine) != RW_OK) {
+      fprintf(stderr, "Failed to aggregate: %s\n", rw_strerror(RW_ERR_NOMEM));
+      rw_engine_free(engine);
+      return 1;
     }
-
-    if (focus_count > 0) {
-      printf("\nCohort focus (top %d by avg risk):\n", focus_count < 3 ? focus_count : 3);
-      int focus_max = focus_count < 3 ? focus_count : 3;
-      for (int i = 0; i < focus_max; i++) {
-        CohortSummary *cs = focus[i];
-        double avg = cs->avg_risk / (double)cs->total;
-        printf("- %s: avg risk %.1f (high %d, medium %d, low %d)\n",
-               cs->name, avg, cs->high, cs->medium, cs->low);
+    if (shm_name) {
+      rc = rw_shm_publish(engine, shm_name);
+      if (rc != RW_OK) {
+        if (rc == RW_ERR_IO) perror("Failed to publish shared memory");
+        else fprintf(stderr, "Failed to publish shared memory: %s\n", rw_strerror(rc));
+        rw_engine_free(engine);
+        return 1;
       }
     }
-
-    if (action_focus_count > 0) {
-      printf("\nAction summary:\n");
-      for (int i = 0; i < action_focus_count; i++) {
-        ActionSummary *as = action_focus[i];
-        double avg = as->avg_risk / (double)as->total;
-        printf("- %s: total %d, avg risk %.1f (high %d, medium %d, low %d)\n",
-               as->action, as->total, avg, as->high, as->medium, as->low);
+    if (sink_options.url && !follow_path) {
+      Sink *sink = sink_open(&sink_options);
+      if (sink) sink_push_queue(sink, engine, min_risk, drivers);
+      if (!sink || !close_sink(sink, sink_options.url)) {
+        rw_engine_free(engine);
+        return 1;
       }
     }
-
-    printf("\nAction queue (top %d, min risk %.1f):\n", limit, min_risk);
-    int printed = 0;
-    for (int i = 0; i < count && printed < limit; i++) {
-      Scholar *s = &scholars[i];
-      if (s->risk_score < min_risk) {
-        continue;
-      }
-      if (drivers) {
-        char driver_text[256];
-        format_drivers(s, driver_text, sizeof(driver_text));
-        printf("%2d. %-14s %-18s cohort %-10s risk %.1f (%s) -> %s | drivers: %s\n",
-               printed + 1, s->id, s->name, s->cohort, s->risk_score, risk_tier(s->risk_score, high_threshold, medium_threshold), action_hint(s),
-               driver_text);
-      } else {
-        printf("%2d. %-14s %-18s cohort %-10s risk %.1f (%s) -> %s\n",
-               printed + 1, s->id, s->name, s->cohort, s->risk_score, risk_tier(s->risk_score, high_threshold, medium_threshold), action_hint(s));
+    if (sampling) {
+      rw_get_totals(engine, &totals);
+      rw_stage_begin(STAGE_REPORT);
+      print_sample_report(engine, &sample, confidence, json);
+    } else {
+      ReportOptions report = {limit, min_risk, high_threshold, medium_threshold, json, json_full, drivers,
+                              summary_path, action_path, group_by, assign_path != NULL, cohort_stats,
+                              follow_path != NULL};
+      rw_stage_begin(STAGE_REPORT);
+      if (!write_report(engine, &report, &totals)) {
+        rw_engine_free(engine);
+        return 1;
       }
-      printed++;
-    }
-    if (printed == 0) {
-      printf("No scholars met the minimum risk threshold.\n");
     }
   }
+  fflush(stdout);
+  rw_stage_end(STAGE_REPORT, count);
 
-  for (int i = 0; i < count; i++) {
-    free(scholars[i].id);
-    free(scholars[i].name);
-    free(scholars[i].cohort);
+  if (timings_path && !write_timings(timings_path)) {
+    rw_engine_free(engine);
+    return 1;
   }
-  free(focus);
-  free(action_focus);
-  for (int i = 0; i < cohort_count; i++) {
-    free(cohorts[i].name);
+  if (metrics_path) {
+    run.rows_read = totals.rows_read;
+    run.skipped = totals.skipped;
+    run.filtered = totals.filtered;
+    run.loaded = totals.loaded;
+    run.high = totals.high;
+    run.medium = totals.medium;
+    run.low = totals.low;
+    if (!write_metrics(metrics_path, &run)) {
+      rw_engine_free(engine);
+      return 1;
+    }
+  }
+  if (perf_counters) {
+    rw_print_perf_report();
+    rw_perf_counters_close();
   }
-  free(cohorts);
-  for (int i = 0; i < action_count; i++) {
-    free(actions[i].action);
+  if (alloc_stats) {
+    rw_print_alloc_report(totals.rows_read);
   }
-  free(actions);
-  free(scholars);
 
+  rw_engine_free(engine);
   return 0;
 }
@@ -0,0 +1,1541 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+#define MAX_FIELDS 16
+#define FAST_FORMAT_LIMIT 1e6
+#define FAST_ROW_TEXT_LIMIT 512
+#define ARENA_MIN_BLOCK 65536
+#define DICT_MIN_CAPACITY 64
+#define DRIVER_MAX 9
+#define ATTENDANCE_DECLINE_WEIGHT 0.3
+#define ENGAGEMENT_DECLINE_WEIGHT 0.2
+
+typedef struct {
+  const char *label;
+  double value;
+} Driver;
+
+static char *trim(char *s) {
+  while (*s && isspace((unsigned char)*s)) s++;
+  if (*s == 0) return s;
+  char *end = s + strlen(s) - 1;
+  while (end > s && isspace((unsigned char)*end)) end--;
+  end[1] = '\0';
+  return s;
+}
+
+static double clamp(double v, double min, double max) {
+  if (v < min) return min;
+  if (v > max) return max;
+  return v;
+}
+
+static double parse_double(const char *s) {
+  if (!s || !*s) return 0.0;
+  return atof(s);
+}
+
+static int parse_int(const char *s) {
+  if (!s || !*s) return 0;
+  return atoi(s);
+}
+
+/* NULL when out of memory. */
+char *rw_arena_strdup(StringArena *arena, const char *s) {
+  size_t n = strlen(s) + 1;
+  ArenaBlock *block = arena->head;
+  if (!block || block->size - block->used < n) {
+    size_t size = arena->next_size < ARENA_MIN_BLOCK ? ARENA_MIN_BLOCK : arena->next_size;
+    while (size < n) size *= 2;
+    block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) return NULL;
+    block->next = arena->head;
+    block->used = 0;
+    block->size = size;
+    arena->head = block;
+    arena->next_size = size * 2;
+  }
+  char *p = block->data + block->used;
+  memcpy(p, s, n);
+  block->used += n;
+  return p;
+}
+
+void rw_arena_free(StringArena *arena) {
+  ArenaBlock *block = arena->head;
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->head = NULL;
+  arena->next_size = 0;
+}
+
+uint64_t rw_hash_string(const char *s) {
+  uint64_t h = 1469598103934665603ULL;
+  while (*s) {
+    h ^= (unsigned char)*s++;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static int dict_grow(StringDict *dict) {
+  int capacity = dict->capacity == 0 ? DICT_MIN_CAPACITY : dict->capacity * 2;
+  char **keys = calloc((size_t)capacity, sizeof(char *));
+  int *ids = malloc(sizeof(int) * capacity);
+  if (!keys || !ids) {
+    free(keys);
+    free(ids);
+    return RW_ERR_NOMEM;
+  }
+  size_t mask = (size_t)capacity - 1;
+  for (int i = 0; i < dict->capacity; i++) {
+    if (!dict->keys[i]) continue;
+    size_t j = rw_hash_string(dict->keys[i]) & mask;
+    while (keys[j]) j = (j + 1) & mask;
+    keys[j] = dict->keys[i];
+    ids[j] = dict->ids[i];
+  }
+  free(dict->keys);
+  free(dict->ids);
+  dict->keys = keys;
+  dict->ids = ids;
+  dict->capacity = capacity;
+  return RW_OK;
+}
+
+/* Returns the id for key, copying it into the arena on first sight. The
+ * interned copy is stored through interned so equal strings share storage.
+ * -1 when out of memory. */
+int rw_dict_intern(StringDict *dict, StringArena *arena, const char *key, char **interned) {
+  if ((dict->count + 1) * 2 > dict->capacity && dict_grow(dict) != RW_OK) return -1;
+  size_t mask = (size_t)dict->capacity - 1;
+  size_t i = rw_hash_string(key) & mask;
+  while (dict->keys[i]) {
+    if (strcmp(dict->keys[i], key) == 0) {
+      *interned = dict->keys[i];
+      return dict->ids[i];
+    }
+    i = (i + 1) & mask;
+  }
+  char *copy = rw_arena_strdup(arena, key);
+  if (!copy) return -1;
+  dict->keys[i] = copy;
+  dict->ids[i] = dict->count++;
+  *interned = dict->keys[i];
+  return dict->ids[i];
+}
+
+int rw_dict_find(const StringDict *dict, const char *key) {
+  if (dict->capacity == 0) return -1;
+  size_t mask = (size_t)dict->capacity - 1;
+  size_t i = rw_hash_string(key) & mask;
+  while (dict->keys[i]) {
+    if (strcmp(dict->keys[i], key) == 0) return dict->ids[i];
+    i = (i + 1) & mask;
+  }
+  return -1;
+}
+
+void rw_dict_free(StringDict *dict) {
+  free(dict->keys);
+  free(dict->ids);
+  dict->keys = NULL;
+  dict->ids = NULL;
+  dict->capacity = 0;
+  dict->count = 0;
+}
+
+/* Points for a fall from the 30-day to the 7-day window; rising or
+ * unknown (NaN) trends add nothing. */
+static double decline(float trend, double weight) {
+  return trend < 0.0f ? -(double)trend * weight : 0.0;
+}
+
+double rw_compute_risk(const Scholar *s) {
+  double gpa_gap = clamp(4.0 - s->gpa, 0.0, 4.0);
+  double attendance_gap = clamp(100.0 - s->attendance_rate, 0.0, 100.0);
+  double engagement_gap = clamp(100.0 - s->engagement_score, 0.0, 100.0);
+  double survey_gap = clamp(100.0 - s->survey_score, 0.0, 100.0);
+
+  double score = 0.0;
+  score += s->days_inactive * 0.6;
+  score += s->last_contact_days * 0.4;
+  score += attendance_gap * 0.35;
+  score += engagement_gap * 0.25;
+  score += gpa_gap * 12.5;
+  score += survey_gap * 0.15;
+  score += s->open_flags * 6.0;
+  score += decline(s->attendance_trend, ATTENDANCE_DECLINE_WEIGHT);
+  score += decline(s->engagement_trend, ENGAGEMENT_DECLINE_WEIGHT);
+  return clamp(score, 0.0, 100.0);
+}
+
+static int compare_driver_desc(const void *a, const void *b) {
+  const Driver *da = (const Driver *)a;
+  const Driver *db = (const Driver *)b;
+  if (da->value < db->value) return 1;
+  if (da->value > db->value) return -1;
+  return 0;
+}
+
+static int collect_drivers(const Scholar *s, Driver *drivers) {
+  int count = 0;
+
+  double gpa_gap = clamp(4.0 - s->gpa, 0.0, 4.0);
+  double attendance_gap = clamp(100.0 - s->attendance_rate, 0.0, 100.0);
+  double engagement_gap = clamp(100.0 - s->engagement_score, 0.0, 100.0);
+  double survey_gap = clamp(100.0 - s->survey_score, 0.0, 100.0);
+
+  double inactivity = s->days_inactive * 0.6;
+  double contact_gap = s->last_contact_days * 0.4;
+  double attendance = attendance_gap * 0.35;
+  double engagement = engagement_gap * 0.25;
+  double gpa = gpa_gap * 12.5;
+  double survey = survey_gap * 0.15;
+  double flags = s->open_flags * 6.0;
+  double attendance_trend = decline(s->attendance_trend, ATTENDANCE_DECLINE_WEIGHT);
+  double engagement_trend = decline(s->engagement_trend, ENGAGEMENT_DECLINE_WEIGHT);
+
+  if (inactivity > 0.1) drivers[count++] = (Driver){"inactivity", inactivity};
+  if (contact_gap > 0.1) drivers[count++] = (Driver){"contact gap", contact_gap};
+  if (attendance > 0.1) drivers[count++] = (Driver){"attendance", attendance};
+  if (engagement > 0.1) drivers[count++] = (Driver){"engagement", engagement};
+  if (gpa > 0.1) drivers[count++] = (Driver){"gpa", gpa};
+  if (survey > 0.1) drivers[count++] = (Driver){"survey", survey};
+  if (flags > 0.1) drivers[count++] = (Driver){"open flags", flags};
+  if (attendance_trend > 0.1) drivers[count++] = (Driver){"attendance trend", attendance_trend};
+  if (engagement_trend > 0.1) drivers[count++] = (Driver){"engagement trend", engagement_trend};
+  return count;
+}
+
+static void format_drivers(const Scholar *s, char *buffer, size_t size) {
+  Driver drivers[DRIVER_MAX];
+  int count = collect_drivers(s, drivers);
+
+  if (count == 0) {
+    snprintf(buffer, size, "stable");
+    return;
+  }
+
+  qsort(drivers, count, sizeof(Driver), compare_driver_desc);
+
+  buffer[0] = '\0';
+  int max = count < 3 ? count : 3;
+  for (int i = 0; i < max; i++) {
+    char chunk[64];
+    snprintf(chunk, sizeof(chunk), "%s %.1f", drivers[i].label, drivers[i].value);
+    if (i > 0) {
+      strncat(buffer, "; ", size - strlen(buffer) - 1);
+    }
+    strncat(buffer, chunk, size - strlen(buffer) - 1);
+  }
+}
+
+/* Formats v exactly like printf("%.1f") / printf("%.2f") for decimals 1 or
+ * 2. Callers guarantee |v| < FAST_FORMAT_LIMIT; values that land within
+ * rounding noise of a tie defer to snprintf so output stays byte-identical. */
+static int format_fixed(char *out, double v, int decimals) {
+  static const long long scales[] = {1, 10, 100};
+  long long scale = scales[decimals];
+  int neg = signbit(v) != 0;
+  double scaled = (neg ? -v : v) * (double)scale;
+  long long units = (long long)scaled;
+  double frac = scaled - (double)units;
+  if (frac > 0.5 - 1e-6 && frac < 0.5 + 1e-6) {
+    return snprintf(out, 32, "%.*f", decimals, v);
+  }
+  if (frac > 0.5) units++;
+
+  char digits[24];
+  int n = 0;
+  long long whole = units / scale;
+  long long part = units % scale;
+  for (int i = 0; i < decimals; i++) {
+    digits[n++] = (char)('0' + part % 10);
+    part /= 10;
+  }
+  digits[n++] = '.';
+  do {
+    digits[n++] = (char)('0' + whole % 10);
+    whole /= 10;
+  } while (whole > 0);
+  if (neg) digits[n++] = '-';
+
+  for (int i = 0; i < n; i++) {
+    out[i] = digits[n - 1 - i];
+  }
+  out[n] = '\0';
+  return n;
+}
+
+static int fast_format_ok(double v) {
+  return v > -FAST_FORMAT_LIMIT && v < FAST_FORMAT_LIMIT;
+}
+
+static char *append_text(char *p, const char *text) {
+  size_t n = strlen(text);
+  memcpy(p, text, n);
+  return p + n;
+}
+
+/* Same output as format_drivers: insertion sort (stable, like the reference
+ * qsort on these tiny arrays) and format_fixed instead of snprintf. */
+static void format_drivers_fast(const Scholar *s, char *buffer, size_t size) {
+  Driver drivers[DRIVER_MAX];
+  int count = collect_drivers(s, drivers);
+  for (int i = 0; i < count; i++) {
+    if (!fast_format_ok(drivers[i].value)) {
+      format_drivers(s, buffer, size);
+      return;
+    }
+  }
+  if (count == 0) {
+    snprintf(buffer, size, "stable");
+    return;
+  }
+
+  for (int i = 1; i < count; i++) {
+    Driver key = drivers[i];
+    int j = i - 1;
+    while (j >= 0 && compare_driver_desc(&drivers[j], &key) > 0) {
+      drivers[j + 1] = drivers[j];
+      j--;
+    }
+    drivers[j + 1] = key;
+  }
+
+  char *p = buffer;
+  int max = count < 3 ? count : 3;
+  for (int i = 0; i < max; i++) {
+    if (i > 0) p = append_text(p, "; ");
+    p = append_text(p, drivers[i].label);
+    *p++ = ' ';
+    p += format_fixed(p, drivers[i].value, 1);
+  }
+  *p = '\0';
+}
+
+static const char *tier_names[RW_TIER_COUNT] = {"high", "medium", "low"};
+
+static const char *action_names[RW_ACTION_COUNT] = {
+  "re-engage outreach", "attendance support", "academic support",
+  "resolve open flags", "engagement nudge", "lightweight check-in"
+};
+
+int rw_tier_code(double score, double high_threshold, double medium_threshold) {
+  if (score >= high_threshold) return 0;
+  if (score >= medium_threshold) return 1;
+  return 2;
+}
+
+const char *rw_risk_tier(double score, double high_threshold, double medium_threshold) {
+  return tier_names[rw_tier_code(score, high_threshold, medium_threshold)];
+}
+
+int rw_action_code(const Scholar *s) {
+  if (s->days_inactive >= 30.0) return 0;
+  if (s->attendance_rate < 70.0) return 1;
+  if (s->gpa < 2.5) return 2;
+  if (s->open_flags > 0) return 3;
+  if (s->engagement_score < 60.0) return 4;
+  return 5;
+}
+
+const char *rw_action_hint(const Scholar *s) {
+  return action_names[rw_action_code(s)];
+}
+
+static char *append_int(char *p, int v) {
+  char digits[12];
+  int n = 0;
+  unsigned int u = v < 0 ? 0u - (unsigned int)v : (unsigned int)v;
+  do {
+    digits[n++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u > 0);
+  if (v < 0) *p++ = '-';
+  while (n > 0) *p++ = digits[--n];
+  return p;
+}
+
+/* Fast path for one -export CSV row. Returns the bytes written, or 0 when
+ * the row has to go through the reference fprintf (long text fields, huge
+ * or non-finite numbers). */
+static int write_export_row_fast(FILE *out, const Scholar *s, const char *tier, int drivers, const double *z,
+                                  char *const *joined, int joined_count) {
+  const double values[] = {s->days_inactive, s->attendance_rate, s->engagement_score,
+                           s->gpa, s->last_contact_days, s->survey_score};
+  const int decimals[] = {1, 1, 1, 2, 1, 1};
+  if (!fast_format_ok(s->risk_score)) return 0;
+  for (int i = 0; i < 6; i++) {
+    if (!fast_format_ok(values[i])) return 0;
+  }
+  if (z && !fast_format_ok(*z)) return 0;
+  size_t text = strlen(s->id) + strlen(s->name) + strlen(s->cohort);
+  for (int i = 0; joined && i < joined_count; i++) text += strlen(joined[i]);
+  if (text + (size_t)joined_count > FAST_ROW_TEXT_LIMIT) return 0;
+
+  char row[FAST_ROW_TEXT_LIMIT + 512];
+  char *p = row;
+  p = append_text(p, s->id);
+  *p++ = ',';
+  p = append_text(p, s->name);
+  *p++ = ',';
+  p = append_text(p, s->cohort);
+  *p++ = ',';
+  p += format_fixed(p, s->risk_score, 1);
+  *p++ = ',';
+  p = append_text(p, tier);
+  *p++ = ',';
+  p = append_text(p, rw_action_hint(s));
+  *p++ = ',';
+  if (drivers) {
+    format_drivers_fast(s, p, 256);
+    p += strlen(p);
+    *p++ = ',';
+  }
+  for (int i = 0; i < 6; i++) {
+    p += format_fixed(p, values[i], decimals[i]);
+    *p++ = ',';
+  }
+  p = append_int(p, s->open_flags);
+  if (z) {
+    *p++ = ',';
+    p += format_fixed(p, *z, 2);
+  }
+  for (int i = 0; i < joined_count; i++) {
+    *p++ = ',';
+    if (joined) p = append_text(p, joined[i]);
+  }
+  *p++ = '\n';
+  fwrite(row, 1, (size_t)(p - row), out);
+  return (int)(p - row);
+}
+
+static int compare_risk_desc(const void *a, const void *b) {
+  const Scholar *sa = (const Scholar *)a;
+  const Scholar *sb = (const Scholar *)b;
+  if (sa->risk_score < sb->risk_score) return 1;
+  if (sa->risk_score > sb->risk_score) return -1;
+  return 0;
+}
+
+static int compare_cohort_avg_desc(const void *a, const void *b) {
+  const CohortSummary *ca = *(const CohortSummary **)a;
+  const CohortSummary *cb = *(const CohortSummary **)b;
+  double avg_a = ca->risk_sum / (double)ca->total;
+  double avg_b = cb->risk_sum / (double)cb->total;
+  if (avg_a < avg_b) return 1;
+  if (avg_a > avg_b) return -1;
+  return 0;
+}
+
+static int compare_action_avg_desc(const void *a, const void *b) {
+  const ActionSummary *aa = *(const ActionSummary **)a;
+  const ActionSummary *ab = *(const ActionSummary **)b;
+  double avg_a = aa->risk_sum / (double)aa->total;
+  double avg_b = ab->risk_sum / (double)ab->total;
+  if (avg_a < avg_b) return 1;
+  if (avg_a > avg_b) return -1;
+  return 0;
+}
+
+/* Cohorts (and -group-by values) are dictionary-encoded, so slots maps an
+ * id straight to its summary. Summaries are still created in
+ * first-appearance order of the sorted roster and borrow the interned name.
+ * NULL when out of memory. */
+static CohortSummary *find_or_create_cohort(CohortSummary **cohorts, int *count, int *capacity, int *slots, int id,
+                                            const char *name) {
+  if (slots[id] >= 0) {
+    return &(*cohorts)[slots[id]];
+  }
+  if (*count >= *capacity) {
+    int grown_capacity = *capacity == 0 ? 8 : *capacity * 2;
+    CohortSummary *grown = realloc(*cohorts, sizeof(CohortSummary) * (size_t)grown_capacity);
+    if (!grown) return NULL;
+    *cohorts = grown;
+    *capacity = grown_capacity;
+  }
+  slots[id] = *count;
+  CohortSummary *cs = &(*cohorts)[*count];
+  cs->name = (char *)name;
+  cs->total = 0;
+  cs->high = 0;
+  cs->medium = 0;
+  cs->low = 0;
+  cs->risk_sum = 0.0;
+  memset(cs->stats, 0, sizeof(cs->stats));
+  (*count)++;
+  return cs;
+}
+
+/* name is one of the static action names, so the summary borrows it. NULL
+ * when out of memory. */
+static ActionSummary *find_or_create_action(ActionSummary **actions, int *count, int *capacity, const char *name) {
+  for (int i = 0; i < *count; i++) {
+    if (strcmp((*actions)[i].action, name) == 0) {
+      return &(*actions)[i];
+    }
+  }
+  if (*count >= *capacity) {
+    int grown_capacity = *capacity == 0 ? 8 : *capacity * 2;
+    ActionSummary *grown = realloc(*actions, sizeof(ActionSummary) * (size_t)grown_capacity);
+    if (!grown) return NULL;
+    *actions = grown;
+    *capacity = grown_capacity;
+  }
+  ActionSummary *as = &(*actions)[*count];
+  as->action = name;
+  as->total = 0;
+  as->high = 0;
+  as->medium = 0;
+  as->low = 0;
+  as->risk_sum = 0.0;
+  (*count)++;
+  return as;
+}
+
+static void clear_aggregates(rw_engine *engine) {
+  free(engine->cohort_focus);
+  free(engine->action_focus);
+  free(engine->cohort_slots);
+  free(engine->cohorts);
+  free(engine->actions);
+  free(engine->groups);
+  free(engine->group_slots);
+  engine->groups = NULL;
+  engine->group_slots = NULL;
+  engine->group_count = 0;
+  engine->group_capacity = 0;
+  engine->cohort_focus = NULL;
+  engine->action_focus = NULL;
+  engine->cohort_slots = NULL;
+  engine->cohorts = NULL;
+  engine->cohort_count = 0;
+  engine->cohort_capacity = 0;
+  engine->actions = NULL;
+  engine->action_count = 0;
+  engine->action_capacity = 0;
+  engine->high = 0;
+  engine->medium = 0;
+  engine->low = 0;
+  engine->total_risk = 0.0;
+  engine->aggregated = 0;
+  engine->moments = 0;
+  engine->bounds_lost = 0;
+}
+
+void rw_invalidate(rw_engine *engine) {
+  rw_live_end(engine);
+  engine->scored = 0;
+  engine->join_applied = 0;
+  engine->assigned = 0;
+  clear_aggregates(engine);
+}
+
+/* Appends s, or with a reservoir sample overwrites the row at slot (a
+ * reservoir left short by malformed rows appends instead). */
+static int append_scholar(rw_engine *engine, const Scholar *s, int slot) {
+  if (slot >= 0 && slot < engine->count) {
+    engine->scholars[slot] = *s;
+    return RW_OK;
+  }
+  if (engine->count >= engine->capacity) {
+    int capacity = engine->capacity == 0 ? 32 : engine->capacity * 2;
+    Scholar *scholars = realloc(engine->scholars, sizeof(Scholar) * capacity);
+    if (!scholars) return RW_ERR_NOMEM;
+    engine->scholars = scholars;
+    engine->capacity = capacity;
+  }
+  engine->scholars[engine->count++] = *s;
+  return RW_OK;
+}
+
+/* Parses one CSV data line in place (the line is modified). */
+static int load_line(rw_engine *engine, char *line) {
+  char *fields[MAX_FIELDS];
+  int field_count = 0;
+
+  engine->rows_read++;
+  /* Without filters every well-formed row is eligible. Counting the commas
+   * is enough to turn away a short row, so the sample is drawn before the
+   * line is even split. */
+  int unfiltered = !engine->cohort_filter && !engine->include_ids && !engine->exclude_ids;
+  int slot = RW_SAMPLE_APPEND;
+  if (engine->sampler && unfiltered) {
+    int separators = 0;
+    for (const char *p = line; *p && separators < 9; p++) separators += *p == ',';
+    if (separators < 9) {
+      engine->skipped++;
+      return RW_OK;
+    }
+    slot = rw_sample_next(engine);
+    if (slot == RW_SAMPLE_DROP) return RW_OK;
+  }
+
+  char *cursor = line;
+  while (field_count < MAX_FIELDS) {
+    char *token = strsep(&cursor, ",");
+    if (!token) break;
+    fields[field_count++] = trim(token);
+  }
+
+  if (field_count < 10) {
+    engine->skipped++;
+    return RW_OK;
+  }
+
+  if (engine->cohort_filter && strcmp(fields[2], engine->cohort_filter) != 0) {
+    engine->filtered++;
+    return RW_OK;
+  }
+
+  if (!rw_id_allowed(engine, fields[0])) {
+    engine->filtered++;
+    return RW_OK;
+  }
+
+  if (engine->sampler && !unfiltered) {
+    slot = rw_sample_next(engine);
+    if (slot == RW_SAMPLE_DROP) return RW_OK;
+  }
+
+  Scholar s;
+  s.id = rw_arena_strdup(&engine->arena, fields[0]);
+  s.name = rw_arena_strdup(&engine->arena, fields[1]);
+  s.cohort_id = rw_dict_intern(&engine->cohort_dict, &engine->arena, fields[2], &s.cohort);
+  if (!s.id || !s.name || s.cohort_id < 0) return RW_ERR_NOMEM;
+  s.days_inactive = parse_double(fields[3]);
+  s.attendance_rate = parse_double(fields[4]);
+  s.engagement_score = parse_double(fields[5]);
+  s.gpa = parse_double(fields[6]);
+  s.last_contact_days = parse_double(fields[7]);
+  s.survey_score = parse_double(fields[8]);
+  s.open_flags = parse_int(fields[9]);
+  s.attendance_trend = NAN;
+  s.engagement_trend = NAN;
+  s.risk_score = 0.0;
+  return append_scholar(engine, &s, slot);
+}
+
+static int is_header(const char *line) {
+  return strstr(line, "scholar_id") != NULL;
+}
+
+int rw_api_version(void) {
+  return RW_API_VERSION;
+}
+
+const char *rw_version(void) {
+  return RW_VERSION;
+}
+
+const char *rw_strerror(int code) {
+  switch (code) {
+    case RW_OK: return "ok";
+    case RW_ERR_IO: return "I/O error";
+    case RW_ERR_NOMEM: return "out of memory";
+    case RW_ERR_RANGE: return "index out of range";
+    case RW_ERR_CONFIG: return "invalid configuration";
+    default: return "unknown error";
+  }
+}
+
+void rw_config_init(rw_config *config) {
+  config->high_threshold = 75.0;
+  config->medium_threshold = 50.0;
+  config->cohort_filter = NULL;
+}
+
+/* Thresholds are clamped to 0-100; returns NULL when high <= medium. */
+rw_engine *rw_engine_new(const rw_config *config) {
+  rw_config defaults;
+  if (!config) {
+    rw_config_init(&defaults);
+    config = &defaults;
+  }
+  double high = clamp(config->high_threshold, 0.0, 100.0);
+  double medium = clamp(config->medium_threshold, 0.0, 100.0);
+  if (high <= medium) return NULL;
+
+  rw_engine *engine = calloc(1, sizeof(rw_engine));
+  if (!engine) return NULL;
+  engine->high_threshold = high;
+  engine->medium_threshold = medium;
+  engine->where_column = -1;
+  if (config->cohort_filter) {
+    engine->cohort_filter = strdup(config->cohort_filter);
+    if (!engine->cohort_filter) {
+      free(engine);
+      return NULL;
+    }
+  }
+  return engine;
+}
+
+void rw_engine_free(rw_engine *engine) {
+  if (!engine) return;
+  clear_aggregates(engine);
+  rw_live_free(engine->live);
+  rw_shm_free(engine->shm);
+  rw_sampler_free(engine->sampler);
+  free(engine->scholars);
+  free(engine->snapshot_data);
+  rw_dict_free(&engine->cohort_dict);
+  rw_arena_free(&engine->arena);
+  free(engine->cohort_filter);
+  if (engine->include_ids) rw_idset_free(engine->include_ids);
+  if (engine->exclude_ids) rw_idset_free(engine->exclude_ids);
+  free(engine->include_ids);
+  free(engine->exclude_ids);
+  if (engine->join) rw_join_free(engine->join);
+  free(engine->join);
+  free(engine->join_rows);
+  free(engine->where_value);
+  if (engine->pool) rw_pool_free(engine->pool);
+  free(engine->pool);
+  free(engine);
+}
+
+void rw_get_config(const rw_engine *engine, rw_config *out) {
+  out->high_threshold = engine->high_threshold;
+  out->medium_threshold = engine->medium_threshold;
+  out->cohort_filter = engine->cohort_filter;
+}
+
+int rw_load_csv_file(rw_engine *engine, const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) {
+    return RW_ERR_IO;
+  }
+  rw_invalidate(engine);
+
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t read;
+  int line_no = 0;
+  int rc = RW_OK;
+
+  rw_stage_begin(STAGE_PARSE);
+  int batch_rows = 0;
+  long batch_bytes = 0;
+  rw_trace_begin("parse batch", "chunk");
+  RW_PROBE2(ingest__batch__start, 0, 0L);
+  while (rc == RW_OK && (read = getline(&line, &len, fp)) != -1) {
+    line_no++;
+    if (batch_rows == BATCH_ROWS) {
+      rw_trace_end("parse batch", "chunk", batch_rows);
+      RW_PROBE2(ingest__batch__done, batch_rows, batch_bytes);
+      rw_trace_begin("parse batch", "chunk");
+      RW_PROBE2(ingest__batch__start, line_no - 1, 0L);
+      batch_rows = 0;
+      batch_bytes = 0;
+    }
+    batch_rows++;
+    batch_bytes += (long)read;
+    if (line_no == 1 && is_header(line)) {
+      continue;
+    }
+    rc = load_line(engine, line);
+  }
+
+  free(line);
+  if (ferror(fp) && rc == RW_OK) rc = RW_ERR_IO;
+  fclose(fp);
+  rw_trace_end("parse batch", "chunk", batch_rows);
+  RW_PROBE2(ingest__batch__done, batch_rows, batch_bytes);
+  rw_stage_end(STAGE_PARSE, line_no);
+  return rc;
+}
+
+int rw_load_csv_buffer(rw_engine *engine, const char *data, size_t size) {
+  rw_invalidate(engine);
+  char *line = NULL;
+  size_t line_capacity = 0;
+  int line_no = 0;
+  int rc = RW_OK;
+  size_t pos = 0;
+
+  rw_stage_begin(STAGE_PARSE);
+  while (rc == RW_OK && pos < size) {
+    const char *start = data + pos;
+    const char *newline = memchr(start, '\n', size - pos);
+    size_t n = newline ? (size_t)(newline - start) + 1 : size - pos;
+    pos += n;
+    line_no++;
+    if (n + 1 > line_capacity) {
+      line_capacity = line_capacity == 0 ? 256 : line_capacity;
+      while (line_capacity < n + 1) line_capacity *= 2;
+      char *grown = realloc(line, line_capacity);
+      if (!grown) {
+        rc = RW_ERR_NOMEM;
+        break;
+      }
+      line = grown;
+    }
+    memcpy(line, start, n);
+    line[n] = '\0';
+    if (line_no == 1 && is_header(line)) {
+      continue;
+    }
+    rc = load_line(engine, line);
+  }
+  free(line);
+  rw_stage_end(STAGE_PARSE, line_no);
+  return rc;
+}
+
+int rw_load_records(rw_engine *engine, const rw_record *records, size_t count) {
+  rw_invalidate(engine);
+  rw_stage_begin(STAGE_PARSE);
+  int rc = RW_OK;
+  for (size_t i = 0; i < count && rc == RW_OK; i++) {
+    const rw_record *r = &records[i];
+    engine->rows_read++;
+    const char *cohort = r->cohort ? r->cohort : "";
+    if (engine->cohort_filter && strcmp(cohort, engine->cohort_filter) != 0) {
+      engine->filtered++;
+      continue;
+    }
+    if (!rw_id_allowed(engine, r->scholar_id ? r->scholar_id : "")) {
+      engine->filtered++;
+      continue;
+    }
+    int slot = engine->sampler ? rw_sample_next(engine) : RW_SAMPLE_APPEND;
+    if (slot == RW_SAMPLE_DROP) continue;
+    Scholar s;
+    s.id = rw_arena_strdup(&engine->arena, r->scholar_id ? r->scholar_id : "");
+    s.name = rw_arena_strdup(&engine->arena, r->name ? r->name : "");
+    s.cohort_id = rw_dict_intern(&engine->cohort_dict, &engine->arena, cohort, &s.cohort);
+    if (!s.id || !s.name || s.cohort_id < 0) {
+      rc = RW_ERR_NOMEM;
+      break;
+    }
+    s.days_inactive = r->days_inactive;
+    s.attendance_rate = r->attendance_rate;
+    s.engagement_score = r->engagement_score;
+    s.gpa = r->gpa;
+    s.last_contact_days = r->last_contact_days;
+    s.survey_score = r->survey_score;
+    s.open_flags = r->open_flags;
+    s.attendance_trend = NAN;
+    s.engagement_trend = NAN;
+    s.risk_score = 0.0;
+    rc = append_scholar(engine, &s, slot);
+  }
+  rw_stage_end(STAGE_PARSE, (long)count);
+  return rc;
+}
+
+/* Scores every loaded scholar and ranks the roster by risk, highest first. */
+int rw_score(rw_engine *engine) {
+  int count = engine->count;
+  rw_live_end(engine);
+  Scholar *scholars = engine->scholars;
+
+  rw_stage_begin(STAGE_SCORE);
+  for (int start = 0; start < count; start += BATCH_ROWS) {
+    int end = count - start < BATCH_ROWS ? count : start + BATCH_ROWS;
+    rw_trace_begin("score batch", "chunk");
+    RW_PROBE2(score__batch__start, start, (long)(end - start) * (long)sizeof(Scholar));
+    for (int i = start; i < end; i++) {
+      scholars[i].risk_score = rw_compute_risk(&scholars[i]);
+    }
+    rw_trace_end("score batch", "chunk", end - start);
+    RW_PROBE2(score__batch__done, end - start, (long)(end - start) * (long)sizeof(Scholar));
+  }
+  rw_stage_end(STAGE_SCORE, count);
+
+  rw_stage_begin(STAGE_SORT);
+  RW_PROBE2(sort__start, count, (long)count * (long)sizeof(Scholar));
+  if (count > 0) {
+    qsort(scholars, count, sizeof(Scholar), compare_risk_desc);
+  }
+  RW_PROBE2(sort__done, count, (long)count * (long)sizeof(Scholar));
+  rw_stage_end(STAGE_SORT, count);
+
+  clear_aggregates(engine);
+  engine->scored = 1;
+  engine->join_applied = 0;
+  engine->assigned = 0;
+  return RW_OK;
+}
+
+static int build_focus(rw_engine *engine) {
+  if (engine->cohort_count > 0) {
+    engine->cohort_focus = malloc(sizeof(CohortSummary *) * engine->cohort_count);
+    if (!engine->cohort_focus) return RW_ERR_NOMEM;
+    for (int i = 0; i < engine->cohort_count; i++) {
+      engine->cohort_focus[i] = &engine->cohorts[i];
+    }
+    qsort(engine->cohort_focus, engine->cohort_count, sizeof(CohortSummary *), compare_cohort_avg_desc);
+  }
+
+  if (engine->action_count > 0) {
+    engine->action_focus = malloc(sizeof(ActionSummary *) * engine->action_count);
+    if (!engine->action_focus) return RW_ERR_NOMEM;
+    for (int i = 0; i < engine->action_count; i++) {
+      engine->action_focus[i] = &engine->actions[i];
+    }
+    qsort(engine->action_focus, engine->action_count, sizeof(ActionSummary *), compare_action_avg_desc);
+  }
+  return RW_OK;
+}
+
+static void adjust_summary(int *total, int *tiers[3], double *risk_sum, int tier, double risk, int sign) {
+  *total += sign;
+  *tiers[tier] += sign;
+  if (sign > 0) *risk_sum += risk;
+  else *risk_sum -= risk;
+}
+
+/* The scholar's cohort summary, or NULL (with nothing counted) when out
+ * of memory. */
+static CohortSummary *aggregate_counts(rw_engine *engine, const Scholar *s, int sign) {
+  CohortSummary *cs = find_or_create_cohort(&engine->cohorts, &engine->cohort_count, &engine->cohort_capacity,
+                                            engine->cohort_slots, s->cohort_id, s->cohort);
+  if (!cs) return NULL;
+  ActionSummary *as = find_or_create_action(&engine->actions, &engine->action_count, &engine->action_capacity,
+                                            rw_action_hint(s));
+  if (!as) return NULL;
+
+  int tier = rw_tier_code(s->risk_score, engine->high_threshold, engine->medium_threshold);
+  int *totals[3] = {&engine->high, &engine->medium, &engine->low};
+  *totals[tier] += sign;
+  if (sign > 0) engine->total_risk += s->risk_score;
+  else engine->total_risk -= s->risk_score;
+
+  int *cohort_tiers[3] = {&cs->high, &cs->medium, &cs->low};
+  adjust_summary(&cs->total, cohort_tiers, &cs->risk_sum, tier, s->risk_score, sign);
+
+  int *action_tiers[3] = {&as->high, &as->medium, &as->low};
+  adjust_summary(&as->total, action_tiers, &as->risk_sum, tier, s->risk_score, sign);
+  return cs;
+}
+
+/* A no-op while the aggregates are current: anything that moves ranks or
+ * scores clears them, and rw_apply_changes keeps them up to date. */
+int rw_aggregate(rw_engine *engine) {
+  if (engine->aggregated) return RW_OK;
+  rw_live_end(engine);
+  if (!engine->scored) {
+    int rc = rw_score(engine);
+    if (rc != RW_OK) return rc;
+  }
+  int rc = rw_join_apply(engine);
+  if (rc != RW_OK) return rc;
+  clear_aggregates(engine);
+
+  rw_stage_begin(STAGE_AGGREGATE);
+  int count = engine->count;
+  int dict_count = engine->cohort_dict.count;
+  engine->cohort_slots = malloc(sizeof(int) * (dict_count > 0 ? dict_count : 1));
+  if (!engine->cohort_slots) return RW_ERR_NOMEM;
+  for (int i = 0; i < dict_count; i++) {
+    engine->cohort_slots[i] = -1;
+  }
+  int grouped = engine->join && engine->join->group_column >= 0;
+  if (grouped) {
+    int group_ids = engine->join->groups.count + 1;
+    engine->group_slots = malloc(sizeof(int) * group_ids);
+    if (!engine->group_slots) return RW_ERR_NOMEM;
+    for (int i = 0; i < group_ids; i++) {
+      engine->group_slots[i] = -1;
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    Scholar *s = &engine->scholars[i];
+    if (!aggregate_counts(engine, s, 1)) return RW_ERR_NOMEM;
+
+    if (grouped) {
+      const char *tier = rw_risk_tier(s->risk_score, engine->high_threshold, engine->medium_threshold);
+      int group = rw_join_group_of(engine, i);
+      if (engine->group_slots[group] < 0 &&
+          !find_or_create_cohort(&engine->groups, &engine->group_count, &engine->group_capacity,
+                                 engine->group_slots, group, rw_join_group_name(engine, group))) {
+        return RW_ERR_NOMEM;
+      }
+      CohortSummary *gs = &engine->groups[engine->group_slots[group]];
+      gs->total++;
+      gs->risk_sum += s->risk_score;
+      if (strcmp(tier, "high") == 0) gs->high++;
+      else if (strcmp(tier, "medium") == 0) gs->medium++;
+      else gs->low++;
+    }
+  }
+
+  /* The cohort moments are left to rw_stats_prepare, which only their
+   * readers call. */
+  rc = build_focus(engine);
+  rw_stage_end(STAGE_AGGREGATE, count);
+  if (rc != RW_OK) return rc;
+
+  engine->aggregated = 1;
+  return RW_OK;
+}
+
+int rw_aggregate_scholar(rw_engine *engine, const Scholar *s, int sign) {
+  CohortSummary *cs = aggregate_counts(engine, s, sign);
+  if (!cs) return RW_ERR_NOMEM;
+  for (int c = 0; engine->moments && c < RW_STAT_COLUMNS; c++) {
+    if (sign > 0) {
+      rw_stats_add(&cs->stats[c], rw_stat_value(s, c));
+      continue;
+    }
+    rw_stats_remove(&cs->stats[c], rw_stat_value(s, c));
+    if (cs->stats[c].count > 0 && (isnan(cs->stats[c].min) || isnan(cs->stats[c].max))) engine->bounds_lost = 1;
+  }
+  return RW_OK;
+}
+
+int rw_aggregate_grow(rw_engine *engine, int old_count) {
+  int dict_count = engine->cohort_dict.count;
+  if (dict_count == old_count) return RW_OK;
+  int *slots = realloc(engine->cohort_slots, sizeof(int) * (size_t)dict_count);
+  if (!slots) return RW_ERR_NOMEM;
+  engine->cohort_slots = slots;
+  for (int i = old_count; i < dict_count; i++) {
+    slots[i] = -1;
+  }
+  return RW_OK;
+}
+
+int rw_aggregate_refresh(rw_engine *engine) {
+  int dict_count = engine->cohort_dict.count;
+  int *slots = realloc(engine->cohort_slots, sizeof(int) * (dict_count > 0 ? dict_count : 1));
+  if (!slots) return RW_ERR_NOMEM;
+  engine->cohort_slots = slots;
+  for (int i = 0; i < dict_count; i++) {
+    slots[i] = -1;
+  }
+  int kept = 0;
+  for (int i = 0; i < engine->cohort_count; i++) {
+    if (engine->cohorts[i].total == 0) continue;
+    engine->cohorts[kept] = engine->cohorts[i];
+    slots[rw_dict_find(&engine->cohort_dict, engine->cohorts[kept].name)] = kept;
+    kept++;
+  }
+  engine->cohort_count = kept;
+  kept = 0;
+  for (int i = 0; i < engine->action_count; i++) {
+    if (engine->actions[i].total == 0) continue;
+    engine->actions[kept++] = engine->actions[i];
+  }
+  engine->action_count = kept;
+  free(engine->cohort_focus);
+  free(engine->action_focus);
+  engine->cohort_focus = NULL;
+  engine->action_focus = NULL;
+  return build_focus(engine);
+}
+
+int rw_count(const rw_engine *engine) {
+  return engine->count;
+}
+
+int rw_count_at_least(const rw_engine *engine, double min_risk) {
+  if (engine->live) return rw_live_count_at_least(engine, min_risk);
+  int low = 0;
+  int high = engine->count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (engine->scholars[mid].risk_score >= min_risk) low = mid + 1;
+    else high = mid;
+  }
+  return low;
+}
+
+/* The scholar at rank, from the index while live. */
+static const Scholar *ranked_scholar(const rw_engine *engine, int rank) {
+  return engine->live ? rw_live_at(engine, rank) : &engine->scholars[rank];
+}
+
+void rw_get_totals(const rw_engine *engine, rw_totals *out) {
+  out->rows_read = engine->rows_read;
+  out->skipped = engine->skipped;
+  out->filtered = engine->filtered;
+  out->loaded = engine->count;
+  out->high = engine->high;
+  out->medium = engine->medium;
+  out->low = engine->low;
+  out->avg_risk = engine->count > 0 ? engine->total_risk / (double)engine->count : 0.0;
+}
+
+static void fill_scholar(const rw_engine *engine, int rank, rw_scholar *out) {
+  const Scholar *s = ranked_scholar(engine, rank);
+  out->rank = rank;
+  out->scholar_id = s->id;
+  out->name = s->name;
+  out->cohort = s->cohort;
+  out->days_inactive = s->days_inactive;
+  out->attendance_rate = s->attendance_rate;
+  out->engagement_score = s->engagement_score;
+  out->gpa = s->gpa;
+  out->last_contact_days = s->last_contact_days;
+  out->survey_score = s->survey_score;
+  out->open_flags = s->open_flags;
+  out->risk = s->risk_score;
+  out->tier = rw_risk_tier(s->risk_score, engine->high_threshold, engine->medium_threshold);
+  out->action = rw_action_hint(s);
+}
+
+int rw_scholar_at(const rw_engine *engine, int rank, rw_scholar *out) {
+  if (rank < 0 || rank >= engine->count) return RW_ERR_RANGE;
+  fill_scholar(engine, rank, out);
+  return RW_OK;
+}
+
+int rw_scholar_find(const rw_engine *engine, const char *id, rw_scholar *out) {
+  if (engine->live) {
+    int slot = rw_live_slot(engine, id);
+    if (slot < 0) return RW_ERR_RANGE;
+    fill_scholar(engine, rw_live_rank(engine, slot), out);
+    return RW_OK;
+  }
+  for (int i = 0; i < engine->count; i++) {
+    if (strcmp(engine->scholars[i].id, id) == 0) {
+      fill_scholar(engine, i, out);
+      return RW_OK;
+    }
+  }
+  return RW_ERR_RANGE;
+}
+
+int rw_drivers_at(const rw_engine *engine, int rank, char *buffer, size_t size) {
+  if (rank < 0 || rank >= engine->count) return RW_ERR_RANGE;
+  format_drivers(ranked_scholar(engine, rank), buffer, size);
+  return RW_OK;
+}
+
+void rw_topk_begin(const rw_engine *engine, double min_risk, int limit, rw_iter *iter) {
+  iter->engine = engine;
+  iter->next = 0;
+  iter->remaining = limit;
+  iter->min_risk = min_risk;
+}
+
+int rw_topk_next(rw_iter *iter, rw_scholar *out) {
+  const rw_engine *engine = iter->engine;
+  while (iter->remaining > 0 && iter->next < engine->count) {
+    int rank = iter->next++;
+    if (ranked_scholar(engine, rank)->risk_score < iter->min_risk) {
+      /* The index is strictly ordered, so nothing further qualifies. */
+      if (engine->live) break;
+      continue;
+    }
+    iter->remaining--;
+    fill_scholar(engine, rank, out);
+    return 1;
+  }
+  return 0;
+}
+
+static void fill_cohort(const CohortSummary *cs, rw_summary *out) {
+  out->name = cs->name;
+  out->total = cs->total;
+  out->high = cs->high;
+  out->medium = cs->medium;
+  out->low = cs->low;
+  out->avg_risk = cs->risk_sum / (double)cs->total;
+}
+
+static void fill_action(const ActionSummary *as, rw_summary *out) {
+  out->name = as->action;
+  out->total = as->total;
+  out->high = as->high;
+  out->medium = as->medium;
+  out->low = as->low;
+  out->avg_risk = as->risk_sum / (double)as->total;
+}
+
+int rw_cohort_count(const rw_engine *engine) {
+  return engine->cohort_count;
+}
+
+int rw_cohort_at(const rw_engine *engine, int index, rw_summary *out) {
+  if (index < 0 || index >= engine->cohort_count) return RW_ERR_RANGE;
+  fill_cohort(&engine->cohorts[index], out);
+  return RW_OK;
+}
+
+int rw_cohort_focus_at(const rw_engine *engine, int index, rw_summary *out) {
+  if (index < 0 || index >= engine->cohort_count) return RW_ERR_RANGE;
+  fill_cohort(engine->cohort_focus[index], out);
+  return RW_OK;
+}
+
+int rw_action_count(const rw_engine *engine) {
+  return engine->action_count;
+}
+
+int rw_action_at(const rw_engine *engine, int index, rw_summary *out) {
+  if (index < 0 || index >= engine->action_count) return RW_ERR_RANGE;
+  fill_action(&engine->actions[index], out);
+  return RW_OK;
+}
+
+int rw_action_focus_at(const rw_engine *engine, int index, rw_summary *out) {
+  if (index < 0 || index >= engine->action_count) return RW_ERR_RANGE;
+  fill_action(engine->action_focus[index], out);
+  return RW_OK;
+}
+
+int rw_group_count(const rw_engine *engine) {
+  return engine->group_count;
+}
+
+int rw_group_at(const rw_engine *engine, int index, rw_summary *out) {
+  if (index < 0 || index >= engine->group_count) return RW_ERR_RANGE;
+  fill_cohort(&engine->groups[index], out);
+  return RW_OK;
+}
+
+const char *rw_tier_name(int code) {
+  return code >= 0 && code < RW_TIER_COUNT ? tier_names[code] : NULL;
+}
+
+const char *rw_action_name(int code) {
+  return code >= 0 && code < RW_ACTION_COUNT ? action_names[code] : NULL;
+}
+
+int rw_column_double(const rw_engine *engine, int column, double *out, size_t n) {
+  if (engine->live) return RW_ERR_CONFIG;
+  int count = engine->count;
+  if (n < (size_t)count) return RW_ERR_RANGE;
+  const Scholar *s = engine->scholars;
+  switch (column) {
+    case RW_COL_DAYS_INACTIVE: for (int i = 0; i < count; i++) out[i] = s[i].days_inactive; break;
+    case RW_COL_ATTENDANCE_RATE: for (int i = 0; i < count; i++) out[i] = s[i].attendance_rate; break;
+    case RW_COL_ENGAGEMENT_SCORE: for (int i = 0; i < count; i++) out[i] = s[i].engagement_score; break;
+    case RW_COL_GPA: for (int i = 0; i < count; i++) out[i] = s[i].gpa; break;
+    case RW_COL_LAST_CONTACT_DAYS: for (int i = 0; i < count; i++) out[i] = s[i].last_contact_days; break;
+    case RW_COL_SURVEY_SCORE: for (int i = 0; i < count; i++) out[i] = s[i].survey_score; break;
+    case RW_COL_RISK: for (int i = 0; i < count; i++) out[i] = s[i].risk_score; break;
+    case RW_COL_ATTENDANCE_TREND: for (int i = 0; i < count; i++) out[i] = s[i].attendance_trend; break;
+    case RW_COL_ENGAGEMENT_TREND: for (int i = 0; i < count; i++) out[i] = s[i].engagement_trend; break;
+    default: return RW_ERR_RANGE;
+  }
+  return RW_OK;
+}
+
+int rw_column_int(const rw_engine *engine, int column, int *out, size_t n) {
+  if (engine->live) return RW_ERR_CONFIG;
+  int count = engine->count;
+  if (n < (size_t)count) return RW_ERR_RANGE;
+  const Scholar *s = engine->scholars;
+  switch (column) {
+    case RW_COL_OPEN_FLAGS: for (int i = 0; i < count; i++) out[i] = s[i].open_flags; break;
+    case RW_COL_COHORT_ID: for (int i = 0; i < count; i++) out[i] = s[i].cohort_id; break;
+    case RW_COL_ACTION: for (int i = 0; i < count; i++) out[i] = rw_action_code(&s[i]); break;
+    case RW_COL_TIER:
+      for (int i = 0; i < count; i++) {
+        out[i] = rw_tier_code(s[i].risk_score, engine->high_threshold, engine->medium_threshold);
+      }
+      break;
+    default: return RW_ERR_RANGE;
+  }
+  return RW_OK;
+}
+
+/* Two-pass friendly: call with offsets/data NULL to size the buffers. */
+long long rw_column_strings(const rw_engine *engine, int column, long long *offsets, char *data, size_t size) {
+  if (engine->live) return RW_ERR_CONFIG;
+  const Scholar *s = engine->scholars;
+  long long total = 0;
+  for (int i = 0; i < engine->count; i++) {
+    const char *value;
+    switch (column) {
+      case RW_COL_SCHOLAR_ID: value = s[i].id; break;
+      case RW_COL_NAME: value = s[i].name; break;
+      case RW_COL_COHORT: value = s[i].cohort; break;
+      default: return RW_ERR_RANGE;
+    }
+    size_t len = strlen(value);
+    if (offsets) offsets[i] = total;
+    if (data && (size_t)total + len <= size) memcpy(data + total, value, len);
+    total += (long long)len;
+  }
+  if (offsets) offsets[engine->count] = total;
+  return total;
+}
+
+int rw_export_buffer(const rw_engine *engine, const rw_export_options *options, char **data, size_t *size) {
+  FILE *out = open_memstream(data, size);
+  if (!out) return RW_ERR_NOMEM;
+  int rc = rw_write_export(engine, out, options);
+  if (fclose(out) != 0 && rc == RW_OK) rc = RW_ERR_NOMEM;
+  return rc;
+}
+
+void rw_buffer_free(char *data) {
+  free(data);
+}
+
+/* Joined columns follow open_flags; unmatched scholars leave them empty. */
+static int export_joined_count(const rw_engine *engine) {
+  return engine->join_applied && engine->join ? engine->join->column_count : 0;
+}
+
+static void write_export_header(const rw_engine *engine, FILE *out, const rw_export_options *options,
+                                const char *prefix) {
+  fputs(prefix, out);
+  if (options->drivers) {
+    fprintf(out, "scholar_id,name,cohort,risk_score,tier,action,drivers,days_inactive,attendance_rate,engagement_score,gpa,last_contact_days,survey_score,open_flags");
+  } else {
+    fprintf(out, "scholar_id,name,cohort,risk_score,tier,action,days_inactive,attendance_rate,engagement_score,gpa,last_contact_days,survey_score,open_flags");
+  }
+  if (options->zscores) fputs(",risk_z", out);
+  for (int c = 0; c < export_joined_count(engine); c++) {
+    fprintf(out, ",%s", engine->join->columns[c]);
+  }
+  fputc('\n', out);
+}
+
+/* Risk moments indexed by cohort id for the risk_z column, or NULL when
+ * the options leave it out (or out of memory, with *rc set). An aggregated
+ * engine already holds them; otherwise they take a pass of their own. */
+static RunningStats *export_risk_stats(const rw_engine *engine, const rw_export_options *options, int *rc) {
+  *rc = RW_OK;
+  if (!options->zscores) return NULL;
+  int ids = engine->cohort_dict.count;
+  RunningStats *stats = calloc((size_t)(ids > 0 ? ids : 1) * (engine->aggregated ? 1 : RW_STAT_COLUMNS),
+                               sizeof(RunningStats));
+  if (!stats) {
+    *rc = RW_ERR_NOMEM;
+    return NULL;
+  }
+  if (engine->aggregated) {
+    *rc = rw_stats_prepare(engine, 0);
+    if (*rc != RW_OK) {
+      free(stats);
+      return NULL;
+    }
+    for (int id = 0; id < ids; id++) {
+      int slot = engine->cohort_slots[id];
+      if (slot >= 0) stats[id] = engine->cohorts[slot].stats[RW_COL_RISK];
+    }
+    return stats;
+  }
+  *rc = rw_stats_by_cohort(engine, stats);
+  if (*rc != RW_OK) {
+    free(stats);
+    return NULL;
+  }
+  /* Keep the risk column only; id * RW_STAT_COLUMNS never trails id. */
+  for (int id = 0; id < ids; id++) stats[id] = stats[(size_t)id * RW_STAT_COLUMNS + RW_COL_RISK];
+  return stats;
+}
+
+/* One export row for the scholar at rank, padded to joined_count joined
+ * columns (an engine without a join leaves them empty). risk_stats comes
+ * from export_risk_stats. Returns the bytes written. */
+static long write_export_row(FILE *out, const rw_engine *engine, int rank, const rw_export_options *options,
+                             int joined_count, const RunningStats *risk_stats) {
+  const Scholar *s = &engine->scholars[rank];
+  double z = 0.0;
+  if (risk_stats) {
+    z = rw_stats_zscore(&risk_stats[s->cohort_id], s->risk_score);
+  }
+  const char *tier = rw_risk_tier(s->risk_score, engine->high_threshold, engine->medium_threshold);
+  char *const *joined = NULL;
+  if (export_joined_count(engine) > 0 && engine->join_rows[rank] >= 0) {
+    joined = engine->join->values + (size_t)engine->join_rows[rank] * (size_t)joined_count;
+  }
+  int drivers = options->drivers;
+  int written = options->reference ? 0
+                                    : write_export_row_fast(out, s, tier, drivers, risk_stats ? &z : NULL, joined,
+                                                            joined_count);
+  if (written > 0) return written;
+
+  long bytes;
+  if (drivers) {
+    char driver_text[256];
+    format_drivers(s, driver_text, sizeof(driver_text));
+    bytes = fprintf(out,
+            "%s,%s,%s,%.1f,%s,%s,%s,%.1f,%.1f,%.1f,%.2f,%.1f,%.1f,%d",
+            s->id, s->name, s->cohort, s->risk_score, tier,
+            rw_action_hint(s), driver_text, s->days_inactive, s->attendance_rate, s->engagement_score,
+            s->gpa, s->last_contact_days, s->survey_score, s->open_flags);
+  } else {
+    bytes = fprintf(out,
+            "%s,%s,%s,%.1f,%s,%s,%.1f,%.1f,%.1f,%.2f,%.1f,%.1f,%d",
+            s->id, s->name, s->cohort, s->risk_score, tier,
+            rw_action_hint(s), s->days_inactive, s->attendance_rate, s->engagement_score,
+            s->gpa, s->last_contact_days, s->survey_score, s->open_flags);
+  }
+  if (risk_stats) bytes += fprintf(out, ",%.2f", z);
+  for (int c = 0; c < joined_count; c++) {
+    bytes += fprintf(out, ",%s", joined ? joined[c] : "");
+  }
+  fputc('\n', out);
+  return bytes + 1;
+}
+
+int rw_write_export(const rw_engine *engine, FILE *out, const rw_export_options *options) {
+  if (engine->live) return RW_ERR_CONFIG;
+  int count = engine->count;
+  int joined_count = export_joined_count(engine);
+  int rc;
+  RunningStats *risk_stats = export_risk_stats(engine, options, &rc);
+  if (rc != RW_OK) return rc;
+
+  rw_stage_begin(STAGE_EXPORT);
+  write_export_header(engine, out, options, "");
+  int emitted = 0;
+  long emitted_bytes = 0;
+  for (int i = 0; i < count; i++) {
+    if (i % BATCH_ROWS == 0) {
+      if (i > 0) {
+        rw_trace_end("export batch", "chunk", emitted);
+        RW_PROBE2(emit__batch__done, emitted, emitted_bytes);
+      }
+      rw_trace_begin("export batch", "chunk");
+      RW_PROBE2(emit__batch__start, i, 0L);
+      emitted = 0;
+      emitted_bytes = 0;
+    }
+    if (engine->scholars[i].risk_score < options->min_risk) {
+      continue;
+    }
+    emitted++;
+    emitted_bytes += write_export_row(out, engine, i, options, joined_count, risk_stats);
+  }
+  rw_trace_end("export batch", "chunk", emitted);
+  RW_PROBE2(emit__batch__done, emitted, emitted_bytes);
+  rw_stage_end(STAGE_EXPORT, count);
+  free(risk_stats);
+  return ferror(out) ? RW_ERR_IO : RW_OK;
+}
+
+static void format_risk(char *out, double risk) {
+  if (fast_format_ok(risk)) format_fixed(out, risk, 1);
+  else snprintf(out, 32, "%.1f", risk);
+}
+
+/* 1 when the exported risk, tier, action or (when exported) drivers of a
+ * scholar differ between the two runs. Both tiers use the current
+ * thresholds. */
+static int export_differs(const rw_engine *engine, const Scholar *now, const Scholar *before, int drivers) {
+  char risk_now[32];
+  char risk_before[32];
+  format_risk(risk_now, now->risk_score);
+  format_risk(risk_before, before->risk_score);
+  if (strcmp(risk_now, risk_before) != 0) return 1;
+  if (rw_tier_code(now->risk_score, engine->high_threshold, engine->medium_threshold) !=
+      rw_tier_code(before->risk_score, engine->high_threshold, engine->medium_threshold)) {
+    return 1;
+  }
+  if (rw_action_code(now) != rw_action_code(before)) return 1;
+  if (!drivers) return 0;
+  char drivers_now[256];
+  char drivers_before[256];
+  format_drivers_fast(now, drivers_now, sizeof(drivers_now));
+  format_drivers_fast(before, drivers_before, sizeof(drivers_before));
+  return strcmp(drivers_now, drivers_before) != 0;
+}
+
+int rw_write_export_delta(const rw_engine *engine, const rw_engine *previous, FILE *out,
+                          const rw_export_options *options, rw_delta_stats *stats) {
+  if (engine->live || previous->live) return RW_ERR_CONFIG;
+  memset(stats, 0, sizeof(*stats));
+  int count = engine->count;
+  int previous_count = previous->count;
+  int joined_count = export_joined_count(engine);
+  /* Each side's risk_z is against its own cohorts; a shift in z alone does
+   * not make a row an update. */
+  int rc;
+  RunningStats *risk_stats = export_risk_stats(engine, options, &rc);
+  if (rc != RW_OK) return rc;
+  RunningStats *previous_stats = export_risk_stats(previous, options, &rc);
+  if (rc != RW_OK) {
+    free(risk_stats);
+    return rc;
+  }
+
+  /* Build side: the previous roster's ids (the last row wins for a
+   * repeated id); each current scholar then probes once. */
+  rw_stage_begin(STAGE_EXPORT);
+  rw_trace_begin("delta build", "delta");
+  StringDict ids = {0};
+  StringArena arena = {0};
+  int *rank_of = malloc(sizeof(int) * (size_t)(previous_count > 0 ? previous_count : 1));
+  unsigned char *matched = calloc((size_t)(previous_count > 0 ? previous_count : 1), 1);
+  int built = rank_of && matched;
+  for (int i = 0; built && i < previous_count; i++) {
+    char *interned;
+    int id_index = rw_dict_intern(&ids, &arena, previous->scholars[i].id, &interned);
+    if (id_index < 0) built = 0;
+    else rank_of[id_index] = i;
+  }
+  if (!built) {
+    free(rank_of);
+    free(matched);
+    free(risk_stats);
+    free(previous_stats);
+    rw_dict_free(&ids);
+    rw_arena_free(&arena);
+    rw_trace_end("delta build", "delta", 0);
+    rw_stage_end(STAGE_EXPORT, 0);
+    return RW_ERR_NOMEM;
+  }
+  rw_trace_end("delta build", "delta", previous_count);
+
+  rw_trace_begin("delta probe", "delta");
+  write_export_header(engine, out, options, "op,");
+  for (int i = 0; i < count; i++) {
+    const Scholar *s = &engine->scholars[i];
+    int in_view = s->risk_score >= options->min_risk;
+    int id_index = rw_dict_find(&ids, s->id);
+    const Scholar *before = NULL;
+    if (id_index >= 0) {
+      /* 1: still exported, 2: matched but now below min_risk. */
+      matched[rank_of[id_index]] = in_view ? 1 : 2;
+      before = &previous->scholars[rank_of[id_index]];
+      if (before->risk_score < options->min_risk) before = NULL;
+    }
+    if (!in_view) continue;
+    if (!before) {
+      fputs("insert,", out);
+      stats->inserted++;
+    } else if (export_differs(engine, s, before, options->drivers)) {
+      fputs("update,", out);
+      stats->updated++;
+    } else {
+      stats->unchanged++;
+      continue;
+    }
+    write_export_row(out, engine, i, options, joined_count, risk_stats);
+  }
+  /* Deletes carry the previous row, and cover scholars who fell below
+   * min_risk as well as those who left the roster. */
+  for (int i = 0; i < previous_count; i++) {
+    const Scholar *before = &previous->scholars[i];
+    if (matched[i] == 1 || before->risk_score < options->min_risk) continue;
+    if (rank_of[rw_dict_find(&ids, before->id)] != i) continue;
+    fputs("delete,", out);
+    stats->deleted++;
+    write_export_row(out, previous, i, options, joined_count, previous_stats);
+  }
+  rw_trace_end("delta probe", "delta", count);
+
+  free(rank_of);
+  free(matched);
+  free(risk_stats);
+  free(previous_stats);
+  rw_dict_free(&ids);
+  rw_arena_free(&arena);
+  rw_stage_end(STAGE_EXPORT, count);
+  return ferror(out) ? RW_ERR_IO : RW_OK;
+}
@@ -0,0 +1,537 @@
+#ifndef RETENTION_H
+#define RETENTION_H
+
+/* libretention: the Retention Watch scoring engine as an embeddable C
+ * library. Load one or more batches, score (which also ranks by risk),
+ * aggregate, then read scholars, top-K and cohort/action summaries.
+ *
+ * The API is versioned by RW_API_VERSION; structs passed in are only ever
+ * extended at the end, and engines are opaque. Strings returned through
+ * rw_scholar and rw_summary are owned by the engine and stay valid until
+ * the next load or rw_engine_free. An engine is not thread-safe; use one
+ * per thread or lock around it. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RW_API_VERSION 2
+#define RW_VERSION "2.0.0"
+
+#if defined(__GNUC__)
+#define RW_API __attribute__((visibility("default")))
+#else
+#define RW_API
+#endif
+
+#define RW_OK 0
+#define RW_ERR_IO -1
+#define RW_ERR_NOMEM -2
+#define RW_ERR_RANGE -3
+#define RW_ERR_CONFIG -4
+
+/* Column ids for the rw_column_* accessors. */
+#define RW_COL_DAYS_INACTIVE 0
+#define RW_COL_ATTENDANCE_RATE 1
+#define RW_COL_ENGAGEMENT_SCORE 2
+#define RW_COL_GPA 3
+#define RW_COL_LAST_CONTACT_DAYS 4
+#define RW_COL_SURVEY_SCORE 5
+#define RW_COL_RISK 6
+#define RW_COL_OPEN_FLAGS 7
+#define RW_COL_TIER 8
+#define RW_COL_ACTION 9
+#define RW_COL_COHORT_ID 10
+#define RW_COL_SCHOLAR_ID 11
+#define RW_COL_NAME 12
+#define RW_COL_COHORT 13
+#define RW_COL_ATTENDANCE_TREND 14
+#define RW_COL_ENGAGEMENT_TREND 15
+/* Columns 0 to RW_STAT_COLUMNS - 1 (the metrics, risk and open_flags)
+ * carry per-cohort statistics. */
+#define RW_STAT_COLUMNS 8
+
+#define RW_IDS_INCLUDE 0
+#define RW_IDS_EXCLUDE 1
+
+#define RW_MATCH_CASELOAD 0
+#define RW_MATCH_COHORT 1
+#define RW_MATCH_ANY 2
+
+#define RW_TIER_COUNT 3
+#define RW_ACTION_COUNT 6
+
+typedef struct rw_engine rw_engine;
+
+typedef struct {
+  double high_threshold;
+  double medium_threshold;
+  /* Only keep scholars in this cohort (NULL keeps all). Copied. */
+  const char *cohort_filter;
+} rw_config;
+
+/* One input row, as in the roster CSV. */
+typedef struct {
+  const char *scholar_id;
+  const char *name;
+  const char *cohort;
+  double days_inactive;
+  double attendance_rate;
+  double engagement_score;
+  double gpa;
+  double last_contact_days;
+  double survey_score;
+  int open_flags;
+} rw_record;
+
+/* A scored scholar; rank 0 is the highest risk. */
+typedef struct {
+  int rank;
+  const char *scholar_id;
+  const char *name;
+  const char *cohort;
+  double days_inactive;
+  double attendance_rate;
+  double engagement_score;
+  double gpa;
+  double last_contact_days;
+  double survey_score;
+  int open_flags;
+  double risk;
+  const char *tier;
+  const char *action;
+} rw_scholar;
+
+/* Cohort or action rollup. */
+typedef struct {
+  const char *name;
+  int total;
+  int high;
+  int medium;
+  int low;
+  double avg_risk;
+} rw_summary;
+
+typedef struct {
+  int rows_read;
+  int skipped;
+  int filtered;
+  int loaded;
+  int high;
+  int medium;
+  int low;
+  double avg_risk;
+} rw_totals;
+
+typedef struct {
+  const char *name;
+  int capacity;
+  int assigned;
+  double avg_risk;
+} rw_advisor;
+
+typedef struct {
+  const rw_engine *engine;
+  int next;
+  int remaining;
+  double min_risk;
+} rw_iter;
+
+typedef struct {
+  double min_risk;
+  int drivers;
+  /* Use the printf/qsort reference formatters instead of the fast path. */
+  int reference;
+  /* Add a risk_z column after open_flags: risk as standard deviations
+   * from the scholar's cohort mean. */
+  int zscores;
+} rw_export_options;
+
+RW_API int rw_api_version(void);
+RW_API const char *rw_version(void);
+RW_API const char *rw_strerror(int code);
+
+RW_API void rw_config_init(rw_config *config);
+RW_API rw_engine *rw_engine_new(const rw_config *config);
+RW_API void rw_engine_free(rw_engine *engine);
+/* The effective (clamped) configuration; cohort_filter is engine-owned. */
+RW_API void rw_get_config(const rw_engine *engine, rw_config *out);
+
+/* Keeps only scholars listed in path (RW_IDS_INCLUDE) or drops them
+ * (RW_IDS_EXCLUDE) at load time, before their strings are copied. One id
+ * per line, first CSV field; applies to loads and snapshot reads after the
+ * call. Loading a list of the same mode again replaces it. */
+RW_API int rw_load_id_filter(rw_engine *engine, const char *path, int mode);
+
+/* Joins a secondary CSV (header row required) on its key column, for
+ * example an advisor caseload keyed by scholar_id. Its other columns are
+ * attached to each scholar by rw_join_apply, which walks the ranked roster
+ * once without re-sorting; exports then carry them as extra columns.
+ * RW_ERR_CONFIG when key is not a column of the file. */
+RW_API int rw_load_join(rw_engine *engine, const char *path, const char *key);
+/* Keeps only scholars whose joined column equals value when the join is
+ * applied (unmatched scholars never pass). RW_ERR_CONFIG for an unknown
+ * column. */
+RW_API int rw_join_where(rw_engine *engine, const char *column, const char *value);
+/* Adds per-value summaries of a joined column to rw_aggregate. */
+RW_API int rw_join_group_by(rw_engine *engine, const char *column);
+/* Needs a scored engine; rw_aggregate applies a loaded join itself. */
+RW_API int rw_join_apply(rw_engine *engine);
+RW_API int rw_join_column_count(const rw_engine *engine);
+RW_API const char *rw_join_column_name(const rw_engine *engine, int column);
+/* The joined value for the scholar at rank, or NULL when unmatched. */
+RW_API const char *rw_join_value(const rw_engine *engine, int rank, int column);
+
+/* Raw event logs: scholar_id,event_type,date rows (date YYYY-MM-DD; a
+ * longer timestamp is cut to its date). Event types: attended, absent,
+ * engaged and contact; others are counted and ignored. */
+typedef struct {
+  /* Day the metrics are measured at, YYYY-MM-DD; NULL for the last day in
+   * the log. Later events are skipped. */
+  const char *as_of;
+  /* Worker threads; 0 picks one per online CPU. */
+  int threads;
+} rw_events_options;
+
+typedef struct {
+  long long events;
+  long long skipped;
+  long long unknown_types;
+  /* Events whose scholar is not in the loaded roster. */
+  long long orphans;
+  int scholars;
+  int matched;
+  int threads;
+  int first_day;
+  int as_of_day;
+} rw_events_stats;
+
+/* Recomputes days_inactive, attendance_rate, engagement_score and
+ * last_contact_days of loaded scholars from an event log, measured at
+ * as_of: days since the last attended/engaged event and since the last
+ * contact (days since the log starts when there is none), the attended
+ * share of attended + absent sessions, and engaged events against a
+ * target of three a week over the log span. Scholars without events keep
+ * their roster values, as does attendance_rate without sessions.
+ *
+ * The same events fill 7- and 30-day windows of attendance and
+ * engagement; their change (7-day minus 30-day, RW_COL_*_TREND) adds a
+ * decline term to the risk score and to the drivers.
+ *
+ * The log is parsed by worker threads into per-thread tables partitioned
+ * by id hash, and each partition is merged by one thread. Invalidates
+ * scoring. */
+RW_API int rw_apply_events(rw_engine *engine, const char *path, const rw_events_options *options,
+                           rw_events_stats *stats);
+
+/* Change streams: CSV rows of op,scholar_id followed by the roster columns
+ * (name,cohort,days_inactive,...,open_flags) for op "upsert"; "delete"
+ * needs only the id. The last row for an id wins. */
+typedef struct {
+  int rows;
+  int updated;
+  int inserted;
+  int deleted;
+  /* Deletes for scholars not in the roster. */
+  int missing;
+  int skipped;
+  /* Rows dropped by the id lists, plus upserts outside -cohort (applied as
+   * deletes). */
+  int filtered;
+  int rescored;
+} rw_changes_stats;
+
+/* Applies a change stream to a scored roster in place: only upserted
+ * scholars are rescored, and they are merged into the ranking without
+ * re-sorting the rest. Current aggregates are adjusted row by row (a
+ * joined roster is joined and aggregated again by rw_aggregate instead).
+ * RW_ERR_CONFIG when the engine is not scored. */
+RW_API int rw_apply_changes_file(rw_engine *engine, const char *path, rw_changes_stats *stats);
+RW_API int rw_apply_changes_buffer(rw_engine *engine, const char *data, size_t size, rw_changes_stats *stats);
+
+/* Live mode for resident processes: the ranking moves into an
+ * order-statistic tree (a treap keyed by risk with subtree sizes), so
+ * each change applied afterwards costs O(log n) and the aggregates stay
+ * current. While live, rank accessors, top-K, counts and summaries work
+ * as usual; exports and column copies fail with RW_ERR_CONFIG until
+ * rw_live_end writes the roster back in rank order (snapshot writes,
+ * joins, assignment and rescoring end live mode themselves). Needs a
+ * scored engine without a join. */
+RW_API int rw_live_begin(rw_engine *engine);
+RW_API int rw_live_end(rw_engine *engine);
+
+/* Sampled ingest for approximate answers on very large inputs. Rows that
+ * pass the cohort and id filters are kept with probability rate
+ * (Bernoulli), or, when size > 0, as a uniform reservoir of size rows
+ * (Algorithm L). Both draw how many rows to skip next, so dropped rows
+ * cost one counter decrement and are never parsed further. The sample is
+ * then scored and aggregated as usual. Set on an empty engine; NULL turns
+ * sampling off. RW_ERR_RANGE for a rate outside (0, 1] or a negative
+ * size. */
+typedef struct {
+  double rate;
+  int size;
+  /* 0 picks a fixed seed, so repeated runs draw the same sample. */
+  uint64_t seed;
+} rw_sample_options;
+
+RW_API int rw_sample_set(rw_engine *engine, const rw_sample_options *options);
+
+/* A point estimate with its confidence interval. */
+typedef struct {
+  double value;
+  double low;
+  double high;
+} rw_estimate;
+
+typedef struct {
+  /* Rows offered to the sampler, and rows kept. */
+  long long population;
+  int sampled;
+  /* Share of scholars per tier (RW_TIER_* order: high, medium, low). */
+  rw_estimate tier_share[RW_TIER_COUNT];
+  rw_estimate average_risk;
+} rw_sample_totals;
+
+/* Estimates for the population from an aggregated engine at a confidence
+ * level in (0, 1), e.g. 0.95. Shares use Wilson score intervals, means a
+ * normal interval, and quantiles the order statistics whose ranks bound
+ * the quantile. All apply the finite population correction, so an
+ * unsampled engine gets zero-width intervals. */
+RW_API int rw_sample_estimate(const rw_engine *engine, double confidence, rw_sample_totals *out);
+/* The cohort's share of scholars and its average risk, for the cohort at
+ * index in rw_cohort_at order. */
+RW_API int rw_sample_cohort_at(const rw_engine *engine, int index, double confidence, rw_estimate *share,
+                               rw_estimate *average_risk);
+/* The q-quantile of risk (0.5 is the median, 0.9 the 90th percentile). */
+RW_API int rw_sample_quantile(const rw_engine *engine, double q, double confidence, rw_estimate *out);
+
+/* Loading appends to the engine and invalidates earlier scoring. */
+RW_API int rw_load_csv_file(rw_engine *engine, const char *path);
+RW_API int rw_load_csv_buffer(rw_engine *engine, const char *data, size_t size);
+RW_API int rw_load_records(rw_engine *engine, const rw_record *records, size_t count);
+
+RW_API int rw_score(rw_engine *engine);
+RW_API int rw_aggregate(rw_engine *engine);
+
+RW_API int rw_count(const rw_engine *engine);
+/* Scholars with risk >= min_risk, by binary search (or the live index). */
+RW_API int rw_count_at_least(const rw_engine *engine, double min_risk);
+RW_API void rw_get_totals(const rw_engine *engine, rw_totals *out);
+RW_API int rw_scholar_at(const rw_engine *engine, int rank, rw_scholar *out);
+/* The scholar with id, by hash in live mode and by scan otherwise;
+ * RW_ERR_RANGE when not in the roster. */
+RW_API int rw_scholar_find(const rw_engine *engine, const char *id, rw_scholar *out);
+RW_API int rw_drivers_at(const rw_engine *engine, int rank, char *buffer, size_t size);
+
+/* Iterates scholars with risk >= min_risk in rank order, at most limit. */
+RW_API void rw_topk_begin(const rw_engine *engine, double min_risk, int limit, rw_iter *iter);
+RW_API int rw_topk_next(rw_iter *iter, rw_scholar *out);
+
+/* Summaries are in first-appearance order of the ranked roster; the focus
+ * variants order them by average risk, highest first. */
+RW_API int rw_cohort_count(const rw_engine *engine);
+RW_API int rw_cohort_at(const rw_engine *engine, int index, rw_summary *out);
+RW_API int rw_cohort_focus_at(const rw_engine *engine, int index, rw_summary *out);
+RW_API int rw_action_count(const rw_engine *engine);
+RW_API int rw_action_at(const rw_engine *engine, int index, rw_summary *out);
+RW_API int rw_action_focus_at(const rw_engine *engine, int index, rw_summary *out);
+/* Summaries per value of the rw_join_group_by column, in first-appearance
+ * order; scholars without a caseload row are grouped as "(unmatched)". */
+RW_API int rw_group_count(const rw_engine *engine);
+RW_API int rw_group_at(const rw_engine *engine, int index, rw_summary *out);
+
+/* Count, mean, population variance and range of one column within a
+ * cohort. Values that are not numbers are left out of all of them. */
+typedef struct {
+  int count;
+  double mean;
+  double variance;
+  double min;
+  double max;
+} rw_stats;
+
+/* Welford moments per cohort for the columns below RW_STAT_COLUMNS. The
+ * first read after rw_aggregate (here, rw_zscore_at, the sample estimates
+ * or a zscores export) computes them in one pass split across threads and
+ * merged, and rw_apply_changes updates them in place after that. index is in rw_cohort_at
+ * order. Deletes that take the last value at a range's end make the next
+ * call rescan the roster once for every cohort. */
+RW_API int rw_cohort_stats_at(const rw_engine *engine, int index, int column, rw_stats *out);
+/* The scholar's risk in standard deviations from the cohort mean: 0 when
+ * the cohort's risk does not vary, NaN when the risk is not a number. */
+RW_API int rw_zscore_at(const rw_engine *engine, int rank, double *out);
+/* Input-file name of a column below RW_STAT_COLUMNS ("risk" for
+ * RW_COL_RISK). */
+RW_API const char *rw_column_name(int column);
+
+/* Columnar copies of the ranked roster for bindings: out needs room for
+ * rw_count() values. Tier and action columns hold codes for rw_tier_name
+ * and rw_action_name. String columns are packed Arrow-style: count + 1
+ * offsets into one byte buffer without terminators; the return value is
+ * the byte size needed (pass NULL buffers to query it). */
+RW_API int rw_column_double(const rw_engine *engine, int column, double *out, size_t n);
+RW_API int rw_column_int(const rw_engine *engine, int column, int *out, size_t n);
+RW_API long long rw_column_strings(const rw_engine *engine, int column, long long *offsets, char *data, size_t size);
+RW_API const char *rw_tier_name(int code);
+RW_API const char *rw_action_name(int code);
+
+/* Loads advisors from a CSV with advisor,capacity[,cohorts] columns; cohorts
+ * is a ';'-separated list of the cohorts the advisor takes (empty for any). */
+RW_API int rw_load_advisors(rw_engine *engine, const char *path);
+/* Assigns scholars with risk >= min_risk greedily in rank order, within
+ * capacity: to the scholar's caseload advisor (the joined caseload_column,
+ * or NULL) if it has room, else to the advisor with the most room among
+ * those taking the scholar's cohort, else among those taking any cohort.
+ * Needs a scored engine; a join is applied first. */
+RW_API int rw_assign(rw_engine *engine, double min_risk, const char *caseload_column);
+RW_API int rw_advisor_count(const rw_engine *engine);
+RW_API int rw_advisor_at(const rw_engine *engine, int index, rw_advisor *out);
+/* The advisor index for the scholar at rank (-1 when unassigned), with the
+ * RW_MATCH_* reason in match when not NULL. */
+RW_API int rw_assignment_at(const rw_engine *engine, int rank, int *match);
+/* Rank of the index-th scholar on an advisor's work list (rank order). */
+RW_API int rw_worklist_at(const rw_engine *engine, int advisor, int index);
+RW_API void rw_assign_totals(const rw_engine *engine, int *considered, int *assigned);
+RW_API const char *rw_match_name(int code);
+
+RW_API int rw_write_export(const rw_engine *engine, FILE *out, const rw_export_options *options);
+
+typedef struct {
+  int inserted;
+  int updated;
+  int deleted;
+  int unchanged;
+} rw_delta_stats;
+
+/* Writes only the export rows that changed since previous (typically the
+ * last run's snapshot), behind an op column of insert, update or delete.
+ * A row is updated when its risk, tier, action or, with drivers, its
+ * drivers text differ as exported; deletes carry the previous row.
+ * min_risk applies to both rosters, so a scholar crossing it is inserted
+ * or deleted. previous is hashed on scholar id and probed once per
+ * scholar. */
+RW_API int rw_write_export_delta(const rw_engine *engine, const rw_engine *previous, FILE *out,
+                                 const rw_export_options *options, rw_delta_stats *stats);
+/* Renders the export CSV into a malloc'd buffer released by rw_buffer_free. */
+RW_API int rw_export_buffer(const rw_engine *engine, const rw_export_options *options, char **data, size_t *size);
+RW_API void rw_buffer_free(char *data);
+
+/* Snapshots persist the scored, ranked roster in a columnar file tagged
+ * with a caller-chosen key. Reading needs an empty engine and fails with
+ * RW_ERR_CONFIG when the file is not a snapshot for that key; the engine
+ * comes back scored, ready for rw_aggregate. */
+RW_API int rw_snapshot_write(rw_engine *engine, const char *path, uint64_t key);
+RW_API int rw_snapshot_read(rw_engine *engine, const char *path, uint64_t key);
+
+/* Snapshots are chunked in rank order with per-chunk min/max risk and a
+ * cohort bitset, so a query only reads chunks that can match: rows with
+ * risk >= min_risk in cohort (NULL for any), stopping after limit rows
+ * (-1 for no limit). Any key is accepted. */
+typedef struct {
+  double min_risk;
+  const char *cohort;
+  int limit;
+} rw_snapshot_filter;
+
+typedef struct {
+  int chunks_total;
+  int chunks_read;
+  int rows_total;
+} rw_snapshot_stats;
+
+RW_API int rw_snapshot_query(rw_engine *engine, const char *path, const rw_snapshot_filter *filter,
+                             rw_snapshot_stats *stats);
+RW_API int rw_is_snapshot(const char *path);
+
+/* Shared-memory publication for readers on the same host. rw_shm_publish
+ * writes the ranked roster columns and the cohort and action summaries
+ * into the POSIX shared-memory object name (for example "/retention"),
+ * which stays mapped in the engine so later publishes rewrite it in place.
+ * Readers map it read-only and use the columns where they lie.
+ *
+ * Layout: an rw_shm_header, then the summaries and columns at the offsets
+ * it records (from the start of the segment, 8-byte aligned). Columns are
+ * indexed by RW_COL_* id in rank order: double for the metric, risk and
+ * trend columns, int32 for open flags, tier and action codes and
+ * RW_COL_COHORT_ID, which holds the index of the scholar's entry in the
+ * cohort summaries. String columns are packed as in rw_column_strings:
+ * count + 1 int64 offsets, then the bytes at data. Summary names are
+ * NUL-terminated strings at name.
+ *
+ * The header's sequence is a seqlock: odd while the writer updates the
+ * segment, bumped to the next even value when done. The segment only
+ * grows, so a reader's mapping never loses pages. rw_shm_read_begin waits
+ * out a writer, remaps after growth and copies a consistent header;
+ * rw_shm_read_end tells whether the data read in between may have been
+ * torn, in which case the reader starts over. */
+#define RW_SHM_MAGIC 0x52575348u
+#define RW_SHM_VERSION 1
+#define RW_SHM_COLUMNS 16
+
+typedef struct {
+  uint64_t offset;
+  uint64_t size;
+  /* String columns only: offset of the packed bytes. */
+  uint64_t data;
+} rw_shm_column;
+
+typedef struct {
+  uint64_t name;
+  int32_t total;
+  int32_t high;
+  int32_t medium;
+  int32_t low;
+  double avg_risk;
+} rw_shm_summary;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t sequence;
+  /* Counts publishes, so a reader can skip an unchanged segment. */
+  uint64_t generation;
+  /* Bytes in use; the mapping may be larger. */
+  uint64_t size;
+  int32_t count;
+  int32_t high;
+  int32_t medium;
+  int32_t low;
+  double avg_risk;
+  double high_threshold;
+  double medium_threshold;
+  int32_t cohort_count;
+  int32_t action_count;
+  /* rw_shm_summary arrays in first-appearance order. */
+  uint64_t cohorts;
+  uint64_t actions;
+  rw_shm_column columns[RW_SHM_COLUMNS];
+} rw_shm_header;
+
+typedef struct {
+  const unsigned char *base;
+  size_t mapped;
+  int fd;
+} rw_shm_view;
+
+/* Aggregates first if needed; works in live mode. RW_ERR_CONFIG when the
+ * engine is not scored, RW_ERR_IO (errno set) when the segment cannot be
+ * created or grown. */
+RW_API int rw_shm_publish(rw_engine *engine, const char *name);
+/* RW_ERR_IO when the segment does not exist, RW_ERR_CONFIG when it is not
+ * a Retention Watch segment of this version. */
+RW_API int rw_shm_open(rw_shm_view *view, const char *name);
+RW_API int rw_shm_read_begin(rw_shm_view *view, rw_shm_header *header);
+/* 1 when nothing was published since the matching rw_shm_read_begin. */
+RW_API int rw_shm_read_end(const rw_shm_view *view, const rw_shm_header *header);
+RW_API void rw_shm_close(rw_shm_view *view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "engine.h"
+
+/* Any fixed default keeps repeated runs on the same sample. */
+#define SAMPLE_SEED 0x5eed5a3b1e55eedull
+#define SAMPLE_SKIP_MAX (1LL << 62)
+
+struct Sampler {
+  double rate;
+  int size;
+  uint64_t state;
+  /* Rows offered so far. */
+  long long seen;
+  /* Bernoulli: rows to drop before the next one kept. Reservoir: the row
+   * that replaces a kept one next, and Algorithm L's running weight. */
+  long long skip;
+  long long next;
+  double weight;
+};
+
+static uint64_t next_random(Sampler *s) {
+  uint64_t z = (s->state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+/* Uniform in (0, 1]. */
+static double uniform(Sampler *s) {
+  return (double)((next_random(s) >> 11) + 1) * 0x1.0p-53;
+}
+
+/* Failures before the next success of a p-coin, drawn in one step. */
+static long long skip_count(Sampler *s, double p) {
+  if (p >= 1.0) return 0;
+  double skip = floor(log(uniform(s)) / log1p(-p));
+  return skip < (double)SAMPLE_SKIP_MAX ? (long long)skip : SAMPLE_SKIP_MAX;
+}
+
+void rw_sampler_free(Sampler *sampler) {
+  free(sampler);
+}
+
+int rw_sample_set(rw_engine *engine, const rw_sample_options *options) {
+  if (!options) {
+    rw_sampler_free(engine->sampler);
+    engine->sampler = NULL;
+    return RW_OK;
+  }
+  if (options->size < 0 || (options->size == 0 && !(options->rate > 0.0 && options->rate <= 1.0))) {
+    return RW_ERR_RANGE;
+  }
+  if (engine->count > 0) return RW_ERR_CONFIG;
+  Sampler *s = calloc(1, sizeof(Sampler));
+  if (!s) return RW_ERR_NOMEM;
+  s->size = options->size;
+  s->rate = s->size > 0 ? 1.0 : options->rate;
+  s->state = options->seed ? options->seed : SAMPLE_SEED;
+  if (s->size == 0) s->skip = skip_count(s, s->rate);
+  rw_sampler_free(engine->sampler);
+  engine->sampler = s;
+  return RW_OK;
+}
+
+int rw_sample_next(rw_engine *engine) {
+  Sampler *s = engine->sampler;
+  long long row = s->seen++;
+  if (s->size == 0) {
+    if (s->skip > 0) {
+      s->skip--;
+      return RW_SAMPLE_DROP;
+    }
+    s->skip = skip_count(s, s->rate);
+    return RW_SAMPLE_APPEND;
+  }
+  /* Algorithm L: fill the reservoir, then jump straight to the next row
+   * that replaces a random one; the jumps grow as the weight shrinks. */
+  if (row < s->size) {
+    if (row == s->size - 1) {
+      s->weight = exp(log(uniform(s)) / s->size);
+      s->next = row + 1 + skip_count(s, s->weight);
+    }
+    return RW_SAMPLE_APPEND;
+  }
+  if (row < s->next) return RW_SAMPLE_DROP;
+  int slot = (int)(next_random(s) % (uint64_t)s->size);
+  s->weight *= exp(log(uniform(s)) / s->size);
+  s->next = row + 1 + skip_count(s, s->weight);
+  return slot;
+}
+
+static double risk_at(const rw_engine *engine, int rank) {
+  return engine->live ? rw_live_at(engine, rank)->risk_score : engine->scholars[rank].risk_score;
+}
+
+static long long population(const rw_engine *engine) {
+  return engine->sampler ? engine->sampler->seen : engine->count;
+}
+
+/* 1 - n/N, the variance left when sampling without replacement; 0 once
+ * the sample is the whole population. */
+static double remaining_fraction(const rw_engine *engine) {
+  long long total = population(engine);
+  if (total <= 0) return 0.0;
+  double f = 1.0 - (double)engine->count / (double)total;
+  return f > 0.0 ? f : 0.0;
+}
+
+/* Two-sided normal critical value, by bisection on erfc. */
+static double critical_value(double confidence) {
+  double low = 0.0;
+  double high = 40.0;
+  for (int i = 0; i < 100; i++) {
+    double mid = 0.5 * (low + high);
+    if (erfc(mid / M_SQRT2) > 1.0 - confidence) low = mid;
+    else high = mid;
+  }
+  return 0.5 * (low + high);
+}
+
+/* Wilson score interval for k of n, on the effective size n / (1 - f). */
+static rw_estimate share_estimate(int k, int n, double z, double remaining) {
+  rw_estimate e;
+  double p = n > 0 ? (double)k / (double)n : 0.0;
+  e.value = p;
+  e.low = p;
+  e.high = p;
+  if (n == 0) {
+    e.low = 0.0;
+    e.high = 1.0;
+  } else if (remaining > 0.0) {
+    double m = (double)n / remaining;
+    double z2 = z * z;
+    double denom = 1.0 + z2 / m;
+    double center = (p + z2 / (2.0 * m)) / denom;
+    double half = z * sqrt(p * (1.0 - p) / m + z2 / (4.0 * m * m)) / denom;
+    e.low = fmax(0.0, center - half);
+    e.high = fmin(1.0, center + half);
+  }
+  return e;
+}
+
+/* Normal interval for a mean risk, kept on the 0-100 scale; fewer than
+ * two scholars bound it by the scale alone. */
+static rw_estimate mean_estimate(double mean, double sum_squares, int n, double z, double remaining) {
+  rw_estimate e;
+  e.value = mean;
+  e.low = mean;
+  e.high = mean;
+  if (remaining <= 0.0) return e;
+  if (n < 2) {
+    e.low = 0.0;
+    e.high = 100.0;
+    return e;
+  }
+  double half = z * sqrt(sum_squares / (double)(n - 1) / (double)n * remaining);
+  e.low = fmax(0.0, mean - half);
+  e.high = fmin(100.0, mean + half);
+  return e;
+}
+
+/* Squared deviations of risk from the mean, merged over the cohorts'
+ * running moments instead of another pass over the sample. */
+static double risk_m2(const rw_engine *engine) {
+  RunningStats all = {0};
+  for (int i = 0; i < engine->cohort_count; i++) rw_stats_merge(&all, &engine->cohorts[i].stats[RW_COL_RISK]);
+  return all.m2;
+}
+
+int rw_sample_estimate(const rw_engine *engine, double confidence, rw_sample_totals *out) {
+  if (!engine->aggregated) return RW_ERR_CONFIG;
+  if (!(confidence > 0.0 && confidence < 1.0)) return RW_ERR_RANGE;
+  int rc = rw_stats_prepare(engine, 0);
+  if (rc != RW_OK) return rc;
+  int n = engine->count;
+  double z = critical_value(confidence);
+  double remaining = remaining_fraction(engine);
+  out->population = population(engine);
+  out->sampled = n;
+  out->tier_share[0] = share_estimate(engine->high, n, z, remaining);
+  out->tier_share[1] = share_estimate(engine->medium, n, z, remaining);
+  out->tier_share[2] = share_estimate(engine->low, n, z, remaining);
+  double mean = n > 0 ? engine->total_risk / (double)n : 0.0;
+  out->average_risk = mean_estimate(mean, risk_m2(engine), n, z, remaining);
+  return RW_OK;
+}
+
+int rw_sample_cohort_at(const rw_engine *engine, int index, double confidence, rw_estimate *share,
+                        rw_estimate *average_risk) {
+  if (!engine->aggregated) return RW_ERR_CONFIG;
+  if (index < 0 || index >= engine->cohort_count || !(confidence > 0.0 && confidence < 1.0)) return RW_ERR_RANGE;
+  int rc = rw_stats_prepare(engine, 0);
+  if (rc != RW_OK) return rc;
+  const CohortSummary *cs = &engine->cohorts[index];
+  double z = critical_value(confidence);
+  double remaining = remaining_fraction(engine);
+  double mean = cs->total > 0 ? cs->risk_sum / (double)cs->total : 0.0;
+  if (share) *share = share_estimate(cs->total, engine->count, z, remaining);
+  if (average_risk) *average_risk = mean_estimate(mean, cs->stats[RW_COL_RISK].m2, cs->total, z, remaining);
+  return RW_OK;
+}
+
+/* Risk of the position-th smallest scholar (1-based). */
+static double ascending_risk(const rw_engine *engine, long long position) {
+  if (position < 1) position = 1;
+  if (position > engine->count) position = engine->count;
+  return risk_at(engine, engine->count - (int)position);
+}
+
+int rw_sample_quantile(const rw_engine *engine, double q, double confidence, rw_estimate *out) {
+  if (!engine->scored) return RW_ERR_CONFIG;
+  if (engine->count == 0 || !(q >= 0.0 && q <= 1.0) || !(confidence > 0.0 && confidence < 1.0)) {
+    return RW_ERR_RANGE;
+  }
+  /* The sample is ranked, so order statistics are direct reads: the
+   * nearest-rank point, bounded by the ranks nq -/+ z sqrt(nq(1 - q)). */
+  double n = (double)engine->count;
+  double remaining = remaining_fraction(engine);
+  double center = q * n;
+  out->value = ascending_risk(engine, (long long)ceil(center));
+  out->low = out->value;
+  out->high = out->value;
+  if (remaining > 0.0) {
+    double half = critical_value(confidence) * sqrt(n * q * (1.0 - q) * remaining);
+    out->low = ascending_risk(engine, (long long)floor(center - half));
+    out->high = ascending_risk(engine, (long long)ceil(center + half));
+  }
+  return RW_OK;
+}
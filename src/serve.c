@@ -0,0 +1,677 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "serve.h"
+
+#define SERVE_EVENTS 64
+/* A connection's response buffer is released after sending more than this. */
+#define SERVE_KEEP_BYTES 65536
+
+#define SERVE_SUMMARY 0
+#define SERVE_COHORTS 1
+#define SERVE_ACTIONS 2
+#define SERVE_QUEUE 3
+
+typedef struct {
+  char *data;
+  size_t used;
+  size_t capacity;
+  int failed;
+} ServeBuffer;
+
+typedef struct {
+  int fd;
+  int index;
+  uint32_t events;
+  /* Close once the pending response is sent. */
+  int close_after;
+  char request[SERVE_REQUEST_BYTES];
+  size_t request_used;
+  ServeBuffer response;
+  size_t response_sent;
+} ServeConnection;
+
+/* A rendered body, current while generation matches the server's. */
+typedef struct {
+  ServeBuffer body;
+  unsigned long long generation;
+} ServeCached;
+
+typedef struct {
+  int limit;
+  double min_risk;
+  int has_cohort;
+  char cohort[256];
+} QueueQuery;
+
+typedef struct {
+  ServeCached cached;
+  char key[320];
+} QueueEntry;
+
+struct Server {
+  int listen_fd;
+  int epoll_fd;
+  int watched_fd;
+  int port;
+  ServeOptions options;
+  const rw_engine *engine;
+  unsigned long long generation;
+  /* Start time in the ETag, so a restart never matches an old one. */
+  long started;
+  ServeCached summary;
+  ServeCached cohorts;
+  ServeCached actions;
+  QueueEntry queue[SERVE_QUEUE_CACHE];
+  int queue_next;
+  ServeConnection *connections[SERVE_MAX_CONNECTIONS];
+  int connection_count;
+  ServeStats stats;
+};
+
+static int buffer_reserve(ServeBuffer *b, size_t extra) {
+  if (b->failed) return 0;
+  if (b->used + extra <= b->capacity) return 1;
+  size_t capacity = b->capacity == 0 ? 4096 : b->capacity;
+  while (capacity < b->used + extra) capacity *= 2;
+  char *data = realloc(b->data, capacity);
+  if (!data) {
+    b->failed = 1;
+    return 0;
+  }
+  b->data = data;
+  b->capacity = capacity;
+  return 1;
+}
+
+static void buffer_append(ServeBuffer *b, const char *data, size_t size) {
+  if (!buffer_reserve(b, size)) return;
+  memcpy(b->data + b->used, data, size);
+  b->used += size;
+}
+
+static void buffer_format(ServeBuffer *b, const char *format, ...) {
+  if (!buffer_reserve(b, 256)) return;
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(b->data + b->used, b->capacity - b->used, format, args);
+  va_end(args);
+  if (n < 0) return;
+  if ((size_t)n >= b->capacity - b->used) {
+    if (!buffer_reserve(b, (size_t)n + 1)) return;
+    va_start(args, format);
+    vsnprintf(b->data + b->used, b->capacity - b->used, format, args);
+    va_end(args);
+  }
+  b->used += (size_t)n;
+}
+
+/* Appends s as a JSON string, escaping quotes and backslashes. */
+static void buffer_json_text(ServeBuffer *b, const char *s) {
+  size_t len = strlen(s);
+  if (!buffer_reserve(b, 2 * len + 2)) return;
+  char *p = b->data + b->used;
+  *p++ = '"';
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') *p++ = '\\';
+    *p++ = (unsigned char)*s < 0x20 ? ' ' : *s;
+  }
+  *p++ = '"';
+  b->used = (size_t)(p - b->data);
+}
+
+static void buffer_clear(ServeBuffer *b) {
+  b->used = 0;
+  b->failed = 0;
+}
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static void render_summary(const Server *server, ServeBuffer *out) {
+  const rw_engine *engine = server->engine;
+  rw_totals totals;
+  rw_config config;
+  rw_get_totals(engine, &totals);
+  rw_get_config(engine, &config);
+  buffer_format(out,
+                "{\"total\": %d, \"average_risk\": %.1f, \"risk_thresholds\": {\"high\": %.1f, \"medium\": %.1f}, "
+                "\"tiers\": {\"high\": %d, \"medium\": %d, \"low\": %d}, \"min_risk\": %.1f, "
+                "\"at_or_above_min_risk\": %d, \"cohorts\": %d, \"actions\": %d, \"generation\": %llu}\n",
+                totals.loaded, totals.avg_risk, config.high_threshold, config.medium_threshold, totals.high,
+                totals.medium, totals.low, server->options.min_risk,
+                rw_count_at_least(engine, server->options.min_risk), rw_cohort_count(engine),
+                rw_action_count(engine), server->generation);
+}
+
+static void render_summaries(const Server *server, int endpoint, ServeBuffer *out) {
+  const rw_engine *engine = server->engine;
+  const char *label = endpoint == SERVE_COHORTS ? "cohort" : "action";
+  int count = endpoint == SERVE_COHORTS ? rw_cohort_count(engine) : rw_action_count(engine);
+  rw_summary sum;
+  buffer_format(out, "{\"%ss\": [", label);
+  for (int i = 0; i < count; i++) {
+    if (endpoint == SERVE_COHORTS) rw_cohort_at(engine, i, &sum);
+    else rw_action_at(engine, i, &sum);
+    buffer_format(out, "%s{\"%s\": ", i > 0 ? ", " : "", label);
+    buffer_json_text(out, sum.name);
+    buffer_format(out, ", \"total\": %d, \"avg_risk\": %.1f, \"high\": %d, \"medium\": %d, \"low\": %d}", sum.total,
+                  sum.avg_risk, sum.high, sum.medium, sum.low);
+  }
+  buffer_format(out, "]}\n");
+}
+
+/* The queue in rank order; a cohort filter walks the queue past the
+ * scholars of other cohorts. */
+static void render_queue(const Server *server, const QueueQuery *query, ServeBuffer *out) {
+  const rw_engine *engine = server->engine;
+  rw_iter iter;
+  rw_scholar s;
+  char driver_text[256];
+  buffer_format(out, "{\"min_risk\": %.1f, \"limit\": %d, \"cohort\": ", query->min_risk, query->limit);
+  if (query->has_cohort) buffer_json_text(out, query->cohort);
+  else buffer_format(out, "null");
+  buffer_format(out, ", \"action_queue\": [");
+  int printed = 0;
+  rw_topk_begin(engine, query->min_risk, query->has_cohort ? rw_count(engine) : query->limit, &iter);
+  while (printed < query->limit && rw_topk_next(&iter, &s)) {
+    if (query->has_cohort && strcmp(s.cohort, query->cohort) != 0) continue;
+    buffer_format(out, "%s{\"rank\": %d, \"scholar_id\": ", printed++ > 0 ? ", " : "", s.rank + 1);
+    buffer_json_text(out, s.scholar_id);
+    buffer_format(out, ", \"name\": ");
+    buffer_json_text(out, s.name);
+    buffer_format(out, ", \"cohort\": ");
+    buffer_json_text(out, s.cohort);
+    buffer_format(out, ", \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\"", s.risk, s.tier, s.action);
+    if (server->options.drivers) {
+      rw_drivers_at(engine, s.rank, driver_text, sizeof(driver_text));
+      buffer_format(out, ", \"drivers\": ");
+      buffer_json_text(out, driver_text);
+    }
+    buffer_format(out, "}");
+  }
+  buffer_format(out, "], \"count\": %d}\n", printed);
+}
+
+/* Decodes %XX escapes and '+' into out; 0 when malformed or too long. */
+static int decode_value(const char *value, size_t len, char *out, size_t size) {
+  size_t used = 0;
+  for (size_t i = 0; i < len; i++) {
+    char c = value[i];
+    if (c == '+') {
+      c = ' ';
+    } else if (c == '%') {
+      if (i + 2 >= len || !isxdigit((unsigned char)value[i + 1]) || !isxdigit((unsigned char)value[i + 2])) {
+        return 0;
+      }
+      char hex[3] = {value[i + 1], value[i + 2], '\0'};
+      c = (char)strtol(hex, NULL, 16);
+      i += 2;
+    }
+    if (used + 1 >= size) return 0;
+    out[used++] = c;
+  }
+  out[used] = '\0';
+  return 1;
+}
+
+/* Fills query from limit=, min_risk= and cohort= (others are ignored),
+ * starting from the -limit and -min-risk defaults; returns an error
+ * message for a bad value, or NULL. */
+static const char *parse_queue_query(const Server *server, const char *text, QueueQuery *query) {
+  query->limit = server->options.limit;
+  query->min_risk = server->options.min_risk;
+  query->has_cohort = 0;
+  query->cohort[0] = '\0';
+  while (text && *text) {
+    const char *amp = strchr(text, '&');
+    size_t len = amp ? (size_t)(amp - text) : strlen(text);
+    const char *eq = memchr(text, '=', len);
+    size_t name_len = eq ? (size_t)(eq - text) : len;
+    char value[256];
+    if (!decode_value(eq ? eq + 1 : text + len, eq ? len - name_len - 1 : 0, value, sizeof(value))) {
+      return "malformed query value";
+    }
+    char *end;
+    if (name_len == 5 && strncmp(text, "limit", 5) == 0) {
+      long limit = strtol(value, &end, 10);
+      if (end == value || *end != '\0' || limit < 0 || limit > 1000000000L) {
+        return "limit must be a whole number of at least 0";
+      }
+      query->limit = (int)limit;
+    } else if (name_len == 8 && strncmp(text, "min_risk", 8) == 0) {
+      double min_risk = strtod(value, &end);
+      if (end == value || *end != '\0' || !isfinite(min_risk)) return "min_risk must be a number";
+      query->min_risk = min_risk;
+    } else if (name_len == 6 && strncmp(text, "cohort", 6) == 0) {
+      query->has_cohort = 1;
+      snprintf(query->cohort, sizeof(query->cohort), "%s", value);
+    }
+    text = amp ? amp + 1 : NULL;
+  }
+  return NULL;
+}
+
+/* The cache slot for a request; a /queue query reuses its own slot or
+ * takes the oldest. */
+static ServeCached *cache_slot(Server *server, int endpoint, const QueueQuery *query) {
+  if (endpoint == SERVE_SUMMARY) return &server->summary;
+  if (endpoint == SERVE_COHORTS) return &server->cohorts;
+  if (endpoint == SERVE_ACTIONS) return &server->actions;
+  char key[sizeof(server->queue[0].key)];
+  snprintf(key, sizeof(key), "%d|%.17g|%d|%s", query->limit, query->min_risk, query->has_cohort, query->cohort);
+  for (int i = 0; i < SERVE_QUEUE_CACHE; i++) {
+    if (server->queue[i].cached.generation != 0 && strcmp(server->queue[i].key, key) == 0) {
+      return &server->queue[i].cached;
+    }
+  }
+  QueueEntry *entry = &server->queue[server->queue_next];
+  server->queue_next = (server->queue_next + 1) % SERVE_QUEUE_CACHE;
+  snprintf(entry->key, sizeof(entry->key), "%s", key);
+  entry->cached.generation = 0;
+  return &entry->cached;
+}
+
+static const char *status_reason(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 431: return "Request Header Fields Too Large";
+    default: return "Service Unavailable";
+  }
+}
+
+static void reply(ServeConnection *c, int status, const char *etag, const char *body, size_t size, int head_only) {
+  ServeBuffer *out = &c->response;
+  buffer_format(out, "HTTP/1.1 %d %s\r\n", status, status_reason(status));
+  if (status != 304) buffer_format(out, "Content-Type: application/json\r\nContent-Length: %zu\r\n", size);
+  if (etag) buffer_format(out, "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+  if (status == 405) buffer_format(out, "Allow: GET, HEAD\r\n");
+  buffer_format(out, "Connection: %s\r\n\r\n", c->close_after ? "close" : "keep-alive");
+  if (!head_only && status != 304) buffer_append(out, body, size);
+  if (out->failed) {
+    /* No room for the reply: drop the connection instead. */
+    buffer_clear(out);
+    c->close_after = 1;
+  }
+}
+
+static void reply_error(ServeConnection *c, int status, const char *message, int head_only) {
+  char body[256];
+  int n = snprintf(body, sizeof(body), "{\"error\": \"%s\"}\n", message);
+  reply(c, status, NULL, body, (size_t)n, head_only);
+}
+
+/* Value of header name in a block of CRLF-separated lines, or NULL. */
+static const char *find_header(const char *headers, const char *name) {
+  size_t len = strlen(name);
+  for (const char *line = headers; line && *line;) {
+    if (strncasecmp(line, name, len) == 0 && line[len] == ':') {
+      const char *value = line + len + 1;
+      while (*value == ' ' || *value == '\t') value++;
+      return value;
+    }
+    const char *next = strstr(line, "\r\n");
+    line = next ? next + 2 : NULL;
+  }
+  return NULL;
+}
+
+static int header_is(const char *value, const char *token) {
+  size_t len = strlen(token);
+  return strncasecmp(value, token, len) == 0 &&
+         (value[len] == '\0' || value[len] == '\r' || value[len] == ' ' || value[len] == ',');
+}
+
+/* Answers one request whose head (request line and headers) is
+ * NUL-terminated, queueing the reply on the connection. */
+static void handle_request(Server *server, ServeConnection *c, char *head) {
+  server->stats.requests++;
+  const char *headers = "";
+  char *line_end = strstr(head, "\r\n");
+  if (line_end) {
+    *line_end = '\0';
+    headers = line_end + 2;
+  }
+  char *target = strchr(head, ' ');
+  char *version = target ? strchr(target + 1, ' ') : NULL;
+  if (!version) {
+    c->close_after = 1;
+    reply_error(c, 400, "malformed request line", 0);
+    return;
+  }
+  *target++ = '\0';
+  *version++ = '\0';
+  const char *connection = find_header(headers, "Connection");
+  if (strcmp(version, "HTTP/1.1") == 0) {
+    c->close_after = connection && header_is(connection, "close");
+  } else if (strcmp(version, "HTTP/1.0") == 0) {
+    c->close_after = !(connection && header_is(connection, "keep-alive"));
+  } else {
+    c->close_after = 1;
+    reply_error(c, 400, "unsupported HTTP version", 0);
+    return;
+  }
+
+  int head_only = strcmp(head, "HEAD") == 0;
+  const char *length = find_header(headers, "Content-Length");
+  if (find_header(headers, "Transfer-Encoding") || (length && atoll(length) != 0)) {
+    /* Bodies are never read, so the connection cannot be reused. */
+    c->close_after = 1;
+    reply_error(c, 400, "request bodies are not accepted", head_only);
+    return;
+  }
+  if (!head_only && strcmp(head, "GET") != 0) {
+    reply_error(c, 405, "only GET and HEAD are supported", 0);
+    return;
+  }
+
+  char *query_text = strchr(target, '?');
+  if (query_text) *query_text++ = '\0';
+  int endpoint;
+  if (strcmp(target, "/summary") == 0) {
+    endpoint = SERVE_SUMMARY;
+  } else if (strcmp(target, "/cohorts") == 0) {
+    endpoint = SERVE_COHORTS;
+  } else if (strcmp(target, "/actions") == 0) {
+    endpoint = SERVE_ACTIONS;
+  } else if (strcmp(target, "/queue") == 0) {
+    endpoint = SERVE_QUEUE;
+  } else {
+    reply_error(c, 404, "no such endpoint; try /summary, /cohorts, /actions or /queue", head_only);
+    return;
+  }
+  QueueQuery query = {0, 0.0, 0, ""};
+  if (endpoint == SERVE_QUEUE) {
+    const char *error = parse_queue_query(server, query_text, &query);
+    if (error) {
+      reply_error(c, 400, error, head_only);
+      return;
+    }
+  }
+  if (!server->engine) {
+    reply_error(c, 503, "no data yet", head_only);
+    return;
+  }
+
+  char etag[64];
+  snprintf(etag, sizeof(etag), "\"%lx-%llu\"", server->started, server->generation);
+  const char *match = find_header(headers, "If-None-Match");
+  if (match && strncmp(match, etag, strlen(etag)) == 0) {
+    server->stats.not_modified++;
+    reply(c, 304, etag, NULL, 0, 1);
+    return;
+  }
+  ServeCached *cached = cache_slot(server, endpoint, &query);
+  if (cached->generation != server->generation) {
+    buffer_clear(&cached->body);
+    if (endpoint == SERVE_SUMMARY) render_summary(server, &cached->body);
+    else if (endpoint == SERVE_QUEUE) render_queue(server, &query, &cached->body);
+    else render_summaries(server, endpoint, &cached->body);
+    if (cached->body.failed) {
+      cached->generation = 0;
+      reply_error(c, 503, "out of memory", head_only);
+      return;
+    }
+    cached->generation = server->generation;
+    server->stats.renders++;
+  } else {
+    server->stats.cache_hits++;
+  }
+  reply(c, 200, etag, cached->body.data, cached->body.used, head_only);
+}
+
+static void close_connection(Server *server, ServeConnection *c) {
+  epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+  close(c->fd);
+  free(c->response.data);
+  ServeConnection *last = server->connections[--server->connection_count];
+  server->connections[c->index] = last;
+  last->index = c->index;
+  free(c);
+}
+
+/* Sends what the socket takes of the pending response; 0 on a connection
+ * error. */
+static int flush_response(ServeConnection *c) {
+  while (c->response_sent < c->response.used) {
+    ssize_t sent = send(c->fd, c->response.data + c->response_sent, c->response.used - c->response_sent,
+                        MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    c->response_sent += (size_t)sent;
+  }
+  if (c->response.capacity > SERVE_KEEP_BYTES) {
+    free(c->response.data);
+    c->response.data = NULL;
+    c->response.capacity = 0;
+  }
+  buffer_clear(&c->response);
+  c->response_sent = 0;
+  return 1;
+}
+
+static int watch_connection(Server *server, ServeConnection *c, uint32_t events) {
+  if (c->events == events) return 1;
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.ptr = c;
+  if (epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, c->fd, &event) != 0) return 0;
+  c->events = events;
+  return 1;
+}
+
+/* Answers the buffered requests in order. A reply the socket cannot take
+ * yet switches the connection to EPOLLOUT, so a slow client stops being
+ * read until it catches up. */
+static void serve_connection(Server *server, ServeConnection *c) {
+  for (;;) {
+    if (!flush_response(c)) {
+      close_connection(server, c);
+      return;
+    }
+    if (c->response.used > 0) {
+      if (!watch_connection(server, c, EPOLLOUT)) close_connection(server, c);
+      return;
+    }
+    if (c->close_after) {
+      close_connection(server, c);
+      return;
+    }
+    char *end = memmem(c->request, c->request_used, "\r\n\r\n", 4);
+    if (!end) {
+      if (c->request_used < sizeof(c->request)) break;
+      server->stats.requests++;
+      c->close_after = 1;
+      c->request_used = 0;
+      reply_error(c, 431, "request head too large", 0);
+      continue;
+    }
+    size_t length = (size_t)(end - c->request) + 4;
+    *end = '\0';
+    handle_request(server, c, c->request);
+    memmove(c->request, c->request + length, c->request_used - length);
+    c->request_used -= length;
+  }
+  if (!watch_connection(server, c, EPOLLIN)) close_connection(server, c);
+}
+
+static void read_requests(Server *server, ServeConnection *c) {
+  while (c->request_used < sizeof(c->request)) {
+    ssize_t got = recv(c->fd, c->request + c->request_used, sizeof(c->request) - c->request_used, 0);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      close_connection(server, c);
+      return;
+    }
+    if (got == 0) {
+      close_connection(server, c);
+      return;
+    }
+    c->request_used += (size_t)got;
+  }
+  serve_connection(server, c);
+}
+
+static void accept_connections(Server *server) {
+  for (;;) {
+    int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    ServeConnection *c = server->connection_count < SERVE_MAX_CONNECTIONS ? calloc(1, sizeof(ServeConnection))
+                                                                           : NULL;
+    if (!c) {
+      close(fd);
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = c;
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      close(fd);
+      free(c);
+      continue;
+    }
+    c->fd = fd;
+    c->events = EPOLLIN;
+    c->index = server->connection_count;
+    server->connections[server->connection_count++] = c;
+    server->stats.connections++;
+  }
+}
+
+Server *serve_open(int port, const ServeOptions *options) {
+  Server *server = calloc(1, sizeof(Server));
+  if (!server) {
+    fprintf(stderr, "Failed to start the HTTP server: %s\n", rw_strerror(RW_ERR_NOMEM));
+    return NULL;
+  }
+  server->options = *options;
+  server->watched_fd = -1;
+  server->started = (long)time(NULL);
+  server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+  int one = 1;
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons((uint16_t)port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t address_len = sizeof(address);
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.ptr = &server->listen_fd;
+  if (server->listen_fd < 0 || server->epoll_fd < 0 ||
+      setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+      bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(server->listen_fd, SOMAXCONN) != 0 ||
+      getsockname(server->listen_fd, (struct sockaddr *)&address, &address_len) != 0 ||
+      epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) != 0) {
+    perror("Failed to start the HTTP server");
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    free(server);
+    return NULL;
+  }
+  server->port = ntohs(address.sin_port);
+  return server;
+}
+
+int serve_port(const Server *server) {
+  return server->port;
+}
+
+void serve_update(Server *server, const rw_engine *engine) {
+  server->engine = engine;
+  server->generation++;
+}
+
+int serve_wait(Server *server, int fd, int timeout_ms) {
+  if (fd != server->watched_fd) {
+    if (server->watched_fd >= 0) epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, server->watched_fd, NULL);
+    server->watched_fd = -1;
+    if (fd >= 0) {
+      struct epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.ptr = &server->watched_fd;
+      if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        /* Files and /dev/null cannot be watched; they never block. */
+        return errno == EPERM ? 1 : -1;
+      }
+      server->watched_fd = fd;
+    }
+  }
+
+  double deadline = now_ms() + timeout_ms;
+  struct epoll_event events[SERVE_EVENTS];
+  for (;;) {
+    int wait_ms = -1;
+    if (timeout_ms >= 0) {
+      double left = deadline - now_ms();
+      if (left <= 0.0) return 0;
+      wait_ms = (int)ceil(left);
+    }
+    int n = epoll_wait(server->epoll_fd, events, SERVE_EVENTS, wait_ms);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+    int ready = 0;
+    for (int i = 0; i < n; i++) {
+      void *tag = events[i].data.ptr;
+      if (tag == &server->watched_fd) {
+        ready = 1;
+      } else if (tag == &server->listen_fd) {
+        accept_connections(server);
+      } else if (events[i].events & (EPOLLIN | EPOLLOUT)) {
+        ServeConnection *c = tag;
+        if (events[i].events & EPOLLIN) read_requests(server, c);
+        else serve_connection(server, c);
+      } else {
+        close_connection(server, tag);
+      }
+    }
+    if (ready) return 1;
+  }
+}
+
+void serve_close(Server *server, ServeStats *stats) {
+  while (server->connection_count > 0) close_connection(server, server->connections[0]);
+  free(server->summary.body.data);
+  free(server->cohorts.body.data);
+  free(server->actions.body.data);
+  for (int i = 0; i < SERVE_QUEUE_CACHE; i++) free(server->queue[i].cached.body.data);
+  close(server->listen_fd);
+  close(server->epoll_fd);
+  if (stats) *stats = server->stats;
+  free(server);
+}
@@ -0,0 +1,49 @@
+#ifndef RETENTION_SERVE_H
+#define RETENTION_SERVE_H
+
+#include "retention.h"
+
+/* Loopback HTTP/1.1 server for -follow (-serve PORT): dashboards GET
+ * /summary, /cohorts, /actions and /queue?limit=&min_risk=&cohort= as JSON
+ * over keep-alive connections. It is single-threaded on epoll and runs
+ * inside the follow loop while it waits for the next batch, so it reads
+ * the live engine without locks. Bodies are rendered on the first request
+ * after a change and served from the cache until the next one. */
+
+#define SERVE_MAX_CONNECTIONS 256
+#define SERVE_REQUEST_BYTES 8192
+#define SERVE_QUEUE_CACHE 16
+
+typedef struct {
+  /* /queue defaults when the query leaves them out. */
+  double min_risk;
+  int limit;
+  int drivers;
+} ServeOptions;
+
+typedef struct {
+  long long connections;
+  long long requests;
+  /* Bodies rendered, and requests answered from the cache or with 304. */
+  long long renders;
+  long long cache_hits;
+  long long not_modified;
+} ServeStats;
+
+typedef struct Server Server;
+
+/* Listens on 127.0.0.1:port (0 picks a free port); NULL after printing an
+ * error. */
+Server *serve_open(int port, const ServeOptions *options);
+int serve_port(const Server *server);
+/* Points the server at the engine's current data and drops the cached
+ * bodies. Called after every batch. */
+void serve_update(Server *server, const rw_engine *engine);
+/* Answers requests until fd is readable (1) or timeout_ms passes or a
+ * signal arrives (0); fd -1 and timeout_ms -1 mean neither. -1 on an epoll
+ * error, with errno set. */
+int serve_wait(Server *server, int fd, int timeout_ms);
+/* Closes every connection and fills stats. */
+void serve_close(Server *server, ServeStats *stats);
+
+#endif
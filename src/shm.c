@@ -0,0 +1,350 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+/* Shared-memory publication (rw_shm_publish) and the reader side. The
+ * writer keeps one segment mapped per engine and rewrites it in place
+ * under the header's seqlock; see retention.h for the layout. */
+
+/* Reads that see a writer this many times in a row give up with EAGAIN,
+ * so a reader never hangs on a segment whose writer died mid-publish. */
+#define SHM_READ_TRIES 1000000
+
+struct ShmSegment {
+  char *name;
+  int fd;
+  unsigned char *base;
+  size_t mapped;
+};
+
+enum { SHM_DOUBLE, SHM_INT, SHM_STRING };
+
+static const unsigned char column_kinds[RW_SHM_COLUMNS] = {
+    SHM_DOUBLE, SHM_DOUBLE, SHM_DOUBLE, SHM_DOUBLE, SHM_DOUBLE, SHM_DOUBLE, SHM_DOUBLE, SHM_INT,
+    SHM_INT,    SHM_INT,    SHM_INT,    SHM_STRING, SHM_STRING, SHM_STRING, SHM_DOUBLE, SHM_DOUBLE};
+
+static uint64_t align8(uint64_t offset) {
+  return (offset + 7) & ~(uint64_t)7;
+}
+
+static double double_value(const Scholar *s, int column) {
+  switch (column) {
+    case RW_COL_DAYS_INACTIVE: return s->days_inactive;
+    case RW_COL_ATTENDANCE_RATE: return s->attendance_rate;
+    case RW_COL_ENGAGEMENT_SCORE: return s->engagement_score;
+    case RW_COL_GPA: return s->gpa;
+    case RW_COL_LAST_CONTACT_DAYS: return s->last_contact_days;
+    case RW_COL_SURVEY_SCORE: return s->survey_score;
+    case RW_COL_ATTENDANCE_TREND: return s->attendance_trend;
+    case RW_COL_ENGAGEMENT_TREND: return s->engagement_trend;
+    default: return s->risk_score;
+  }
+}
+
+static const char *string_value(const Scholar *s, int column) {
+  switch (column) {
+    case RW_COL_SCHOLAR_ID: return s->id;
+    case RW_COL_NAME: return s->name;
+    default: return s->cohort;
+  }
+}
+
+/* The scholar at rank: slot order from rw_live_order while live. */
+static const Scholar *row_at(const rw_engine *engine, const int *order, int rank) {
+  return &engine->scholars[order ? order[rank] : rank];
+}
+
+/* Offsets of every section for the current roster, in header form. */
+static void plan_layout(const rw_engine *engine, const int *order, rw_shm_header *layout, uint64_t *names) {
+  int count = engine->count;
+  memset(layout, 0, sizeof(*layout));
+  uint64_t offset = align8(sizeof(rw_shm_header));
+  layout->cohorts = offset;
+  offset += sizeof(rw_shm_summary) * (uint64_t)engine->cohort_count;
+  layout->actions = offset;
+  offset += sizeof(rw_shm_summary) * (uint64_t)engine->action_count;
+  for (int c = 0; c < RW_SHM_COLUMNS; c++) {
+    rw_shm_column *column = &layout->columns[c];
+    column->offset = offset;
+    if (column_kinds[c] == SHM_DOUBLE) {
+      column->size = sizeof(double) * (uint64_t)count;
+    } else if (column_kinds[c] == SHM_INT) {
+      column->size = sizeof(int32_t) * (uint64_t)count;
+    } else {
+      uint64_t bytes = 0;
+      for (int i = 0; i < count; i++) {
+        bytes += strlen(string_value(row_at(engine, order, i), c));
+      }
+      column->data = offset + sizeof(int64_t) * ((uint64_t)count + 1);
+      column->size = column->data - offset + bytes;
+    }
+    offset = align8(offset + column->size);
+  }
+  *names = offset;
+  for (int i = 0; i < engine->cohort_count; i++) {
+    offset += strlen(engine->cohorts[i].name) + 1;
+  }
+  for (int i = 0; i < engine->action_count; i++) {
+    offset += strlen(engine->actions[i].action) + 1;
+  }
+  layout->size = offset;
+}
+
+static int map_segment(ShmSegment *segment, size_t size) {
+  if (segment->base) munmap(segment->base, segment->mapped);
+  segment->base = NULL;
+  segment->mapped = 0;
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+  if (base == MAP_FAILED) return RW_ERR_IO;
+  segment->base = base;
+  segment->mapped = size;
+  return RW_OK;
+}
+
+/* Keeps errno, so a failed open can still be reported with perror. */
+void rw_shm_free(ShmSegment *segment) {
+  if (!segment) return;
+  int saved = errno;
+  if (segment->base) munmap(segment->base, segment->mapped);
+  if (segment->fd >= 0) close(segment->fd);
+  free(segment->name);
+  free(segment);
+  errno = saved;
+}
+
+/* The engine's segment for name, created or reopened and mapped whole. A
+ * segment left by an earlier process keeps its sequence and size. */
+static ShmSegment *open_segment(rw_engine *engine, const char *name) {
+  if (engine->shm && strcmp(engine->shm->name, name) == 0) return engine->shm;
+  rw_shm_free(engine->shm);
+  engine->shm = NULL;
+
+  ShmSegment *segment = calloc(1, sizeof(ShmSegment));
+  if (!segment) return NULL;
+  segment->name = strdup(name);
+  segment->fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+  struct stat st;
+  if (!segment->name || segment->fd < 0 || fstat(segment->fd, &st) != 0) {
+    rw_shm_free(segment);
+    return NULL;
+  }
+  size_t size = (size_t)st.st_size;
+  if (size < sizeof(rw_shm_header)) {
+    size = sizeof(rw_shm_header);
+    if (ftruncate(segment->fd, (off_t)size) != 0) {
+      rw_shm_free(segment);
+      return NULL;
+    }
+  }
+  if (map_segment(segment, size) != RW_OK) {
+    rw_shm_free(segment);
+    return NULL;
+  }
+  engine->shm = segment;
+  return segment;
+}
+
+/* Grows by half again, so a resident roster that creeps up does not
+ * remap on every publish. Never shrinks: readers may still map the tail. */
+static int reserve_segment(ShmSegment *segment, uint64_t size) {
+  if (size <= segment->mapped) return RW_OK;
+  long page = sysconf(_SC_PAGESIZE);
+  uint64_t grown = size + size / 2;
+  if (page > 0) grown = (grown + (uint64_t)page - 1) / (uint64_t)page * (uint64_t)page;
+  if (ftruncate(segment->fd, (off_t)grown) != 0) return RW_ERR_IO;
+  return map_segment(segment, (size_t)grown);
+}
+
+static void write_summary(unsigned char *base, rw_shm_summary *out, uint64_t *names, const char *name, int total,
+                          int high, int medium, int low, double risk_sum) {
+  size_t len = strlen(name) + 1;
+  memcpy(base + *names, name, len);
+  out->name = *names;
+  out->total = total;
+  out->high = high;
+  out->medium = medium;
+  out->low = low;
+  out->avg_risk = total > 0 ? risk_sum / (double)total : 0.0;
+  *names += len;
+}
+
+static void write_body(const rw_engine *engine, const int *order, const rw_shm_header *layout, uint64_t names,
+                       unsigned char *base) {
+  int count = engine->count;
+  rw_shm_summary *cohorts = (rw_shm_summary *)(base + layout->cohorts);
+  for (int i = 0; i < engine->cohort_count; i++) {
+    const CohortSummary *cs = &engine->cohorts[i];
+    write_summary(base, &cohorts[i], &names, cs->name, cs->total, cs->high, cs->medium, cs->low, cs->risk_sum);
+  }
+  rw_shm_summary *actions = (rw_shm_summary *)(base + layout->actions);
+  for (int i = 0; i < engine->action_count; i++) {
+    const ActionSummary *as = &engine->actions[i];
+    write_summary(base, &actions[i], &names, as->action, as->total, as->high, as->medium, as->low, as->risk_sum);
+  }
+
+  for (int c = 0; c < RW_SHM_COLUMNS; c++) {
+    const rw_shm_column *column = &layout->columns[c];
+    if (column_kinds[c] == SHM_DOUBLE) {
+      double *out = (double *)(base + column->offset);
+      for (int i = 0; i < count; i++) out[i] = double_value(row_at(engine, order, i), c);
+    } else if (column_kinds[c] == SHM_STRING) {
+      int64_t *offsets = (int64_t *)(base + column->offset);
+      char *data = (char *)(base + column->data);
+      int64_t total = 0;
+      for (int i = 0; i < count; i++) {
+        const char *value = string_value(row_at(engine, order, i), c);
+        size_t len = strlen(value);
+        offsets[i] = total;
+        memcpy(data + total, value, len);
+        total += (int64_t)len;
+      }
+      offsets[count] = total;
+    } else {
+      int32_t *out = (int32_t *)(base + column->offset);
+      for (int i = 0; i < count; i++) {
+        const Scholar *s = row_at(engine, order, i);
+        switch (c) {
+          case RW_COL_OPEN_FLAGS: out[i] = s->open_flags; break;
+          case RW_COL_TIER:
+            out[i] = rw_tier_code(s->risk_score, engine->high_threshold, engine->medium_threshold);
+            break;
+          case RW_COL_ACTION: out[i] = rw_action_code(s); break;
+          default: out[i] = engine->cohort_slots[s->cohort_id]; break;
+        }
+      }
+    }
+  }
+}
+
+int rw_shm_publish(rw_engine *engine, const char *name) {
+  if (!engine->scored) return RW_ERR_CONFIG;
+  int rc = rw_aggregate(engine);
+  if (rc != RW_OK) return rc;
+
+  int *order = NULL;
+  if (engine->live) {
+    order = malloc(sizeof(int) * (size_t)(engine->count > 0 ? engine->count : 1));
+    if (!order || rw_live_order(engine, order) != RW_OK) {
+      free(order);
+      return RW_ERR_NOMEM;
+    }
+  }
+  rw_trace_begin("shm publish", "publish");
+  rw_shm_header layout;
+  uint64_t names;
+  plan_layout(engine, order, &layout, &names);
+  ShmSegment *segment = open_segment(engine, name);
+  rc = segment ? reserve_segment(segment, layout.size) : RW_ERR_IO;
+  if (rc != RW_OK) {
+    free(order);
+    rw_trace_end("shm publish", "publish", 0);
+    return rc;
+  }
+
+  /* Seqlock write: odd, then the body and header, then the next even. A
+   * segment left odd by a writer that died keeps its odd value. */
+  rw_shm_header *header = (rw_shm_header *)segment->base;
+  int ours = header->magic == RW_SHM_MAGIC && header->version == RW_SHM_VERSION;
+  uint64_t sequence = (ours ? __atomic_load_n(&header->sequence, __ATOMIC_RELAXED) : 0) | 1;
+  __atomic_store_n(&header->sequence, sequence, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  layout.magic = RW_SHM_MAGIC;
+  layout.version = RW_SHM_VERSION;
+  layout.generation = ours ? header->generation + 1 : 1;
+  layout.count = engine->count;
+  layout.high = engine->high;
+  layout.medium = engine->medium;
+  layout.low = engine->low;
+  layout.avg_risk = engine->count > 0 ? engine->total_risk / (double)engine->count : 0.0;
+  layout.high_threshold = engine->high_threshold;
+  layout.medium_threshold = engine->medium_threshold;
+  layout.cohort_count = engine->cohort_count;
+  layout.action_count = engine->action_count;
+  write_body(engine, order, &layout, names, segment->base);
+  header->magic = layout.magic;
+  header->version = layout.version;
+  size_t rest = offsetof(rw_shm_header, generation);
+  memcpy((unsigned char *)header + rest, (const unsigned char *)&layout + rest, sizeof(rw_shm_header) - rest);
+  __atomic_store_n(&header->sequence, sequence + 1, __ATOMIC_RELEASE);
+
+  free(order);
+  rw_trace_end("shm publish", "publish", engine->count);
+  return RW_OK;
+}
+
+static int map_view(rw_shm_view *view) {
+  struct stat st;
+  if (fstat(view->fd, &st) != 0) return RW_ERR_IO;
+  if ((size_t)st.st_size < sizeof(rw_shm_header)) return RW_ERR_CONFIG;
+  if (view->base) munmap((void *)view->base, view->mapped);
+  view->base = NULL;
+  view->mapped = 0;
+  void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, view->fd, 0);
+  if (base == MAP_FAILED) return RW_ERR_IO;
+  view->base = base;
+  view->mapped = (size_t)st.st_size;
+  return RW_OK;
+}
+
+int rw_shm_open(rw_shm_view *view, const char *name) {
+  memset(view, 0, sizeof(*view));
+  view->fd = shm_open(name, O_RDONLY, 0);
+  if (view->fd < 0) return RW_ERR_IO;
+  int rc = map_view(view);
+  if (rc != RW_OK) {
+    int saved = errno;
+    rw_shm_close(view);
+    errno = saved;
+  }
+  return rc;
+}
+
+int rw_shm_read_begin(rw_shm_view *view, rw_shm_header *header) {
+  for (int tries = 0; tries < SHM_READ_TRIES; tries++) {
+    const rw_shm_header *shared = (const rw_shm_header *)view->base;
+    uint64_t sequence = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+    if (sequence & 1) {
+      sched_yield();
+      continue;
+    }
+    memcpy(header, shared, sizeof(*header));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) != sequence) continue;
+    if (header->magic != RW_SHM_MAGIC || header->version != RW_SHM_VERSION) return RW_ERR_CONFIG;
+    header->sequence = sequence;
+    if (header->size > view->mapped) {
+      int rc = map_view(view);
+      if (rc != RW_OK) return rc;
+      continue;
+    }
+    return RW_OK;
+  }
+  errno = EAGAIN;
+  return RW_ERR_IO;
+}
+
+int rw_shm_read_end(const rw_shm_view *view, const rw_shm_header *header) {
+  const rw_shm_header *shared = (const rw_shm_header *)view->base;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) == header->sequence;
+}
+
+void rw_shm_close(rw_shm_view *view) {
+  if (view->base) munmap((void *)view->base, view->mapped);
+  if (view->fd >= 0) close(view->fd);
+  view->base = NULL;
+  view->mapped = 0;
+  view->fd = -1;
+}
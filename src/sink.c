@@ -0,0 +1,474 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "sink.h"
+#include "instrument.h"
+
+#define SINK_RESPONSE_BYTES 8192
+#define SINK_RECORD_BYTES 1024
+
+typedef struct {
+  char *body;
+  size_t used;
+  size_t capacity;
+  int records;
+  long long id;
+} SinkBatch;
+
+/* One sender thread and its keep-alive connection. */
+typedef struct {
+  Sink *sink;
+  pthread_t thread;
+  int fd;
+  unsigned int seed;
+} SinkSender;
+
+struct Sink {
+  SinkOptions options;
+  char host[256];
+  char port[16];
+  char path[1024];
+  struct addrinfo *address;
+
+  pthread_mutex_t lock;
+  /* Senders wait on ready for a batch, the producer on room for a slot. */
+  pthread_cond_t ready;
+  pthread_cond_t room;
+  SinkBatch **queue;
+  int head;
+  int queued;
+  int in_flight;
+  int closing;
+  SinkSender *senders;
+  int sender_count;
+
+  SinkBatch *current;
+  long long next_id;
+  SinkStats stats;
+};
+
+/* Accepts http://host[:port][/path]; TLS endpoints sit behind a local
+ * proxy. */
+static int parse_url(Sink *sink, const char *url) {
+  const char *prefix = "http://";
+  if (strncmp(url, prefix, strlen(prefix)) != 0) return 0;
+  const char *host = url + strlen(prefix);
+  const char *path = strchr(host, '/');
+  size_t host_len = path ? (size_t)(path - host) : strlen(host);
+  const char *colon = memchr(host, ':', host_len);
+  size_t name_len = colon ? (size_t)(colon - host) : host_len;
+  if (name_len == 0 || name_len >= sizeof(sink->host)) return 0;
+  memcpy(sink->host, host, name_len);
+  sink->host[name_len] = '\0';
+  if (colon) {
+    size_t port_len = host_len - name_len - 1;
+    if (port_len == 0 || port_len >= sizeof(sink->port)) return 0;
+    memcpy(sink->port, colon + 1, port_len);
+    sink->port[port_len] = '\0';
+  } else {
+    snprintf(sink->port, sizeof(sink->port), "80");
+  }
+  snprintf(sink->path, sizeof(sink->path), "%s", path ? path : "/");
+  return 1;
+}
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static void sleep_ms(long ms) {
+  struct timespec pause = {ms / 1000, (ms % 1000) * 1000000L};
+  while (nanosleep(&pause, &pause) != 0 && errno == EINTR) {
+  }
+}
+
+static void close_connection(SinkSender *sender) {
+  if (sender->fd >= 0) close(sender->fd);
+  sender->fd = -1;
+}
+
+static int open_connection(SinkSender *sender) {
+  struct timeval timeout = {SINK_TIMEOUT_MS / 1000, (SINK_TIMEOUT_MS % 1000) * 1000};
+  int one = 1;
+  for (struct addrinfo *a = sender->sink->address; a; a = a->ai_next) {
+    int fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+    if (fd < 0) continue;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+      sender->fd = fd;
+      return 1;
+    }
+    close(fd);
+  }
+  return 0;
+}
+
+static int send_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) continue;
+      return 0;
+    }
+    data += sent;
+    size -= (size_t)sent;
+  }
+  return 1;
+}
+
+/* Value of header name in the header block, or NULL. */
+static const char *find_header(const char *headers, const char *name) {
+  size_t len = strlen(name);
+  for (const char *line = strstr(headers, "\r\n"); line; line = strstr(line, "\r\n")) {
+    line += 2;
+    if (strncasecmp(line, name, len) == 0 && line[len] == ':') {
+      const char *value = line + len + 1;
+      while (*value == ' ') value++;
+      return value;
+    }
+  }
+  return NULL;
+}
+
+/* Reads one response and returns its status (0 on a connection error).
+ * The connection is closed unless the body was fully read and the server
+ * keeps it alive. retry_after gets Retry-After in ms, or -1. */
+static int read_response(SinkSender *sender, long *retry_after) {
+  char buffer[SINK_RESPONSE_BYTES];
+  size_t used = 0;
+  char *end = NULL;
+  *retry_after = -1;
+  while (!end) {
+    if (used + 1 >= sizeof(buffer)) return 0;
+    ssize_t got = recv(sender->fd, buffer + used, sizeof(buffer) - 1 - used, 0);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) return 0;
+    used += (size_t)got;
+    buffer[used] = '\0';
+    end = strstr(buffer, "\r\n\r\n");
+  }
+  *end = '\0';
+  int status = 0;
+  if (sscanf(buffer, "HTTP/%*d.%*d %d", &status) != 1) return 0;
+
+  const char *value = find_header(buffer, "Retry-After");
+  if (value) *retry_after = atol(value) * 1000;
+  const char *connection = find_header(buffer, "Connection");
+  int keep = !(connection && strncasecmp(connection, "close", 5) == 0);
+  const char *length = find_header(buffer, "Content-Length");
+  if (!length) {
+    /* Chunked or close-delimited bodies are not reused. */
+    close_connection(sender);
+    return status;
+  }
+  long long remaining = atoll(length) - (long long)(used - (size_t)(end + 4 - buffer));
+  while (remaining > 0) {
+    ssize_t got = recv(sender->fd, buffer, sizeof(buffer), 0);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) {
+      keep = 0;
+      break;
+    }
+    remaining -= got;
+  }
+  if (!keep) close_connection(sender);
+  return status;
+}
+
+/* 2xx delivered; 429, 5xx and connection errors are retried; any other
+ * status is final. Returns 1 when delivered. */
+static int deliver(SinkSender *sender, const SinkBatch *batch, long long *retries) {
+  Sink *sink = sender->sink;
+  char header[2048];
+  int header_len = snprintf(header, sizeof(header),
+                            "POST %s HTTP/1.1\r\nHost: %s:%s\r\nContent-Type: application/json\r\n"
+                            "Content-Length: %zu\r\nIdempotency-Key: %ld-%lld\r\n\r\n",
+                            sink->path, sink->host, sink->port, batch->used, (long)getpid(), batch->id);
+  long backoff = SINK_BACKOFF_MS;
+  for (int attempt = 0;; attempt++) {
+    int status = 0;
+    long retry_after = -1;
+    int reused = sender->fd >= 0;
+    if (reused || open_connection(sender)) {
+      if (send_all(sender->fd, header, (size_t)header_len) && send_all(sender->fd, batch->body, batch->used)) {
+        status = read_response(sender, &retry_after);
+      }
+      if (status == 0) close_connection(sender);
+    }
+    /* The server may have closed an idle keep-alive connection: reconnect
+     * once without counting a retry. */
+    if (status == 0 && reused) {
+      attempt--;
+      continue;
+    }
+    if (status >= 200 && status < 300) return 1;
+    if (status != 0 && status != 429 && status < 500) return 0;
+    if (attempt >= sink->options.max_retries) return 0;
+
+    (*retries)++;
+    long wait = backoff / 2 + (long)(rand_r(&sender->seed) % (unsigned int)(backoff / 2 + 1));
+    if (retry_after >= 0) wait = retry_after < SINK_BACKOFF_CAP_MS ? retry_after : SINK_BACKOFF_CAP_MS;
+    sleep_ms(wait);
+    backoff = backoff * 2 < SINK_BACKOFF_CAP_MS ? backoff * 2 : SINK_BACKOFF_CAP_MS;
+  }
+}
+
+static void *sender_main(void *arg) {
+  SinkSender *sender = arg;
+  Sink *sink = sender->sink;
+  pthread_mutex_lock(&sink->lock);
+  for (;;) {
+    while (sink->queued == 0 && !sink->closing) pthread_cond_wait(&sink->ready, &sink->lock);
+    if (sink->queued == 0) break;
+    SinkBatch *batch = sink->queue[sink->head];
+    sink->head = (sink->head + 1) % sink->options.max_in_flight;
+    sink->queued--;
+    sink->in_flight++;
+    pthread_mutex_unlock(&sink->lock);
+
+    long long retries = 0;
+    rw_trace_begin("sink batch", "sink");
+    int delivered = deliver(sender, batch, &retries);
+    rw_trace_end("sink batch", "sink", batch->records);
+
+    pthread_mutex_lock(&sink->lock);
+    sink->in_flight--;
+    sink->stats.retries += retries;
+    if (delivered) {
+      sink->stats.batches++;
+    } else {
+      sink->stats.failed_batches++;
+      sink->stats.failed_records += batch->records;
+    }
+    pthread_cond_broadcast(&sink->room);
+    free(batch->body);
+    free(batch);
+  }
+  pthread_mutex_unlock(&sink->lock);
+  close_connection(sender);
+  return NULL;
+}
+
+Sink *sink_open(const SinkOptions *options) {
+  Sink *sink = calloc(1, sizeof(Sink));
+  if (!sink) {
+    fprintf(stderr, "Failed to start sink: %s\n", rw_strerror(RW_ERR_NOMEM));
+    return NULL;
+  }
+  sink->options = *options;
+  if (sink->options.batch_size < 1) sink->options.batch_size = SINK_DEFAULT_BATCH;
+  if (sink->options.max_in_flight < 1) sink->options.max_in_flight = SINK_DEFAULT_IN_FLIGHT;
+  if (sink->options.max_retries < 0) sink->options.max_retries = 0;
+  if (!parse_url(sink, options->url)) {
+    fprintf(stderr, "-sink expects http://host[:port][/path], got %s.\n", options->url);
+    free(sink);
+    return NULL;
+  }
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  int gai = getaddrinfo(sink->host, sink->port, &hints, &sink->address);
+  if (gai != 0) {
+    fprintf(stderr, "Failed to resolve sink host %s: %s\n", sink->host, gai_strerror(gai));
+    free(sink);
+    return NULL;
+  }
+
+  int count = sink->options.max_in_flight;
+  sink->queue = calloc((size_t)count, sizeof(SinkBatch *));
+  sink->senders = calloc((size_t)count, sizeof(SinkSender));
+  if (!sink->queue || !sink->senders) {
+    fprintf(stderr, "Failed to start sink: %s\n", rw_strerror(RW_ERR_NOMEM));
+    free(sink->queue);
+    free(sink->senders);
+    freeaddrinfo(sink->address);
+    free(sink);
+    return NULL;
+  }
+  pthread_mutex_init(&sink->lock, NULL);
+  pthread_cond_init(&sink->ready, NULL);
+  pthread_cond_init(&sink->room, NULL);
+  for (int i = 0; i < count; i++) {
+    SinkSender *sender = &sink->senders[i];
+    sender->sink = sink;
+    sender->fd = -1;
+    sender->seed = (unsigned int)getpid() * 2654435761u + (unsigned int)i;
+    if (pthread_create(&sender->thread, NULL, sender_main, sender) != 0) break;
+    sink->sender_count++;
+  }
+  if (sink->sender_count == 0) {
+    fprintf(stderr, "Failed to start sink threads.\n");
+    sink_close(sink, NULL);
+    return NULL;
+  }
+  return sink;
+}
+
+/* Hands the current batch to the senders, waiting while max_in_flight
+ * batches are already queued or being sent. */
+static void seal_batch(Sink *sink) {
+  SinkBatch *batch = sink->current;
+  if (!batch || batch->records == 0) return;
+  sink->current = NULL;
+  batch->body[batch->used++] = ']';
+  batch->id = sink->next_id++;
+
+  pthread_mutex_lock(&sink->lock);
+  if (sink->queued + sink->in_flight >= sink->options.max_in_flight) {
+    double start = now_ms();
+    sink->stats.stalls++;
+    while (sink->queued + sink->in_flight >= sink->options.max_in_flight) {
+      pthread_cond_wait(&sink->room, &sink->lock);
+    }
+    sink->stats.stalled_ms += now_ms() - start;
+  }
+  int tail = (sink->head + sink->queued) % sink->options.max_in_flight;
+  sink->queue[tail] = batch;
+  sink->queued++;
+  pthread_cond_signal(&sink->ready);
+  pthread_mutex_unlock(&sink->lock);
+}
+
+/* Senders update the failure counts too. */
+static void drop_record(Sink *sink) {
+  pthread_mutex_lock(&sink->lock);
+  sink->stats.failed_records++;
+  pthread_mutex_unlock(&sink->lock);
+}
+
+static void push_record(Sink *sink, const char *record, size_t len) {
+  SinkBatch *batch = sink->current;
+  if (!batch) {
+    batch = calloc(1, sizeof(SinkBatch));
+    if (!batch) {
+      drop_record(sink);
+      return;
+    }
+    sink->current = batch;
+  }
+  /* Room for the separator and the closing bracket. */
+  size_t needed = batch->used + len + 2;
+  if (needed > batch->capacity) {
+    size_t capacity = batch->capacity == 0 ? 64 * 1024 : batch->capacity * 2;
+    while (capacity < needed) capacity *= 2;
+    char *body = realloc(batch->body, capacity);
+    if (!body) {
+      drop_record(sink);
+      return;
+    }
+    batch->body = body;
+    batch->capacity = capacity;
+  }
+  batch->body[batch->used++] = batch->records == 0 ? '[' : ',';
+  memcpy(batch->body + batch->used, record, len);
+  batch->used += len;
+  batch->records++;
+  sink->stats.records++;
+  if (batch->records >= sink->options.batch_size) seal_batch(sink);
+}
+
+/* Appends to a record buffer, never past end (the record is cut short
+ * instead). */
+static char *append_format(char *p, char *end, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(p, (size_t)(end - p), format, args);
+  va_end(args);
+  if (n < 0) return p;
+  return n < end - p ? p + n : end - 1;
+}
+
+/* Copies s as a JSON string body, escaping quotes and backslashes. */
+static char *append_json_text(char *p, char *end, const char *s) {
+  for (; *s && p + 2 < end; s++) {
+    if (*s == '"' || *s == '\\') *p++ = '\\';
+    *p++ = (unsigned char)*s < 0x20 ? ' ' : *s;
+  }
+  return p;
+}
+
+void sink_push_scholar(Sink *sink, const rw_engine *engine, const rw_scholar *s, const char *id, int drivers) {
+  char record[SINK_RECORD_BYTES];
+  char *end = record + sizeof(record);
+  char *p = record;
+  if (!s) {
+    p = append_format(p, end, "{\"op\": \"delete\", \"scholar_id\": \"");
+    p = append_json_text(p, end - 2, id);
+    p = append_format(p, end, "\"}");
+    push_record(sink, record, (size_t)(p - record));
+    return;
+  }
+  /* Text fields leave room for the fixed fields and drivers. */
+  char *text_end = end - 512;
+  p = append_format(p, end, "{\"op\": \"upsert\", \"scholar_id\": \"");
+  p = append_json_text(p, text_end, s->scholar_id);
+  p = append_format(p, end, "\", \"name\": \"");
+  p = append_json_text(p, text_end, s->name);
+  p = append_format(p, end, "\", \"cohort\": \"");
+  p = append_json_text(p, text_end, s->cohort);
+  p = append_format(p, end, "\", \"rank\": %d, \"risk\": %.1f, \"tier\": \"%s\", \"action\": \"%s\"", s->rank + 1,
+                    s->risk, s->tier, s->action);
+  if (drivers) {
+    char driver_text[256];
+    rw_drivers_at(engine, s->rank, driver_text, sizeof(driver_text));
+    p = append_format(p, end, ", \"drivers\": \"%s\"", driver_text);
+  }
+  p = append_format(p, end, "}");
+  push_record(sink, record, (size_t)(p - record));
+}
+
+void sink_push_queue(Sink *sink, const rw_engine *engine, double min_risk, int drivers) {
+  rw_iter iter;
+  rw_scholar s;
+  rw_topk_begin(engine, min_risk, rw_count(engine), &iter);
+  while (rw_topk_next(&iter, &s)) {
+    sink_push_scholar(sink, engine, &s, s.scholar_id, drivers);
+  }
+}
+
+void sink_flush(Sink *sink) {
+  seal_batch(sink);
+}
+
+int sink_close(Sink *sink, SinkStats *stats) {
+  if (sink->sender_count > 0) seal_batch(sink);
+  pthread_mutex_lock(&sink->lock);
+  sink->closing = 1;
+  pthread_cond_broadcast(&sink->ready);
+  pthread_mutex_unlock(&sink->lock);
+  for (int i = 0; i < sink->sender_count; i++) {
+    pthread_join(sink->senders[i].thread, NULL);
+  }
+  if (sink->current) {
+    free(sink->current->body);
+    free(sink->current);
+  }
+  int ok = sink->stats.failed_batches == 0 && sink->stats.failed_records == 0;
+  if (stats) *stats = sink->stats;
+  pthread_mutex_destroy(&sink->lock);
+  pthread_cond_destroy(&sink->ready);
+  pthread_cond_destroy(&sink->room);
+  freeaddrinfo(sink->address);
+  free(sink->queue);
+  free(sink->senders);
+  free(sink);
+  return ok;
+}
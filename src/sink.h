@@ -0,0 +1,58 @@
+#ifndef RETENTION_SINK_H
+#define RETENTION_SINK_H
+
+#include <stddef.h>
+
+#include "retention.h"
+
+/* Outbound sink for the CLI (-sink URL): queue records are formatted as
+ * JSON objects, collected into batches and POSTed as a JSON array to a
+ * plain-HTTP endpoint by a fixed pool of sender threads, one keep-alive
+ * connection each. At most max_in_flight batches are queued or being sent;
+ * a producer that fills another one waits for room, which is the
+ * backpressure. Failed sends (connection errors, 429 and 5xx) are retried
+ * with exponential backoff and jitter, honouring Retry-After. */
+
+#define SINK_DEFAULT_BATCH 500
+#define SINK_DEFAULT_IN_FLIGHT 4
+#define SINK_DEFAULT_RETRIES 5
+#define SINK_BACKOFF_MS 100
+#define SINK_BACKOFF_CAP_MS 5000
+#define SINK_TIMEOUT_MS 10000
+
+typedef struct {
+  const char *url;
+  int batch_size;
+  int max_in_flight;
+  int max_retries;
+} SinkOptions;
+
+typedef struct {
+  long long records;
+  long long batches;
+  long long retries;
+  long long failed_batches;
+  long long failed_records;
+  /* Times the producer waited for room, and for how long. */
+  long long stalls;
+  double stalled_ms;
+} SinkStats;
+
+typedef struct Sink Sink;
+
+/* Starts the sender threads; NULL after printing an error (bad URL or
+ * unresolvable host). */
+Sink *sink_open(const SinkOptions *options);
+/* Queues one record as an upsert (op "upsert") of s, or a delete of id
+ * when s is NULL. May block while the senders are behind. */
+void sink_push_scholar(Sink *sink, const rw_engine *engine, const rw_scholar *s, const char *id, int drivers);
+/* Queues every scholar with risk >= min_risk in rank order. */
+void sink_push_queue(Sink *sink, const rw_engine *engine, double min_risk, int drivers);
+/* Hands over the partial batch without waiting for it to be sent (only,
+ * like any batch, for room). */
+void sink_flush(Sink *sink);
+/* Flushes, waits for every batch to settle, stops the senders and fills
+ * stats. Returns 1 when every record was delivered. */
+int sink_close(Sink *sink, SinkStats *stats);
+
+#endif
@@ -0,0 +1,401 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+/* Snapshot file: a fixed header, the cohort dictionary (names in id order,
+ * NUL-terminated), a chunk directory with zone maps, then the chunk bodies.
+ * The roster is written in rank order, SNAPSHOT_CHUNK_ROWS rows per chunk;
+ * each body holds seven double columns, open_flags and cohort_id as int32,
+ * the attendance and engagement trends as float, then "id\0name\0" per
+ * row. A directory entry carries the chunk's offset, size, min/max risk and
+ * whether it holds NaN scores, followed by one cohort-id bitset per chunk.
+ * Native byte order; the header records sizes so a snapshot from another
+ * build layout is rejected rather than misread. */
+
+#define SNAPSHOT_MAGIC "RWSNAP\0\1"
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_DOUBLE_COLUMNS 7
+#define SNAPSHOT_CHUNK_ROWS BATCH_ROWS
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t key;
+  int32_t count;
+  int32_t rows_read;
+  int32_t skipped;
+  int32_t filtered;
+  int32_t cohort_count;
+  int32_t chunk_rows;
+  int32_t chunk_count;
+  int32_t bitset_words;
+  uint64_t dict_size;
+} SnapshotHeader;
+
+typedef struct {
+  uint64_t offset;
+  uint64_t size;
+  int32_t rows;
+  int32_t has_nan;
+  double min_risk;
+  double max_risk;
+} ChunkInfo;
+
+static double *snapshot_double_column(Scholar *s, int column) {
+  switch (column) {
+    case 0: return &s->days_inactive;
+    case 1: return &s->attendance_rate;
+    case 2: return &s->engagement_score;
+    case 3: return &s->gpa;
+    case 4: return &s->last_contact_days;
+    case 5: return &s->survey_score;
+    default: return &s->risk_score;
+  }
+}
+
+static size_t chunk_numeric_size(int rows) {
+  return (size_t)rows * (SNAPSHOT_DOUBLE_COLUMNS * sizeof(double) + 2 * sizeof(int32_t) + 2 * sizeof(float));
+}
+
+int rw_snapshot_write(rw_engine *engine, const char *path, uint64_t key) {
+  if (!engine->scored) {
+    int rc = rw_score(engine);
+    if (rc != RW_OK) return rc;
+  }
+  if (rw_live_end(engine) != RW_OK) return RW_ERR_NOMEM;
+
+  int count = engine->count;
+  int cohort_count = engine->cohort_dict.count;
+  int chunk_count = (count + SNAPSHOT_CHUNK_ROWS - 1) / SNAPSHOT_CHUNK_ROWS;
+  int bitset_words = (cohort_count + 63) / 64;
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.header_size = sizeof(header);
+  header.key = key;
+  header.count = count;
+  header.rows_read = engine->rows_read;
+  header.skipped = engine->skipped;
+  header.filtered = engine->filtered;
+  header.cohort_count = cohort_count;
+  header.chunk_rows = SNAPSHOT_CHUNK_ROWS;
+  header.chunk_count = chunk_count;
+  header.bitset_words = bitset_words;
+
+  const char **cohort_names = calloc(cohort_count > 0 ? cohort_count : 1, sizeof(char *));
+  ChunkInfo *chunks = calloc(chunk_count > 0 ? chunk_count : 1, sizeof(ChunkInfo));
+  uint64_t *bitsets = calloc((size_t)chunk_count * bitset_words + 1, sizeof(uint64_t));
+  char *column = malloc(sizeof(double) * SNAPSHOT_CHUNK_ROWS);
+  FILE *out = NULL;
+  int rc = RW_ERR_NOMEM;
+  if (!cohort_names || !chunks || !bitsets || !column) goto done;
+  for (int i = 0; i < engine->cohort_dict.capacity; i++) {
+    if (engine->cohort_dict.keys[i]) cohort_names[engine->cohort_dict.ids[i]] = engine->cohort_dict.keys[i];
+  }
+  for (int i = 0; i < cohort_count; i++) {
+    header.dict_size += strlen(cohort_names[i]) + 1;
+  }
+
+  /* Zone maps and chunk offsets are known before any body is written. */
+  uint64_t offset = sizeof(header) + header.dict_size + sizeof(ChunkInfo) * (uint64_t)chunk_count +
+                    sizeof(uint64_t) * (uint64_t)chunk_count * bitset_words;
+  for (int c = 0; c < chunk_count; c++) {
+    int start = c * SNAPSHOT_CHUNK_ROWS;
+    int rows = count - start < SNAPSHOT_CHUNK_ROWS ? count - start : SNAPSHOT_CHUNK_ROWS;
+    ChunkInfo *info = &chunks[c];
+    uint64_t *bits = bitsets + (size_t)c * bitset_words;
+    info->offset = offset;
+    info->rows = rows;
+    info->min_risk = INFINITY;
+    info->max_risk = -INFINITY;
+    info->size = chunk_numeric_size(rows);
+    for (int i = start; i < start + rows; i++) {
+      const Scholar *s = &engine->scholars[i];
+      if (isnan(s->risk_score)) {
+        info->has_nan = 1;
+      } else {
+        if (s->risk_score < info->min_risk) info->min_risk = s->risk_score;
+        if (s->risk_score > info->max_risk) info->max_risk = s->risk_score;
+      }
+      bits[s->cohort_id / 64] |= 1ULL << (s->cohort_id % 64);
+      info->size += strlen(s->id) + strlen(s->name) + 2;
+    }
+    offset += info->size;
+  }
+
+  out = fopen(path, "wb");
+  if (!out) {
+    rc = RW_ERR_IO;
+    goto done;
+  }
+  fwrite(&header, sizeof(header), 1, out);
+  for (int i = 0; i < cohort_count; i++) {
+    fwrite(cohort_names[i], strlen(cohort_names[i]) + 1, 1, out);
+  }
+  fwrite(chunks, sizeof(ChunkInfo), (size_t)chunk_count, out);
+  fwrite(bitsets, sizeof(uint64_t), (size_t)chunk_count * bitset_words, out);
+
+  for (int c = 0; c < chunk_count; c++) {
+    Scholar *scholars = engine->scholars + (size_t)c * SNAPSHOT_CHUNK_ROWS;
+    int rows = chunks[c].rows;
+    double *values = (double *)column;
+    for (int k = 0; k < SNAPSHOT_DOUBLE_COLUMNS; k++) {
+      for (int i = 0; i < rows; i++) {
+        values[i] = *snapshot_double_column(&scholars[i], k);
+      }
+      fwrite(values, sizeof(double), (size_t)rows, out);
+    }
+    int32_t *ints = (int32_t *)column;
+    for (int i = 0; i < rows; i++) {
+      ints[i] = scholars[i].open_flags;
+    }
+    fwrite(ints, sizeof(int32_t), (size_t)rows, out);
+    for (int i = 0; i < rows; i++) {
+      ints[i] = scholars[i].cohort_id;
+    }
+    fwrite(ints, sizeof(int32_t), (size_t)rows, out);
+    float *trends = (float *)column;
+    for (int i = 0; i < rows; i++) {
+      trends[i] = scholars[i].attendance_trend;
+    }
+    fwrite(trends, sizeof(float), (size_t)rows, out);
+    for (int i = 0; i < rows; i++) {
+      trends[i] = scholars[i].engagement_trend;
+    }
+    fwrite(trends, sizeof(float), (size_t)rows, out);
+    for (int i = 0; i < rows; i++) {
+      fwrite(scholars[i].id, strlen(scholars[i].id) + 1, 1, out);
+      fwrite(scholars[i].name, strlen(scholars[i].name) + 1, 1, out);
+    }
+  }
+  rc = ferror(out) ? RW_ERR_IO : RW_OK;
+
+done:
+  if (out && fclose(out) != 0) rc = RW_ERR_IO;
+  free(cohort_names);
+  free(chunks);
+  free(bitsets);
+  free(column);
+  return rc;
+}
+
+/* Returns the next NUL-terminated string in [*cursor, end) or NULL. */
+static char *next_string(char **cursor, const char *end) {
+  char *s = *cursor;
+  char *nul = memchr(s, '\0', (size_t)(end - s));
+  if (!nul) return NULL;
+  *cursor = nul + 1;
+  return s;
+}
+
+/* Decodes one chunk body into out, keeping rows that pass the cohort,
+ * min-risk and id filters, at most limit (-1 for all). Returns the rows
+ * kept, or -1 when the body is malformed. */
+static int decode_chunk(const rw_engine *engine, char *body, const ChunkInfo *info, char **cohort_names,
+                        int cohort_count, int cohort_id, double min_risk, int limit, Scholar *out) {
+  int rows = info->rows;
+  const char *ints = body + (size_t)rows * SNAPSHOT_DOUBLE_COLUMNS * sizeof(double);
+  const char *trends = ints + (size_t)rows * 2 * sizeof(int32_t);
+  char *cursor = body + chunk_numeric_size(rows);
+  const char *end = body + info->size;
+  int kept = 0;
+  for (int i = 0; i < rows && (limit < 0 || kept < limit); i++) {
+    Scholar *s = &out[kept];
+    for (int k = 0; k < SNAPSHOT_DOUBLE_COLUMNS; k++) {
+      memcpy(snapshot_double_column(s, k), body + ((size_t)k * rows + i) * sizeof(double), sizeof(double));
+    }
+    int32_t v;
+    memcpy(&v, ints + (size_t)i * sizeof(int32_t), sizeof(v));
+    s->open_flags = v;
+    memcpy(&v, ints + ((size_t)rows + i) * sizeof(int32_t), sizeof(v));
+    s->cohort_id = v;
+    memcpy(&s->attendance_trend, trends + (size_t)i * sizeof(float), sizeof(float));
+    memcpy(&s->engagement_trend, trends + ((size_t)rows + i) * sizeof(float), sizeof(float));
+    s->id = next_string(&cursor, end);
+    s->name = s->id ? next_string(&cursor, end) : NULL;
+    if (!s->name || s->cohort_id < 0 || s->cohort_id >= cohort_count) return -1;
+    if (cohort_id >= 0 && s->cohort_id != cohort_id) continue;
+    if (s->risk_score < min_risk) continue;
+    if (!rw_id_allowed(engine, s->id)) continue;
+    s->cohort = cohort_names[s->cohort_id];
+    kept++;
+  }
+  return kept;
+}
+
+static int chunk_wanted(const ChunkInfo *info, const uint64_t *bits, int cohort_id, double min_risk) {
+  if (!info->has_nan && info->max_risk < min_risk) return 0;
+  if (cohort_id >= 0 && !((bits[cohort_id / 64] >> (cohort_id % 64)) & 1ULL)) return 0;
+  return 1;
+}
+
+static int read_snapshot(rw_engine *engine, const char *path, const uint64_t *key,
+                         const rw_snapshot_filter *filter, rw_snapshot_stats *stats) {
+  if (engine->count > 0 || engine->cohort_dict.count > 0) return RW_ERR_CONFIG;
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return RW_ERR_IO;
+
+  SnapshotHeader header;
+  if (fread(&header, sizeof(header), 1, fp) != 1 ||
+      memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SNAPSHOT_VERSION || header.header_size != sizeof(header) ||
+      (key && header.key != *key) || header.count < 0 || header.cohort_count < 0 ||
+      header.chunk_count < 0 || header.bitset_words != (header.cohort_count + 63) / 64 ||
+      header.dict_size > UINT32_MAX) {
+    fclose(fp);
+    return RW_ERR_CONFIG;
+  }
+
+  int chunk_count = header.chunk_count;
+  int bitset_words = header.bitset_words;
+  char *dict = malloc(header.dict_size + 1);
+  ChunkInfo *chunks = malloc(sizeof(ChunkInfo) * (chunk_count > 0 ? chunk_count : 1));
+  uint64_t *bitsets = malloc(sizeof(uint64_t) * ((size_t)chunk_count * bitset_words + 1));
+  char **cohort_names = malloc(sizeof(char *) * (header.cohort_count > 0 ? header.cohort_count : 1));
+  char *wanted = calloc(chunk_count > 0 ? chunk_count : 1, 1);
+  char *body = NULL;
+  Scholar *scholars = NULL;
+  int rc = RW_ERR_CONFIG;
+  if (!dict || !chunks || !bitsets || !cohort_names || !wanted) {
+    rc = RW_ERR_NOMEM;
+    goto done;
+  }
+  if (fread(dict, 1, header.dict_size, fp) != header.dict_size ||
+      fread(chunks, sizeof(ChunkInfo), (size_t)chunk_count, fp) != (size_t)chunk_count ||
+      fread(bitsets, sizeof(uint64_t), (size_t)chunk_count * bitset_words, fp) != (size_t)chunk_count * bitset_words) {
+    goto done;
+  }
+
+  char *cursor = dict;
+  for (int i = 0; i < header.cohort_count; i++) {
+    char *name = next_string(&cursor, dict + header.dict_size);
+    if (!name) goto done;
+    if (rw_dict_intern(&engine->cohort_dict, &engine->arena, name, &cohort_names[i]) < 0) {
+      rc = RW_ERR_NOMEM;
+      goto done;
+    }
+  }
+
+  double min_risk = filter ? filter->min_risk : -INFINITY;
+  int limit = filter ? filter->limit : -1;
+  int cohort_id = -1;
+  int cohort_missing = 0;
+  if (filter && filter->cohort) {
+    cohort_missing = 1;
+    for (int i = 0; i < header.cohort_count; i++) {
+      if (strcmp(cohort_names[i], filter->cohort) == 0) {
+        cohort_id = i;
+        cohort_missing = 0;
+      }
+    }
+  }
+
+  /* Zone maps pick the chunks that can hold matching rows. Chunks are in
+   * rank order, so a min-risk query touches a prefix (plus any NaN chunks). */
+  size_t body_size = 0;
+  long candidate_rows = 0;
+  for (int c = 0; c < chunk_count; c++) {
+    ChunkInfo *info = &chunks[c];
+    if (info->rows < 0 || info->size < chunk_numeric_size(info->rows)) goto done;
+    wanted[c] = !cohort_missing && chunk_wanted(info, bitsets + (size_t)c * bitset_words, cohort_id, min_risk);
+    if (wanted[c]) {
+      body_size += info->size;
+      candidate_rows += info->rows;
+    }
+  }
+  body = malloc(body_size > 0 ? body_size : 1);
+  scholars = malloc(sizeof(Scholar) * (candidate_rows > 0 ? candidate_rows : 1));
+  if (!body || !scholars) {
+    rc = RW_ERR_NOMEM;
+    goto done;
+  }
+
+  rw_stage_begin(STAGE_PARSE);
+  int count = 0;
+  int filtered = 0;
+  int chunks_read = 0;
+  char *region = body;
+  for (int c = 0; c < chunk_count; c++) {
+    ChunkInfo *info = &chunks[c];
+    if (!wanted[c] || (limit >= 0 && count >= limit)) {
+      filtered += info->rows;
+      continue;
+    }
+    if (fseek(fp, (long)info->offset, SEEK_SET) != 0 || fread(region, 1, info->size, fp) != info->size) {
+      rw_stage_end(STAGE_PARSE, count);
+      rc = RW_ERR_IO;
+      goto done;
+    }
+    chunks_read++;
+    int kept = decode_chunk(engine, region, info, cohort_names, header.cohort_count, cohort_id, min_risk,
+                            limit >= 0 ? limit - count : -1, scholars + count);
+    if (kept < 0) {
+      rw_stage_end(STAGE_PARSE, count);
+      goto done;
+    }
+    filtered += info->rows - kept;
+    count += kept;
+    region += info->size;
+  }
+  rw_stage_end(STAGE_PARSE, count);
+
+  if (stats) {
+    stats->chunks_total = chunk_count;
+    stats->chunks_read = chunks_read;
+    stats->rows_total = header.count;
+  }
+  free(engine->scholars);
+  free(engine->snapshot_data);
+  engine->snapshot_data = body;
+  engine->scholars = scholars;
+  engine->count = count;
+  engine->capacity = candidate_rows > 0 ? (int)candidate_rows : 1;
+  engine->rows_read = header.rows_read;
+  engine->skipped = header.skipped;
+  engine->filtered = header.filtered + filtered;
+  engine->scored = 1;
+  body = NULL;
+  scholars = NULL;
+  rc = RW_OK;
+
+done:
+  if (rc != RW_OK) {
+    rw_dict_free(&engine->cohort_dict);
+    memset(&engine->cohort_dict, 0, sizeof(engine->cohort_dict));
+  }
+  free(body);
+  free(scholars);
+  free(dict);
+  free(chunks);
+  free(bitsets);
+  free(cohort_names);
+  free(wanted);
+  fclose(fp);
+  return rc;
+}
+
+int rw_snapshot_read(rw_engine *engine, const char *path, uint64_t key) {
+  return read_snapshot(engine, path, &key, NULL, NULL);
+}
+
+int rw_snapshot_query(rw_engine *engine, const char *path, const rw_snapshot_filter *filter,
+                      rw_snapshot_stats *stats) {
+  return read_snapshot(engine, path, NULL, filter, stats);
+}
+
+int rw_is_snapshot(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return 0;
+  char magic[8];
+  int is = fread(magic, sizeof(magic), 1, fp) == 1 && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+  fclose(fp);
+  return is;
+}
@@ -0,0 +1,312 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "instrument.h"
+
+/* Parts are sized by the roster alone; each part's table is kept no
+ * larger than its rows, so many small cohorts do not multiply memory. */
+#define STATS_MAX_PARTS 16
+#define STATS_ROWS_PER_PART 65536
+
+static const char *const column_names[RW_STAT_COLUMNS] = {
+  "days_inactive", "attendance_rate", "engagement_score", "gpa", "last_contact_days", "survey_score", "risk",
+  "open_flags"};
+
+const char *rw_column_name(int column) {
+  return column >= 0 && column < RW_STAT_COLUMNS ? column_names[column] : NULL;
+}
+
+double rw_stat_value(const Scholar *s, int column) {
+  switch (column) {
+    case RW_COL_DAYS_INACTIVE: return s->days_inactive;
+    case RW_COL_ATTENDANCE_RATE: return s->attendance_rate;
+    case RW_COL_ENGAGEMENT_SCORE: return s->engagement_score;
+    case RW_COL_GPA: return s->gpa;
+    case RW_COL_LAST_CONTACT_DAYS: return s->last_contact_days;
+    case RW_COL_SURVEY_SCORE: return s->survey_score;
+    case RW_COL_RISK: return s->risk_score;
+    default: return s->open_flags;
+  }
+}
+
+void rw_stats_add(RunningStats *stats, double value) {
+  if (isnan(value)) return;
+  if (stats->count == 0) {
+    stats->count = 1;
+    stats->mean = value;
+    stats->m2 = 0.0;
+    stats->min = value;
+    stats->max = value;
+    stats->min_count = 1;
+    stats->max_count = 1;
+    return;
+  }
+  stats->count++;
+  double delta = value - stats->mean;
+  stats->mean += delta / stats->count;
+  stats->m2 += delta * (value - stats->mean);
+  /* A lost bound (NaN) compares false and stays lost. */
+  if (value < stats->min) {
+    stats->min = value;
+    stats->min_count = 1;
+  } else if (value == stats->min) {
+    stats->min_count++;
+  }
+  if (value > stats->max) {
+    stats->max = value;
+    stats->max_count = 1;
+  } else if (value == stats->max) {
+    stats->max_count++;
+  }
+}
+
+/* The Welford update run backwards. Removing the last value at a bound
+ * loses that bound until rw_stats_rebound rescans. */
+void rw_stats_remove(RunningStats *stats, double value) {
+  if (isnan(value) || stats->count == 0) return;
+  if (stats->count == 1) {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+  stats->count--;
+  double delta = value - stats->mean;
+  stats->mean -= delta / stats->count;
+  stats->m2 -= delta * (value - stats->mean);
+  if (stats->m2 < 0.0) stats->m2 = 0.0;
+  if (value == stats->min && --stats->min_count == 0) stats->min = NAN;
+  if (value == stats->max && --stats->max_count == 0) stats->max = NAN;
+}
+
+void rw_stats_merge(RunningStats *into, const RunningStats *from) {
+  if (from->count == 0) return;
+  if (into->count == 0) {
+    *into = *from;
+    return;
+  }
+  double n = (double)into->count + (double)from->count;
+  double delta = from->mean - into->mean;
+  into->mean += delta * (double)from->count / n;
+  into->m2 += from->m2 + delta * delta * (double)into->count * (double)from->count / n;
+  into->count += from->count;
+  if (isnan(from->min) || from->min < into->min) {
+    into->min = from->min;
+    into->min_count = from->min_count;
+  } else if (from->min == into->min) {
+    into->min_count += from->min_count;
+  }
+  if (isnan(from->max) || from->max > into->max) {
+    into->max = from->max;
+    into->max_count = from->max_count;
+  } else if (from->max == into->max) {
+    into->max_count += from->max_count;
+  }
+}
+
+/* Population standard deviations from the mean; 0 without spread. */
+double rw_stats_zscore(const RunningStats *stats, double value) {
+  if (isnan(value)) return NAN;
+  double sd = stats->count > 0 ? sqrt(stats->m2 / stats->count) : 0.0;
+  return sd > 0.0 ? (value - stats->mean) / sd : 0.0;
+}
+
+typedef struct {
+  const rw_engine *engine;
+  /* Slots in rank order for a live engine, else NULL. */
+  const int *slots;
+  RunningStats **tables;
+  int part_count;
+  int rows_per_part;
+  int first;
+  int stride;
+} StatsWorker;
+
+static void *stats_worker(void *arg) {
+  StatsWorker *w = arg;
+  const Scholar *scholars = w->engine->scholars;
+  int count = w->engine->count;
+  for (int part = w->first; part < w->part_count; part += w->stride) {
+    RunningStats *table = w->tables[part];
+    int end = part + 1 == w->part_count ? count : (part + 1) * w->rows_per_part;
+    for (int i = part * w->rows_per_part; i < end; i++) {
+      const Scholar *s = &scholars[w->slots ? w->slots[i] : i];
+      RunningStats *row = &table[(size_t)s->cohort_id * RW_STAT_COLUMNS];
+      for (int c = 0; c < RW_STAT_COLUMNS; c++) rw_stats_add(&row[c], rw_stat_value(s, c));
+    }
+  }
+  return NULL;
+}
+
+int rw_stats_by_cohort(const rw_engine *engine, RunningStats *out) {
+  int count = engine->count;
+  size_t ids = (size_t)(engine->cohort_dict.count > 0 ? engine->cohort_dict.count : 1);
+  long long parts = count / STATS_ROWS_PER_PART + 1;
+  long long by_memory = count / (long long)(ids * RW_STAT_COLUMNS) + 1;
+  if (parts > by_memory) parts = by_memory;
+  if (parts > STATS_MAX_PARTS) parts = STATS_MAX_PARTS;
+  int part_count = (int)parts;
+
+  int *slots = NULL;
+  if (engine->live) {
+    slots = malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+    int rc = slots ? rw_live_order(engine, slots) : RW_ERR_NOMEM;
+    if (rc != RW_OK) {
+      free(slots);
+      return rc;
+    }
+  }
+  RunningStats *tables[STATS_MAX_PARTS] = {out};
+  for (int p = 1; p < part_count; p++) {
+    tables[p] = calloc(ids * RW_STAT_COLUMNS, sizeof(RunningStats));
+    if (!tables[p]) {
+      for (int q = 1; q < p; q++) free(tables[q]);
+      free(slots);
+      return RW_ERR_NOMEM;
+    }
+  }
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  int threads = online > 0 && online < part_count ? (int)online : part_count;
+  StatsWorker workers[STATS_MAX_PARTS];
+  pthread_t handles[STATS_MAX_PARTS];
+  int started[STATS_MAX_PARTS] = {0};
+  rw_trace_begin("cohort stats", "aggregate");
+  for (int t = 0; t < threads; t++) {
+    workers[t] = (StatsWorker){engine, slots, tables, part_count, count / part_count, t, threads};
+  }
+  for (int t = 1; t < threads; t++) {
+    started[t] = pthread_create(&handles[t], NULL, stats_worker, &workers[t]) == 0;
+    if (!started[t]) stats_worker(&workers[t]);
+  }
+  stats_worker(&workers[0]);
+  for (int t = 1; t < threads; t++) {
+    if (started[t]) pthread_join(handles[t], NULL);
+  }
+  for (int p = 1; p < part_count; p++) {
+    for (size_t i = 0; i < ids * RW_STAT_COLUMNS; i++) rw_stats_merge(&out[i], &tables[p][i]);
+    free(tables[p]);
+  }
+  free(slots);
+  rw_trace_end("cohort stats", "aggregate", count);
+  return RW_OK;
+}
+
+static const Scholar *scholar_at(const rw_engine *engine, int rank) {
+  return engine->live ? rw_live_at(engine, rank) : &engine->scholars[rank];
+}
+
+static int bound_lost(const RunningStats *stats) {
+  return stats->count > 0 && (isnan(stats->min) || isnan(stats->max));
+}
+
+int rw_stats_rebound(rw_engine *engine) {
+  int any = 0;
+  for (int i = 0; !any && i < engine->cohort_count; i++) {
+    for (int c = 0; c < RW_STAT_COLUMNS; c++) any |= bound_lost(&engine->cohorts[i].stats[c]);
+  }
+  if (!any) {
+    engine->bounds_lost = 0;
+    return RW_OK;
+  }
+
+  char *lost = calloc((size_t)engine->cohort_count, 1);
+  int *slots = engine->live ? malloc(sizeof(int) * (size_t)(engine->count > 0 ? engine->count : 1)) : NULL;
+  int rc = !lost || (engine->live && !slots) ? RW_ERR_NOMEM : RW_OK;
+  if (rc == RW_OK && slots) rc = rw_live_order(engine, slots);
+  if (rc != RW_OK) {
+    free(lost);
+    free(slots);
+    return rc;
+  }
+  for (int i = 0; i < engine->cohort_count; i++) {
+    for (int c = 0; c < RW_STAT_COLUMNS; c++) {
+      RunningStats *stats = &engine->cohorts[i].stats[c];
+      if (!bound_lost(stats)) continue;
+      /* Both ends are rebuilt; an intact one comes back unchanged. */
+      stats->min = INFINITY;
+      stats->max = -INFINITY;
+      stats->min_count = 0;
+      stats->max_count = 0;
+      lost[i] = 1;
+    }
+  }
+  for (int rank = 0; rank < engine->count; rank++) {
+    const Scholar *s = &engine->scholars[slots ? slots[rank] : rank];
+    int index = engine->cohort_slots[s->cohort_id];
+    if (!lost[index]) continue;
+    RunningStats *stats = engine->cohorts[index].stats;
+    for (int c = 0; c < RW_STAT_COLUMNS; c++) {
+      double value = rw_stat_value(s, c);
+      if (value < stats[c].min) {
+        stats[c].min = value;
+        stats[c].min_count = 1;
+      } else if (value == stats[c].min) {
+        stats[c].min_count++;
+      }
+      if (value > stats[c].max) {
+        stats[c].max = value;
+        stats[c].max_count = 1;
+      } else if (value == stats[c].max) {
+        stats[c].max_count++;
+      }
+    }
+  }
+  free(slots);
+  free(lost);
+  engine->bounds_lost = 0;
+  return RW_OK;
+}
+
+/* The moments are a cache behind the const read API, filled on first use;
+ * an engine is single-threaded, so filling it from a reader is safe. */
+int rw_stats_prepare(const rw_engine *engine, int bounds) {
+  rw_engine *owner = (rw_engine *)engine;
+  if (!engine->aggregated) return RW_ERR_CONFIG;
+  if (!engine->moments) {
+    int dict_count = engine->cohort_dict.count;
+    RunningStats *by_id = calloc((size_t)(dict_count > 0 ? dict_count : 1) * RW_STAT_COLUMNS, sizeof(RunningStats));
+    if (!by_id) return RW_ERR_NOMEM;
+    int rc = rw_stats_by_cohort(engine, by_id);
+    if (rc != RW_OK) {
+      free(by_id);
+      return rc;
+    }
+    for (int id = 0; id < dict_count; id++) {
+      if (engine->cohort_slots[id] < 0) continue;
+      memcpy(owner->cohorts[engine->cohort_slots[id]].stats, &by_id[(size_t)id * RW_STAT_COLUMNS],
+             sizeof(RunningStats) * RW_STAT_COLUMNS);
+    }
+    free(by_id);
+    owner->moments = 1;
+    owner->bounds_lost = 0;
+  }
+  return bounds && engine->bounds_lost ? rw_stats_rebound(owner) : RW_OK;
+}
+
+int rw_cohort_stats_at(const rw_engine *engine, int index, int column, rw_stats *out) {
+  if (!engine->aggregated) return RW_ERR_CONFIG;
+  if (index < 0 || index >= engine->cohort_count || column < 0 || column >= RW_STAT_COLUMNS) return RW_ERR_RANGE;
+  int rc = rw_stats_prepare(engine, 1);
+  if (rc != RW_OK) return rc;
+  const RunningStats *stats = &engine->cohorts[index].stats[column];
+  out->count = stats->count;
+  out->mean = stats->count > 0 ? stats->mean : NAN;
+  out->variance = stats->count > 0 ? stats->m2 / stats->count : NAN;
+  out->min = stats->count > 0 ? stats->min : NAN;
+  out->max = stats->count > 0 ? stats->max : NAN;
+  return RW_OK;
+}
+
+int rw_zscore_at(const rw_engine *engine, int rank, double *out) {
+  if (!engine->aggregated) return RW_ERR_CONFIG;
+  if (rank < 0 || rank >= engine->count) return RW_ERR_RANGE;
+  int rc = rw_stats_prepare(engine, 0);
+  if (rc != RW_OK) return rc;
+  const Scholar *s = scholar_at(engine, rank);
+  const CohortSummary *cs = &engine->cohorts[engine->cohort_slots[s->cohort_id]];
+  *out = rw_stats_zscore(&cs->stats[RW_COL_RISK], s->risk_score);
+  return RW_OK;
+}